@@ -50,6 +50,26 @@ void TextEditor::ImGuiDebugPanel(const std::string& panelName)
 			}
 		}
 	}
+	if (ImGui::CollapsingHeader("Frame stats"))
+	{
+		bool profiling = mProfilingEnabled;
+		if (ImGui::Checkbox("Profiling", &profiling))
+			SetProfilingEnabled(profiling);
+		if (const FrameStats* stats = GetLastFrameStats())
+		{
+			ImGui::Text("Frame %llu", static_cast<unsigned long long>(stats->mFrame));
+			for (std::size_t i = 0; i < stats->mScopeMicroseconds.size(); ++i)
+				ImGui::Text("%-12s %9.1f us", GetProfileScopeName(static_cast<ProfileScope>(i)), stats->mScopeMicroseconds[i]);
+			ImGui::Text("Lines colorized:      %d", stats->mLinesColorized);
+			ImGui::Text("Visual lines rebuilt: %d", stats->mVisualLinesRebuilt);
+			ImGui::Text("Glyphs drawn:         %d", stats->mGlyphsDrawn);
+			ImGui::Text("Draw commands:        %d", stats->mDrawCommands);
+			ImGui::Text("Draw vertices:        %d", stats->mDrawVertices);
+			ImGui::Text("Draw allocations:     %d", stats->mDrawAllocations);
+			if (ImGui::Button("Copy Chrome trace"))
+				ImGui::SetClipboardText(ExportChromeTrace().c_str());
+		}
+	}
 	if (ImGui::Button("Run unit tests"))
 	{
 		UnitTests();
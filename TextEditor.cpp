@@ -5,6 +5,14 @@
 
 #define IMGUI_SCROLLBAR_WIDTH 14.0f
 
+// Number of line changes kept for GetLineChangesSince(). Consumers that fall further
+// behind than this simply re-analyze the whole document.
+constexpr std::size_t line_change_history_size = 256;
+
+// Frames kept by the frame instrumentation, and timed scopes kept per frame
+constexpr std::size_t profile_history_size = 300;
+constexpr std::size_t profile_max_events_per_frame = 4096;
+
 
 struct TextEditor::RegexList {
     std::vector<std::pair<boost::regex, TextEditor::PaletteIndex>> mValue;
@@ -84,6 +92,8 @@ void TextEditor::SetPalette(PaletteId aValue)
 		color.w *= ImGui::GetStyle().Alpha;
 		mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
 	}
+	if (!mLines.empty())
+		RecordColorChange(0, GetLineCount());
 }
 
 void TextEditor::SetPalette(const Palette& aValue)
@@ -99,6 +109,9 @@ void TextEditor::SetPalette(const Palette& aValue)
 void TextEditor::SetLanguageDefinition(LanguageDefinitionId aValue)
 {
 	mLanguageDefinitionId = aValue;
+	mBracketLines.clear();
+	if (!mLines.empty())
+		RecordTokenClassChange(0, GetLineCount());  // Classes read as plain code until recolorized
 	switch (mLanguageDefinitionId)
 	{
 	case LanguageDefinitionId::None:
@@ -308,10 +321,7 @@ void TextEditor::Cut()
 
 			Copy();
 			for (int c = mState.mCurrentCursor; c > -1; c--)
-			{
-				u.mOperations.push_back({ GetSelectedText(c), mState.mCursors[c].GetSelectionStart(), mState.mCursors[c].GetSelectionEnd(), UndoOperationType::Delete });
-				DeleteSelection(c);
-			}
+				DeleteSelection(c, u);
 
 			u.mAfter = mState;
 			AddUndo(u);
@@ -354,10 +364,7 @@ void TextEditor::Paste()
 		if (AnyCursorHasSelection())
 		{
 			for (int c = mState.mCurrentCursor; c > -1; c--)
-			{
-				u.mOperations.push_back({ GetSelectedText(c), mState.mCursors[c].GetSelectionStart(), mState.mCursors[c].GetSelectionEnd(), UndoOperationType::Delete });
-				DeleteSelection(c);
-			}
+				DeleteSelection(c, u);
 		}
 
 		for (int c = mState.mCurrentCursor; c > -1; c--)
@@ -395,6 +402,7 @@ void TextEditor::Redo(int aSteps)
 
 void TextEditor::SetText(const std::string& aText)
 {
+	const int oldLineCount = GetLineCount();
 	mLines.clear();
 	mLines.emplace_back(Line());
 	for (auto chr : aText)
@@ -409,6 +417,7 @@ void TextEditor::SetText(const std::string& aText)
 			mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
 		}
 	}
+	RecordLineChange(0, oldLineCount, GetLineCount());
 
 	mScrollToTop = true;
 
@@ -429,6 +438,7 @@ std::string TextEditor::GetText() const
 
 void TextEditor::SetTextLines(const std::vector<std::string>& aLines)
 {
+	const int oldLineCount = GetLineCount();
 	mLines.clear();
 
 	if (aLines.empty())
@@ -446,6 +456,7 @@ void TextEditor::SetTextLines(const std::vector<std::string>& aLines)
 				mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
 		}
 	}
+	RecordLineChange(0, oldLineCount, GetLineCount());
 
 	mScrollToTop = true;
 
@@ -502,6 +513,216 @@ auto TextEditor::GetLineLength(int aLine) const -> int
 	return static_cast<int>(mLines[static_cast<std::size_t>(aLine)].size());
 }
 
+std::uint64_t TextEditor::GetDocumentVersion() const
+{
+	return mLineChanges.Observe();
+}
+
+bool TextEditor::GetLineChangesSince(std::uint64_t aVersion, std::vector<LineChange>& outChanges) const
+{
+	return mLineChanges.Since(aVersion, outChanges);
+}
+
+std::uint64_t TextEditor::GetTokenClassVersion() const
+{
+	return mTokenClassChanges.Observe();
+}
+
+bool TextEditor::GetTokenClassChangesSince(std::uint64_t aVersion, std::vector<LineChange>& outChanges) const
+{
+	return mTokenClassChanges.Since(aVersion, outChanges);
+}
+
+std::uint64_t TextEditor::GetColorVersion() const
+{
+	return mColorChanges.Observe();
+}
+
+bool TextEditor::GetColorChangesSince(std::uint64_t aVersion, std::vector<LineChange>& outChanges) const
+{
+	return mColorChanges.Since(aVersion, outChanges);
+}
+
+TextEditor::ScopedProfileTimer::ScopedProfileTimer(const TextEditor& aEditor, ProfileScope aScope)
+	: mEditor(aEditor.mProfilingEnabled ? &aEditor : nullptr), mScope(aScope)
+{
+	if (mEditor != nullptr)
+		mStart = std::chrono::steady_clock::now();
+}
+
+TextEditor::ScopedProfileTimer::~ScopedProfileTimer()
+{
+	if (mEditor == nullptr)
+		return;
+
+	using Microseconds = std::chrono::duration<double, std::micro>;
+	auto& stats = mEditor->mCurrentFrameStats;
+	const double duration = Microseconds(std::chrono::steady_clock::now() - mStart).count();
+	stats.mScopeMicroseconds[(std::size_t)mScope] += duration;
+	if (stats.mEvents.size() < profile_max_events_per_frame)
+		stats.mEvents.push_back({ mScope, Microseconds(mStart - mEditor->mProfileEpoch).count(), duration });
+}
+
+void TextEditor::SetProfilingEnabled(bool aEnabled)
+{
+	if (aEnabled && !mProfilingEnabled)
+	{
+		mProfileEpoch = std::chrono::steady_clock::now();
+		mFrameHistory.clear();
+		mFrameHistoryHead = 0;
+		mFrameCounter = 0;
+		mCurrentFrameStats = FrameStats{};
+	}
+	mProfilingEnabled = aEnabled;
+}
+
+const TextEditor::FrameStats& TextEditor::GetFrameStats(int aIndex) const
+{
+	assert(aIndex >= 0 && aIndex < GetFrameStatsCount());
+	return mFrameHistory[(mFrameHistoryHead + static_cast<std::size_t>(aIndex)) % mFrameHistory.size()];
+}
+
+const TextEditor::FrameStats* TextEditor::GetLastFrameStats() const
+{
+	return mFrameHistory.empty() ? nullptr : &GetFrameStats(GetFrameStatsCount() - 1);
+}
+
+const char* TextEditor::GetProfileScopeName(ProfileScope aScope)
+{
+	switch (aScope)
+	{
+	case ProfileScope::Frame:
+		return "Frame";
+	case ProfileScope::Input:
+		return "Input";
+	case ProfileScope::Colorize:
+		return "Colorize";
+	case ProfileScope::VisualLines:
+		return "VisualLines";
+	case ProfileScope::DrawLines:
+		return "DrawLines";
+	default:
+		return "Unknown";
+	}
+}
+
+void TextEditor::BeginProfileFrame(const ImDrawList* aDrawList)
+{
+	if (!mProfilingEnabled)
+		return;
+
+	mFrameStart = std::chrono::steady_clock::now();
+	if (aDrawList != nullptr)
+	{
+		mFrameDrawCommandsStart = aDrawList->CmdBuffer.Size;
+		mFrameDrawVerticesStart = aDrawList->VtxBuffer.Size;
+		mFrameDrawCapacities = { aDrawList->CmdBuffer.Capacity, aDrawList->VtxBuffer.Capacity, aDrawList->IdxBuffer.Capacity };
+	}
+}
+
+void TextEditor::EndProfileFrame(const ImDrawList* aDrawList)
+{
+	auto& stats = mCurrentFrameStats;
+	if (!mProfilingEnabled)
+	{
+		// Counters are bumped regardless; keep them from piling up
+		stats.mLinesColorized = 0;
+		stats.mVisualLinesRebuilt = 0;
+		stats.mGlyphsDrawn = 0;
+		return;
+	}
+
+	using Microseconds = std::chrono::duration<double, std::micro>;
+	const double duration = Microseconds(std::chrono::steady_clock::now() - mFrameStart).count();
+	stats.mScopeMicroseconds[(std::size_t)ProfileScope::Frame] += duration;
+	stats.mEvents.push_back({ ProfileScope::Frame, Microseconds(mFrameStart - mProfileEpoch).count(), duration });
+	if (aDrawList != nullptr)
+	{
+		stats.mDrawCommands = aDrawList->CmdBuffer.Size - mFrameDrawCommandsStart;
+		stats.mDrawVertices = aDrawList->VtxBuffer.Size - mFrameDrawVerticesStart;
+		stats.mDrawAllocations = (aDrawList->CmdBuffer.Capacity > mFrameDrawCapacities[0] ? 1 : 0) +
+			(aDrawList->VtxBuffer.Capacity > mFrameDrawCapacities[1] ? 1 : 0) +
+			(aDrawList->IdxBuffer.Capacity > mFrameDrawCapacities[2] ? 1 : 0);
+	}
+	stats.mFrame = ++mFrameCounter;
+
+	// Copying into a recycled slot reuses its event buffer
+	if (mFrameHistory.size() < profile_history_size)
+	{
+		mFrameHistory.push_back(stats);
+	}
+	else
+	{
+		mFrameHistory[mFrameHistoryHead] = stats;
+		mFrameHistoryHead = (mFrameHistoryHead + 1) % mFrameHistory.size();
+	}
+
+	stats.mScopeMicroseconds.fill(0.0);
+	stats.mEvents.clear();
+	stats.mLinesColorized = 0;
+	stats.mVisualLinesRebuilt = 0;
+	stats.mGlyphsDrawn = 0;
+	stats.mDrawCommands = 0;
+	stats.mDrawVertices = 0;
+	stats.mDrawAllocations = 0;
+}
+
+std::string TextEditor::ExportChromeTrace() const
+{
+	std::string json = "{\"traceEvents\":[";
+	std::array<char, 384> buffer{};
+	const char* separator = "";
+	for (int i = 0; i < GetFrameStatsCount(); ++i)
+	{
+		const auto& stats = GetFrameStats(i);
+		double frameEnd = 0.0;
+		for (const auto& event : stats.mEvents)
+		{
+			snprintf(buffer.data(), buffer.size(),
+				"%s{\"name\":\"%s\",\"cat\":\"TextEditor\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+				separator, GetProfileScopeName(event.mScope), event.mStartMicroseconds, event.mDurationMicroseconds);
+			json += buffer.data();
+			separator = ",";
+			frameEnd = Max(frameEnd, event.mStartMicroseconds + event.mDurationMicroseconds);
+		}
+
+		// Counters as a counter track, sampled at the end of the frame
+		snprintf(buffer.data(), buffer.size(),
+			"%s{\"name\":\"Counters\",\"cat\":\"TextEditor\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":1,"
+			"\"args\":{\"linesColorized\":%d,\"visualLinesRebuilt\":%d,\"glyphsDrawn\":%d,"
+			"\"drawCommands\":%d,\"drawVertices\":%d,\"drawAllocations\":%d}}",
+			separator, frameEnd, stats.mLinesColorized, stats.mVisualLinesRebuilt, stats.mGlyphsDrawn,
+			stats.mDrawCommands, stats.mDrawVertices, stats.mDrawAllocations);
+		json += buffer.data();
+		separator = ",";
+	}
+	json += "],\"displayTimeUnit\":\"ms\"}";
+	return json;
+}
+
+std::uint64_t TextEditor::LineChangeLog::Observe() const
+{
+	mObservedVersion = mVersion;
+	return mVersion;
+}
+
+bool TextEditor::LineChangeLog::Since(std::uint64_t aVersion, std::vector<LineChange>& outChanges) const
+{
+	mObservedVersion = mVersion;
+	if (aVersion == mVersion)
+		return true;
+	if (aVersion > mVersion || aVersion < mBaseVersion)
+		return false;
+
+	for (std::size_t i = 0; i < mChanges.size(); ++i)
+	{
+		const auto& change = mChanges[(mHead + i) % mChanges.size()];
+		if (change.mVersion > aVersion)
+			outChanges.push_back(change);
+	}
+	return true;
+}
+
 auto TextEditor::GetLineStyledTextRuns(int aLine) const -> std::vector<StyledTextRun>
 {
 	std::vector<StyledTextRun> runs;
@@ -546,10 +767,19 @@ bool TextEditor::Render(const char* aTitle,
 		child_window_flags
 	);
 
+	const ImDrawList* drawList = mProfilingEnabled ? ImGui::GetWindowDrawList() : nullptr;
+	BeginProfileFrame(drawList);
+
 	bool isFocused = ImGui::IsWindowFocused();
-	HandleKeyboardInputs(aParentIsFocused);
-	HandleMouseInputs();
-	ColorizeInternal();
+	{
+		ScopedProfileTimer const inputTimer(*this, ProfileScope::Input);
+		HandleKeyboardInputs(aParentIsFocused);
+		HandleMouseInputs();
+	}
+	{
+		ScopedProfileTimer const colorizeTimer(*this, ProfileScope::Colorize);
+		ColorizeInternal();
+	}
 	Render(aParentIsFocused);
 
 	if (aCallback)
@@ -557,6 +787,7 @@ bool TextEditor::Render(const char* aTitle,
 		aCallback();
 	}
 
+	EndProfileFrame(drawList);
 	return isFocused;
 }
 
@@ -870,6 +1101,64 @@ void TextEditor::SetHiddenLineRanges(std::vector<LineRange> ranges)
 	++mHiddenRangesRevision;
 }
 
+void TextEditor::HideLineRange(LineRange aRange)
+{
+	if (aRange.mStartLine > aRange.mEndLine)
+		std::swap(aRange.mStartLine, aRange.mEndLine);
+
+	// Ranges overlapping or touching the new one merge with it
+	auto first = std::lower_bound(mHiddenLineRanges.begin(), mHiddenLineRanges.end(), aRange.mStartLine - 1,
+		[](const LineRange& range, int line) { return range.mEndLine < line; });
+	auto last = std::upper_bound(first, mHiddenLineRanges.end(), aRange.mEndLine + 1,
+		[](int line, const LineRange& range) { return line < range.mStartLine; });
+	if (first != last && first->mStartLine <= aRange.mStartLine && first->mEndLine >= aRange.mEndLine)
+		return;
+
+	LineRange merged = aRange;
+	if (first != last)
+	{
+		merged.mStartLine = std::min(merged.mStartLine, first->mStartLine);
+		merged.mEndLine = std::max(merged.mEndLine, std::prev(last)->mEndLine);
+	}
+	const bool patch = IsVisualLineCacheCurrent();
+	mHiddenLineRanges.insert(mHiddenLineRanges.erase(first, last), merged);
+	++mHiddenRangesRevision;
+	if (patch)
+	{
+		UpdateVisualLines(aRange.mStartLine, aRange.mEndLine);
+		mCachedHiddenRevision = mHiddenRangesRevision;
+	}
+}
+
+void TextEditor::ShowLineRange(LineRange aRange)
+{
+	if (aRange.mStartLine > aRange.mEndLine)
+		std::swap(aRange.mStartLine, aRange.mEndLine);
+
+	auto first = std::lower_bound(mHiddenLineRanges.begin(), mHiddenLineRanges.end(), aRange.mStartLine,
+		[](const LineRange& range, int line) { return range.mEndLine < line; });
+	auto last = std::upper_bound(first, mHiddenLineRanges.end(), aRange.mEndLine,
+		[](int line, const LineRange& range) { return line < range.mStartLine; });
+	if (first == last)
+		return;
+
+	// Ranges sticking out of the shown one keep their outer parts
+	std::vector<LineRange> kept;
+	if (first->mStartLine < aRange.mStartLine)
+		kept.emplace_back(first->mStartLine, aRange.mStartLine - 1);
+	if (std::prev(last)->mEndLine > aRange.mEndLine)
+		kept.emplace_back(aRange.mEndLine + 1, std::prev(last)->mEndLine);
+
+	const bool patch = IsVisualLineCacheCurrent();
+	mHiddenLineRanges.insert(mHiddenLineRanges.erase(first, last), kept.begin(), kept.end());
+	++mHiddenRangesRevision;
+	if (patch)
+	{
+		UpdateVisualLines(aRange.mStartLine, aRange.mEndLine);
+		mCachedHiddenRevision = mHiddenRangesRevision;
+	}
+}
+
 void TextEditor::ClearHiddenLineRanges()
 {
 	if (!mHiddenLineRanges.empty())
@@ -879,122 +1168,118 @@ void TextEditor::ClearHiddenLineRanges()
 	}
 }
 
-void TextEditor::EnsureVisualLines() const
+bool TextEditor::IsVisualLineCacheCurrent() const
 {
-	const int line_count = static_cast<int>(mLines.size());
 	const int effective_wrap_column = mWordWrapEnabled ? Max(1, mWrapColumn) : 0;
-	if (mCachedLineCount == line_count &&
+	return mCachedLineCount == static_cast<int>(mLines.size()) &&
 	    mCachedGhostRevision == mGhostLinesRevision &&
 	    mCachedHiddenRevision == mHiddenRangesRevision &&
 	    mCachedLinesRevision == mLinesRevision &&
 	    mCachedWordWrapEnabled == mWordWrapEnabled &&
-	    mCachedWrapColumn == effective_wrap_column)
-		return;
-
-	mVisualLines.clear();
-	mDocumentToVisual.clear();
-	mDocumentToVisual.resize(static_cast<std::size_t>(std::max(0, line_count)), -1);
+	    mCachedWrapColumn == effective_wrap_column;
+}
 
-	std::vector<std::vector<int>> ghost_buckets;
-	ghost_buckets.resize(static_cast<std::size_t>(std::max(0, line_count) + 1), {});
+void TextEditor::AppendDocumentVisualLines(int aLine, int aWrapColumn, std::vector<VisualLine>& aOut) const
+{
+	++mCurrentFrameStats.mVisualLinesRebuilt;
+	auto append_document_visual_line = [&](int start_column, int end_column) {
+		VisualLine entry{};
+		entry.mDocumentLine = aLine;
+		entry.mWrapStartColumn = Max(0, start_column);
+		entry.mWrapEndColumn = Max(entry.mWrapStartColumn, end_column);
+		aOut.push_back(entry);
+	};
 
-	for (std::size_t i = 0; i < mGhostLines.size(); ++i)
+	const int line_max_column = GetLineMaxColumn(aLine);
+	if (line_max_column <= aWrapColumn || aWrapColumn <= 0)
 	{
-		int anchor = mGhostLines[i].mAnchorLine;
-		if (anchor < 0)
-			anchor = 0;
-		if (anchor > line_count)
-			anchor = line_count;
-		ghost_buckets[static_cast<std::size_t>(anchor)].push_back(static_cast<int>(i));
+		append_document_visual_line(0, line_max_column);
+		return;
 	}
 
-	auto append_document_visual_line = [&](int doc_line, int start_column, int end_column, int& visual_index) {
-		if (doc_line < 0 || doc_line >= line_count)
-			return;
-		if (doc_line >= 0 && doc_line < static_cast<int>(mDocumentToVisual.size()) &&
-		    mDocumentToVisual[static_cast<std::size_t>(doc_line)] < 0)
+	const auto& line = mLines[static_cast<std::size_t>(aLine)];
+	const int line_size = static_cast<int>(line.size());
+	int segment_start_index = 0;
+	int segment_start_column = 0;
+	int char_index = 0;
+	int column = 0;
+	int last_break_index = -1;
+	int last_break_column = -1;
+
+	while (char_index < line_size)
+	{
+		const int glyph_index = char_index;
+		const int glyph_column_start = column;
+		MoveCharIndexAndColumn(aLine, char_index, column);
+
+		const bool can_break_after =
+			std::isspace(static_cast<unsigned char>(line[static_cast<std::size_t>(glyph_index)].mChar)) != 0;
+		if (can_break_after)
 		{
-			mDocumentToVisual[static_cast<std::size_t>(doc_line)] = visual_index;
+			last_break_index = char_index;
+			last_break_column = column;
 		}
 
-		VisualLine entry{};
-		entry.mDocumentLine = doc_line;
-		entry.mWrapStartColumn = Max(0, start_column);
-		entry.mWrapEndColumn = Max(entry.mWrapStartColumn, end_column);
-		mVisualLines.push_back(entry);
-		++visual_index;
-	};
+		if (column - segment_start_column <= aWrapColumn)
+			continue;
 
-	auto append_wrapped_document_lines = [&](int doc_line, int& visual_index) {
-		const int line_max_column = GetLineMaxColumn(doc_line);
-		if (line_max_column <= effective_wrap_column || effective_wrap_column <= 0)
+		int break_index = char_index;
+		int break_column = column;
+		if (last_break_index > segment_start_index && last_break_column > segment_start_column)
 		{
-			append_document_visual_line(doc_line, 0, line_max_column, visual_index);
-			return;
+			break_index = last_break_index;
+			break_column = last_break_column;
+		}
+		else if (glyph_column_start > segment_start_column)
+		{
+			break_index = glyph_index;
+			break_column = glyph_column_start;
 		}
 
-		const auto& line = mLines[static_cast<std::size_t>(doc_line)];
-		const int line_size = static_cast<int>(line.size());
-		int segment_start_index = 0;
-		int segment_start_column = 0;
-		int char_index = 0;
-		int column = 0;
-		int last_break_index = -1;
-		int last_break_column = -1;
-
-		while (char_index < line_size)
+		if (break_index <= segment_start_index || break_column <= segment_start_column)
 		{
-			const int glyph_index = char_index;
-			const int glyph_column_start = column;
-			MoveCharIndexAndColumn(doc_line, char_index, column);
+			break_index = char_index;
+			break_column = column;
+		}
 
-			const bool can_break_after =
-				std::isspace(static_cast<unsigned char>(line[static_cast<std::size_t>(glyph_index)].mChar)) != 0;
-			if (can_break_after)
-			{
-				last_break_index = char_index;
-				last_break_column = column;
-			}
+		append_document_visual_line(segment_start_column, break_column);
 
-			if (column - segment_start_column <= effective_wrap_column)
-				continue;
+		segment_start_index = break_index;
+		segment_start_column = break_column;
+		char_index = break_index;
+		column = break_column;
+		last_break_index = -1;
+		last_break_column = -1;
+	}
 
-			int break_index = char_index;
-			int break_column = column;
-			if (last_break_index > segment_start_index && last_break_column > segment_start_column)
-			{
-				break_index = last_break_index;
-				break_column = last_break_column;
-			}
-			else if (glyph_column_start > segment_start_column)
-			{
-				break_index = glyph_index;
-				break_column = glyph_column_start;
-			}
+	if (line_max_column == 0 || segment_start_column < line_max_column)
+	{
+		append_document_visual_line(segment_start_column, line_max_column);
+	}
+}
 
-			if (break_index <= segment_start_index || break_column <= segment_start_column)
-			{
-				break_index = char_index;
-				break_column = column;
-			}
+void TextEditor::EnsureVisualLines() const
+{
+	if (IsVisualLineCacheCurrent())
+		return;
 
-			append_document_visual_line(doc_line, segment_start_column, break_column, visual_index);
+	ScopedProfileTimer const timer(*this, ProfileScope::VisualLines);
 
-			segment_start_index = break_index;
-			segment_start_column = break_column;
-			char_index = break_index;
-			column = break_column;
-			last_break_index = -1;
-			last_break_column = -1;
-		}
+	const int line_count = static_cast<int>(mLines.size());
+	const int effective_wrap_column = mWordWrapEnabled ? Max(1, mWrapColumn) : 0;
 
-		if (line_max_column == 0 || segment_start_column < line_max_column)
-		{
-			append_document_visual_line(doc_line, segment_start_column, line_max_column, visual_index);
-		}
-	};
+	mVisualLines.clear();
+	mDocumentToVisual.clear();
+	mDocumentToVisual.resize(static_cast<std::size_t>(std::max(0, line_count)), -1);
+
+	std::vector<std::vector<int>> ghost_buckets;
+	ghost_buckets.resize(static_cast<std::size_t>(std::max(0, line_count) + 1), {});
+
+	for (std::size_t i = 0; i < mGhostLines.size(); ++i)
+	{
+		ghost_buckets[static_cast<std::size_t>(GetGhostLineAnchor(static_cast<int>(i)))].push_back(static_cast<int>(i));
+	}
 
-	int visual_index = 0;
 	std::size_t hidden_index = 0;
 	for (int doc_line = 0; doc_line < line_count; ++doc_line)
 	{
@@ -1004,7 +1289,6 @@ void TextEditor::EnsureVisualLines() const
 			entry.mIsGhost = true;
 			entry.mGhostIndex = ghost_index;
 			mVisualLines.push_back(entry);
-			++visual_index;
 		}
 
 		while (hidden_index < mHiddenLineRanges.size() &&
@@ -1022,14 +1306,8 @@ void TextEditor::EnsureVisualLines() const
 			continue;
 		}
 
-		if (mWordWrapEnabled)
-		{
-			append_wrapped_document_lines(doc_line, visual_index);
-		}
-		else
-		{
-			append_document_visual_line(doc_line, 0, GetLineMaxColumn(doc_line), visual_index);
-		}
+		mDocumentToVisual[static_cast<std::size_t>(doc_line)] = static_cast<int>(mVisualLines.size());
+		AppendDocumentVisualLines(doc_line, effective_wrap_column, mVisualLines);
 	}
 
 	for (int ghost_index : ghost_buckets[static_cast<std::size_t>(line_count)])
@@ -1038,7 +1316,6 @@ void TextEditor::EnsureVisualLines() const
 		entry.mIsGhost = true;
 		entry.mGhostIndex = ghost_index;
 		mVisualLines.push_back(entry);
-		++visual_index;
 	}
 
 	mCachedLineCount = line_count;
@@ -1049,6 +1326,98 @@ void TextEditor::EnsureVisualLines() const
 	mCachedWrapColumn = effective_wrap_column;
 }
 
+int TextEditor::GetGhostLineAnchor(int aGhostIndex) const
+{
+	const int line_count = static_cast<int>(mLines.size());
+	return std::clamp(mGhostLines[static_cast<std::size_t>(aGhostIndex)].mAnchorLine, 0, std::max(line_count, 0));
+}
+
+void TextEditor::UpdateVisualLines(int aFirstLine, int aLastLine) const
+{
+	const int line_count = static_cast<int>(mLines.size());
+	aFirstLine = std::max(aFirstLine, 0);
+	aLastLine = std::min(aLastLine, line_count - 1);
+	if (aFirstLine > aLastLine)
+		return;
+
+	ScopedProfileTimer const timer(*this, ProfileScope::VisualLines);
+
+	const auto is_content_of = [&](std::size_t index, int doc_line) {
+		return !mVisualLines[index].mIsGhost && mVisualLines[index].mDocumentLine == doc_line;
+	};
+	const auto is_ghost_before = [&](std::size_t index, int doc_line) {
+		return mVisualLines[index].mIsGhost && GetGhostLineAnchor(mVisualLines[index].mGhostIndex) < doc_line;
+	};
+
+	// Entries of the lines above the span didn't change: start after the last visible one
+	int previous = aFirstLine - 1;
+	const auto covering = std::upper_bound(mHiddenLineRanges.begin(), mHiddenLineRanges.end(), previous,
+		[](int line, const LineRange& range) { return line < range.mStartLine; });
+	if (covering != mHiddenLineRanges.begin() && previous <= std::prev(covering)->mEndLine)
+		previous = std::prev(covering)->mStartLine - 1;
+
+	std::size_t begin = 0;
+	if (previous >= 0)
+	{
+		begin = static_cast<std::size_t>(mDocumentToVisual[static_cast<std::size_t>(previous)]);
+		while (begin < mVisualLines.size() && is_content_of(begin, previous))
+			++begin;
+	}
+	while (begin < mVisualLines.size() && is_ghost_before(begin, aFirstLine))
+		++begin;
+
+	std::size_t end = begin;
+	while (end < mVisualLines.size() &&
+	       (is_ghost_before(end, aLastLine + 1) ||
+	        (!mVisualLines[end].mIsGhost && mVisualLines[end].mDocumentLine <= aLastLine)))
+	{
+		++end;
+	}
+
+	// Ghost lines keep their place, document lines follow the new hidden ranges
+	const int effective_wrap_column = mWordWrapEnabled ? Max(1, mWrapColumn) : 0;
+	std::vector<VisualLine> replacement;
+	replacement.reserve(end - begin);
+	std::size_t ghost = begin;
+	auto hidden = std::lower_bound(mHiddenLineRanges.begin(), mHiddenLineRanges.end(), aFirstLine,
+		[](const LineRange& range, int line) { return range.mEndLine < line; });
+	for (int doc_line = aFirstLine; doc_line <= aLastLine; ++doc_line)
+	{
+		for (; ghost < end; ++ghost)
+		{
+			if (!mVisualLines[ghost].mIsGhost)
+				continue;
+			if (GetGhostLineAnchor(mVisualLines[ghost].mGhostIndex) > doc_line)
+				break;
+			replacement.push_back(mVisualLines[ghost]);
+		}
+
+		while (hidden != mHiddenLineRanges.end() && hidden->mEndLine < doc_line)
+			++hidden;
+		auto& mapped = mDocumentToVisual[static_cast<std::size_t>(doc_line)];
+		if (hidden != mHiddenLineRanges.end() && doc_line >= hidden->mStartLine)
+		{
+			mapped = -1;
+			continue;
+		}
+		mapped = static_cast<int>(begin + replacement.size());
+		AppendDocumentVisualLines(doc_line, effective_wrap_column, replacement);
+	}
+
+	const int delta = static_cast<int>(replacement.size()) - static_cast<int>(end - begin);
+	mVisualLines.erase(mVisualLines.begin() + static_cast<std::ptrdiff_t>(begin),
+	                   mVisualLines.begin() + static_cast<std::ptrdiff_t>(end));
+	mVisualLines.insert(mVisualLines.begin() + static_cast<std::ptrdiff_t>(begin), replacement.begin(), replacement.end());
+	if (delta != 0)
+	{
+		for (auto it = mDocumentToVisual.begin() + aLastLine + 1; it != mDocumentToVisual.end(); ++it)
+		{
+			if (*it >= 0)
+				*it += delta;
+		}
+	}
+}
+
 int TextEditor::GetVisualLineCount() const
 {
 	EnsureVisualLines();
@@ -1591,10 +1960,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 	if (hasSelection)
 	{
 		for (int c = mState.mCurrentCursor; c > -1; c--)
-		{
-			u.mOperations.push_back({ GetSelectedText(c), mState.mCursors[c].GetSelectionStart(), mState.mCursors[c].GetSelectionEnd(), UndoOperationType::Delete });
-			DeleteSelection(c);
-		}
+			DeleteSelection(c, u);
 	}
 
 	std::vector<Coordinates> coords;
@@ -1697,12 +2063,7 @@ void TextEditor::Delete(bool aWordMode, const EditorState* aEditorState)
 		UndoRecord u;
 		u.mBefore = aEditorState == nullptr ? mState : *aEditorState;
 		for (int c = mState.mCurrentCursor; c > -1; c--)
-		{
-			if (!mState.mCursors[c].HasSelection())
-				continue;
-			u.mOperations.push_back({ GetSelectedText(c), mState.mCursors[c].GetSelectionStart(), mState.mCursors[c].GetSelectionEnd(), UndoOperationType::Delete });
-			DeleteSelection(c);
-		}
+			DeleteSelection(c, u);
 		u.mAfter = mState;
 		AddUndo(u);
 	}
@@ -1752,6 +2113,8 @@ void TextEditor::SetSelection(int aStartLine, int aStartChar, int aEndLine, int
 
 void TextEditor::SelectNextOccurrenceOf(const char* aText, int aTextSize, int aCursor, bool aCaseSensitive)
 {
+	if (aTextSize <= 0)
+		return;  // An empty text occurs everywhere, there is nothing to select
 	if (aCursor == -1)
 		aCursor = mState.mCurrentCursor;
 	Coordinates nextStart, nextEnd;
@@ -1767,6 +2130,8 @@ void TextEditor::AddCursorForNextOccurrence(bool aCaseSensitive)
 		return;
 
 	std::string selectionText = GetText(currentCursor.GetSelectionStart(), currentCursor.GetSelectionEnd());
+	if (selectionText.empty())
+		return;  // Both ends inside the same tab
 	Coordinates nextStart, nextEnd;
 	if (!FindNextOccurrence(selectionText.c_str(), static_cast<int>(selectionText.size()), currentCursor.GetSelectionEnd(), nextStart, nextEnd, aCaseSensitive))
 		return;
@@ -1906,63 +2271,144 @@ bool TextEditor::FindNextOccurrence(const char* aText, int aTextSize, const Coor
 
 bool TextEditor::FindMatchingBracket(int aLine, int aCharIndex, Coordinates& out)
 {
-	if (aLine > static_cast<int>(mLines.size()) - 1)
+	if (aLine < 0 || aLine > static_cast<int>(mLines.size()) - 1)
 		return false;
 	int maxCharIndex = static_cast<int>(mLines[aLine].size()) - 1;
-	if (aCharIndex > maxCharIndex)
+	if (aCharIndex < 0 || aCharIndex > maxCharIndex)
+		return false;
+	if (!IsCodeBracket(mLines[aLine][aCharIndex]))
+		return false;
+
+	SyncBracketIndex();
+	const auto& anchorTokens = GetBracketTokens(aLine);
+	const auto anchor = std::lower_bound(anchorTokens.begin(), anchorTokens.end(), aCharIndex,
+		[](const BracketToken& aToken, int aIndex) { return aToken.mCharIndex < aIndex; });
+	if (anchor == anchorTokens.end() || anchor->mCharIndex != aCharIndex)
 		return false;
 
-	int currentLine = aLine;
-	int currentCharIndex = aCharIndex;
+	const char anchorChar = anchor->mChar;
+	const bool forward = matching_close_bracket(anchorChar).has_value();
+	const char openChar = forward ? anchorChar : *matching_open_bracket(anchorChar);
+	const char closeChar = forward ? *matching_close_bracket(anchorChar) : anchorChar;
+	const char towards = forward ? closeChar : openChar;
+	const char away = forward ? openChar : closeChar;
+
+	// Only bracket tokens are visited, and at most mBracketMatchingLineLimit lines past the anchor
+	const int lineCount = static_cast<int>(mLines.size());
+	const int lastLine = mBracketMatchingLineLimit == 0 ? (forward ? lineCount - 1 : 0)
+		: (forward ? Min(lineCount - 1, aLine + mBracketMatchingLineLimit) : Max(0, aLine - mBracketMatchingLineLimit));
+	const int step = forward ? 1 : -1;
 	int counter = 1;
-	const char anchor_char = mLines[aLine][aCharIndex].mChar;
-	if (const auto open_char = matching_open_bracket(anchor_char); open_char.has_value())
+	for (int currentLine = aLine; forward ? currentLine <= lastLine : currentLine >= lastLine; currentLine += step)
 	{
-		const char closeChar = anchor_char;
-		const char openChar = *open_char;
-		while (Move(currentLine, currentCharIndex, true))
+		const auto& tokens = GetBracketTokens(currentLine);
+		int first = forward ? 0 : static_cast<int>(tokens.size()) - 1;
+		if (currentLine == aLine)
+			first = static_cast<int>(anchor - anchorTokens.begin()) + step;
+		for (int i = first; i >= 0 && i < static_cast<int>(tokens.size()); i += step)
 		{
-			if (currentCharIndex < static_cast<int>(mLines[currentLine].size()))
+			if (tokens[i].mChar == away)
+				counter++;
+			else if (tokens[i].mChar == towards && --counter == 0)
 			{
-				char currentChar = mLines[currentLine][currentCharIndex].mChar;
-				if (currentChar == openChar)
-				{
-					counter--;
-					if (counter == 0)
-					{
-						out = { currentLine, GetCharacterColumn(currentLine, currentCharIndex) };
-						return true;
-					}
-				}
-				else if (currentChar == closeChar)
-					counter++;
+				out = { currentLine, GetCharacterColumn(currentLine, tokens[i].mCharIndex) };
+				return true;
 			}
 		}
 	}
-	else if (const auto close_char = matching_close_bracket(anchor_char); close_char.has_value())
+	return false;
+}
+
+bool TextEditor::IsCodeBracket(const Glyph& aGlyph) const
+{
+	if (!matching_open_bracket(aGlyph.mChar).has_value() && !matching_close_bracket(aGlyph.mChar).has_value())
+		return false;
+	const TokenClass tokenClass = GetTokenClass(aGlyph);
+	return tokenClass != TokenClass::Comment && tokenClass != TokenClass::String;
+}
+
+TextEditor::TokenClass TextEditor::GetTokenClass(const Glyph& aGlyph) const
+{
+	if (mLanguageDefinition == nullptr)
+		return TokenClass::Code;  // Glyph flags are left over from the previous language, if any
+	if (aGlyph.mComment || aGlyph.mMultiLineComment)
+		return TokenClass::Comment;
+	if (aGlyph.mColorIndex == PaletteIndex::String || aGlyph.mColorIndex == PaletteIndex::CharLiteral)
+		return TokenClass::String;
+	if (aGlyph.mPreprocessor)
+		return TokenClass::Preprocessor;
+	return TokenClass::Code;
+}
+
+void TextEditor::RecordTokenClassChange(int aFromLine, int aToLine)
+{
+	InvalidateBracketLines(aFromLine, aToLine);
+	mTokenClassChanges.Record(aFromLine, aToLine - aFromLine, aToLine - aFromLine);
+	mColorChanges.Record(aFromLine, aToLine - aFromLine, aToLine - aFromLine);
+}
+
+void TextEditor::RecordColorChange(int aFromLine, int aToLine)
+{
+	mColorChanges.Record(aFromLine, aToLine - aFromLine, aToLine - aFromLine);
+}
+
+void TextEditor::SyncBracketIndex()
+{
+	if (!mBracketLines.empty() && mBracketIndexVersion == mLineChanges.mVersion)
+		return;
+
+	mBracketIndexChanges.clear();
+	if (mBracketLines.empty() || !GetLineChangesSince(mBracketIndexVersion, mBracketIndexChanges))
+		mBracketIndexChanges.clear();
+	else
 	{
-		const char openChar = anchor_char;
-		const char closeChar = *close_char;
-		while (Move(currentLine, currentCharIndex))
+		for (const auto& change : mBracketIndexChanges)
 		{
-			if (currentCharIndex < static_cast<int>(mLines[currentLine].size()))
+			if (change.mFirstLine + change.mOldCount > static_cast<int>(mBracketLines.size()))
 			{
-				char currentChar = mLines[currentLine][currentCharIndex].mChar;
-				if (currentChar == closeChar)
-				{
-					counter--;
-					if (counter == 0)
-					{
-						out = { currentLine, GetCharacterColumn(currentLine, currentCharIndex) };
-						return true;
-					}
-				}
-				else if (currentChar == openChar)
-					counter++;
+				mBracketIndexChanges.clear();
+				break;
 			}
+			const auto first = mBracketLines.begin() + change.mFirstLine;
+			const int common = Min(change.mOldCount, change.mNewCount);
+			for (int i = 0; i < common; ++i)
+				first[i] = BracketLine();
+			if (change.mOldCount > common)
+				mBracketLines.erase(first + common, first + change.mOldCount);
+			else if (change.mNewCount > common)
+				mBracketLines.insert(first + common, change.mNewCount - common, BracketLine());
 		}
 	}
-	return false;
+	if (mBracketIndexChanges.empty() || mBracketLines.size() != mLines.size())
+		mBracketLines.assign(mLines.size(), BracketLine());
+	mBracketIndexVersion = mLineChanges.mVersion;
+}
+
+void TextEditor::InvalidateBracketLines(int aFromLine, int aToLine)
+{
+	if (mBracketLines.empty())
+		return;
+	SyncBracketIndex();
+	const int toLine = Min(aToLine, static_cast<int>(mBracketLines.size()));
+	for (int i = Max(0, aFromLine); i < toLine; ++i)
+		mBracketLines[i].mValid = false;
+}
+
+auto TextEditor::GetBracketTokens(int aLine) -> const std::vector<BracketToken>&
+{
+	auto& bracketLine = mBracketLines[aLine];
+	if (!bracketLine.mValid)
+	{
+		bracketLine.mTokens.clear();
+		const auto& line = mLines[aLine];
+		for (int i = 0; i < static_cast<int>(line.size()); ++i)
+		{
+			if (IsCodeBracket(line[i]))
+				bracketLine.mTokens.push_back({ i, line[i].mChar });
+		}
+		bracketLine.mValid = true;
+	}
+	return bracketLine.mTokens;
 }
 
 void TextEditor::ChangeCurrentLinesIndentation(bool aIncrease)
@@ -2041,6 +2487,7 @@ void TextEditor::MoveUpCurrentLines()
 
 	for (int line : affectedLines) // lines should be sorted here
 		std::swap(mLines[line - 1], mLines[line]);
+	RecordLineChange(minLine - 1, maxLine - minLine + 2, maxLine - minLine + 2);
 	for (int c = mState.mCurrentCursor; c > -1; c--)
 	{
 		mState.mCursors[c].mInteractiveStart.mLine -= 1;
@@ -2093,11 +2540,16 @@ void TextEditor::MoveDownCurrentLines()
 	std::set<int>::reverse_iterator rit;
 	for (rit = affectedLines.rbegin(); rit != affectedLines.rend(); rit++) // lines should be sorted here
 		std::swap(mLines[*rit + 1], mLines[*rit]);
+	RecordLineChange(minLine, maxLine - minLine + 2, maxLine - minLine + 2);
 	for (int c = mState.mCurrentCursor; c > -1; c--)
 	{
 		mState.mCursors[c].mInteractiveStart.mLine += 1;
 		mState.mCursors[c].mInteractiveEnd.mLine += 1;
 		// no need to set mCursorPositionChanged as cursors will remain sorted
+		const int lastLine = static_cast<int>(mLines.size()) - 1;
+		for (Coordinates* position : { &mState.mCursors[c].mInteractiveStart, &mState.mCursors[c].mInteractiveEnd })
+			if (position->mLine > lastLine) // selection ended at the start of the last line
+				*position = { lastLine, GetLineMaxColumn(lastLine) };
 	}
 
 	end = { maxLine + 1, GetLineMaxColumn(maxLine + 1) }; // this line is swapped with line below, need to find new max column
@@ -2185,12 +2637,7 @@ void TextEditor::RemoveCurrentLines()
 	if (AnyCursorHasSelection())
 	{
 		for (int c = mState.mCurrentCursor; c > -1; c--)
-		{
-			if (!mState.mCursors[c].HasSelection())
-				continue;
-			u.mOperations.push_back({ GetSelectedText(c), mState.mCursors[c].GetSelectionStart(), mState.mCursors[c].GetSelectionEnd(), UndoOperationType::Delete });
-			DeleteSelection(c);
-		}
+			DeleteSelection(c, u);
 	}
 	MoveHome();
 	OnCursorPositionChanged(); // might combine cursors
@@ -2220,6 +2667,8 @@ void TextEditor::RemoveCurrentLines()
 			toDeleteEnd = Coordinates(currentLine, GetLineMaxColumn(currentLine));
 			SetCursorPosition({ currentLine, 0 }, c);
 		}
+		if (toDeleteStart == toDeleteEnd)
+			continue;  // The only line is already empty
 
 		u.mOperations.push_back({ GetText(toDeleteStart, toDeleteEnd), toDeleteStart, toDeleteEnd, UndoOperationType::Delete });
 
@@ -2438,8 +2887,12 @@ void TextEditor::ReapplySemanticTokens()
 		auto style = GetStyleForSemanticToken(token.mType, token.mModifiers);
 		if (style.colorIndex == PaletteIndex::Default) continue;
 
+		bool classChanged = false;
+		bool colorChanged = false;
 		for (int i = startIdx; i < endIdx; ++i)
 		{
+			const TokenClass previousClass = GetTokenClass(line[i]);
+			const ImU32 previousColor = GetGlyphColor(line[i]);
 			line[i].mColorIndex = style.colorIndex;
 			line[i].mComment = (style.colorIndex == PaletteIndex::Comment);
 			line[i].mPreprocessor = (style.colorIndex == PaletteIndex::Preprocessor ||
@@ -2449,7 +2902,13 @@ void TextEditor::ReapplySemanticTokens()
 			line[i].mBold = style.bold;
 			line[i].mUnderline = style.underline;
 			line[i].mStrikethrough = style.strikethrough;
+			classChanged = classChanged || previousClass != GetTokenClass(line[i]);
+			colorChanged = colorChanged || previousColor != GetGlyphColor(line[i]);
 		}
+		if (classChanged)
+			RecordTokenClassChange(token.mLine, token.mLine + 1);
+		else if (colorChanged)
+			RecordColorChange(token.mLine, token.mLine + 1);
 	}
 }
 
@@ -2660,6 +3119,7 @@ TextEditor::Line& TextEditor::InsertLine(int aIndex)
 {
 	assert(!mReadOnly);
 	auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
+	RecordLineChange(aIndex, 0, 1);
 
 	for (int c = 0; c <= mState.mCurrentCursor; c++) // handle multiple cursors
 	{
@@ -2677,6 +3137,7 @@ void TextEditor::RemoveLine(int aIndex, const std::unordered_set<int>* aHandledC
 
 	mLines.erase(mLines.begin() + aIndex);
 	assert(!mLines.empty());
+	RecordLineChange(aIndex, 1, 0);
 
 	// handle multiple cursors
 	for (int c = 0; c <= mState.mCurrentCursor; c++)
@@ -2697,6 +3158,7 @@ void TextEditor::RemoveLines(int aStart, int aEnd)
 
 	mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
 	assert(!mLines.empty());
+	RecordLineChange(aStart, aEnd - aStart, 0);
 
 	// handle multiple cursors
 	for (int c = 0; c <= mState.mCurrentCursor; c++)
@@ -2774,15 +3236,72 @@ void TextEditor::DeleteSelection(int aCursor)
 	if (aCursor == -1)
 		aCursor = mState.mCurrentCursor;
 
-	if (mState.mCursors[aCursor].GetSelectionEnd() == mState.mCursors[aCursor].GetSelectionStart())
+	// Sanitized, so a selection end inside a tab or past the line end deletes what undo restores
+	Coordinates newCursorPos = SanitizeCoordinates(mState.mCursors[aCursor].GetSelectionStart());
+	const Coordinates end = SanitizeCoordinates(mState.mCursors[aCursor].GetSelectionEnd());
+	if (end == newCursorPos)
 		return;
 
-	Coordinates newCursorPos = mState.mCursors[aCursor].GetSelectionStart();
-	DeleteRange(newCursorPos, mState.mCursors[aCursor].GetSelectionEnd());
+	DeleteRange(newCursorPos, end);
 	SetCursorPosition(newCursorPos, aCursor);
 	Colorize(newCursorPos.mLine, 1);
 }
 
+void TextEditor::DeleteSelection(int aCursor, UndoRecord& aRecord)
+{
+	const Coordinates start = SanitizeCoordinates(mState.mCursors[aCursor].GetSelectionStart());
+	const Coordinates end = SanitizeCoordinates(mState.mCursors[aCursor].GetSelectionEnd());
+	if (end == start)
+		return;
+
+	aRecord.mOperations.push_back({ GetText(start, end), start, end, UndoOperationType::Delete });
+	DeleteSelection(aCursor);
+}
+
+void TextEditor::RecordLineChange(int aFirstLine, int aOldCount, int aNewCount)
+{
+	mLineChanges.Record(aFirstLine, aOldCount, aNewCount);
+	mTokenClassChanges.Record(aFirstLine, aOldCount, aNewCount);
+	mColorChanges.Record(aFirstLine, aOldCount, aNewCount);
+}
+
+void TextEditor::LineChangeLog::Record(int aFirstLine, int aOldCount, int aNewCount)
+{
+	++mVersion;
+
+	if (!mChanges.empty())
+	{
+		// Coalesce with the previous change when the two touch and nobody can hold the
+		// document state in between. Once that version has been handed out, only an in-place
+		// change inside the previous in-place block is folded in: re-reading those lines is
+		// harmless, shifting them twice would not be.
+		auto& last = mChanges[(mHead + mChanges.size() - 1) % mChanges.size()];
+		const bool touches = aFirstLine <= last.mFirstLine + last.mNewCount && aFirstLine + aOldCount >= last.mFirstLine;
+		const bool rewritesLast = aOldCount == aNewCount && last.mOldCount == last.mNewCount &&
+			aFirstLine >= last.mFirstLine && aFirstLine + aOldCount <= last.mFirstLine + last.mNewCount;
+		if (rewritesLast || (touches && last.mVersion > mObservedVersion))
+		{
+			const int first = Min(last.mFirstLine, aFirstLine);
+			const int end = Max(last.mFirstLine + last.mNewCount, aFirstLine + aOldCount);
+			last.mOldCount = end - (last.mNewCount - last.mOldCount) - first;
+			last.mNewCount = end + (aNewCount - aOldCount) - first;
+			last.mFirstLine = first;
+			last.mVersion = mVersion;
+			return;
+		}
+	}
+
+	const LineChange change{ mVersion, aFirstLine, aOldCount, aNewCount };
+	if (mChanges.size() < line_change_history_size)
+	{
+		mChanges.push_back(change);
+		return;
+	}
+	mBaseVersion = mChanges[mHead].mVersion;
+	mChanges[mHead] = change;
+	mHead = (mHead + 1) % mChanges.size();
+}
+
 void TextEditor::RemoveGlyphsFromLine(int aLine, int aStartChar, int aEndChar)
 {
 	int column = GetCharacterColumn(aLine, aStartChar);
@@ -2790,6 +3309,7 @@ void TextEditor::RemoveGlyphsFromLine(int aLine, int aStartChar, int aEndChar)
 	OnLineChanged(true, aLine, column, aEndChar - aStartChar, true);
 	line.erase(line.begin() + aStartChar, aEndChar == -1 ? line.end() : line.begin() + aEndChar);
 	OnLineChanged(false, aLine, column, aEndChar - aStartChar, true);
+	RecordLineChange(aLine, 1, 1);
 	++mLinesRevision;  // Invalidate visual line cache
 }
 
@@ -2801,6 +3321,7 @@ void TextEditor::AddGlyphsToLine(int aLine, int aTargetIndex, Line::iterator aSo
 	OnLineChanged(true, aLine, targetColumn, charsInserted, false);
 	line.insert(line.begin() + aTargetIndex, aSourceStart, aSourceEnd);
 	OnLineChanged(false, aLine, targetColumn, charsInserted, false);
+	RecordLineChange(aLine, 1, 1);
 	++mLinesRevision;  // Invalidate visual line cache
 }
 
@@ -2811,6 +3332,7 @@ void TextEditor::AddGlyphToLine(int aLine, int aTargetIndex, Glyph aGlyph)
 	OnLineChanged(true, aLine, targetColumn, 1, false);
 	line.insert(line.begin() + aTargetIndex, aGlyph);
 	OnLineChanged(false, aLine, targetColumn, 1, false);
+	RecordLineChange(aLine, 1, 1);
 	++mLinesRevision;  // Invalidate visual line cache
 }
 
@@ -3217,6 +3739,8 @@ void TextEditor::Render(bool aParentIsFocused)
 	const int visual_line_count = GetVisualLineCount();
 		if (visual_line_count > 0)
 		{
+			ScopedProfileTimer const drawLinesTimer(*this, ProfileScope::DrawLines);
+			int glyphsDrawn = 0;
 			auto drawList = ImGui::GetWindowDrawList();
 			auto* font = ImGui::GetFont();
 			auto draw_text = [drawList, font, fontSize](const ImVec2& pos, ImU32 color, const char* text) {
@@ -3417,6 +3941,7 @@ void TextEditor::Render(bool aParentIsFocused)
 					text_color,
 					ghost.mText.data() + char_index,
 					ghost.mText.data() + char_index + seqLength);
+				++glyphsDrawn;
 
 				column += 1;
 				char_index += seqLength;
@@ -3751,6 +4276,7 @@ void TextEditor::Render(bool aParentIsFocused)
 							glyph_utf8[static_cast<std::size_t>(i)] = line[charIndex + i].mChar;
 						glyph_utf8[static_cast<std::size_t>(safe_seq_length)] = '\0';
 						draw_text(targetGlyphPos, color, glyph_utf8.data());
+						++glyphsDrawn;
 
 					// Render style decorations for semantic tokens
 					float glyphWidth = mCharAdvance.x * seqLength;
@@ -3818,6 +4344,7 @@ void TextEditor::Render(bool aParentIsFocused)
 				}
 			}
 		}
+		mCurrentFrameStats.mGlyphsDrawn += glyphsDrawn;
 	}
 		const int maxColumns = mWordWrapEnabled ? Max(mWrapColumn, maxGhostColumn) : Max(maxColumnLimited, maxGhostColumn);
 		const int space_line_count = Max(visual_line_count, 1);
@@ -4015,7 +4542,11 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 	boost::cmatch results;
 	std::string id;
 
+	std::vector<TokenClass> classes;
+	std::vector<ImU32> colors;
+
 	int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
+	mCurrentFrameStats.mLinesColorized += Max(0, endLine - aFromLine);
 	for (int i = aFromLine; i < endLine; ++i)
 	{
 		auto& line = mLines[i];
@@ -4024,10 +4555,14 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 			continue;
 
 		buffer.resize(line.size());
+		classes.resize(line.size());
+		colors.resize(line.size());
 		for (size_t j = 0; j < line.size(); ++j)
 		{
 			auto& col = line[j];
 			buffer[j] = col.mChar;
+			classes[j] = GetTokenClass(col);
+			colors[j] = GetGlyphColor(col);
 			col.mColorIndex = PaletteIndex::Default;
 		}
 
@@ -4111,6 +4646,20 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 				first = token_end;
 			}
 		}
+
+		bool colorChanged = false;
+		for (size_t j = 0; j < line.size(); ++j)
+		{
+			if (classes[j] != GetTokenClass(line[j]))
+			{
+				RecordTokenClassChange(i, i + 1);
+				colorChanged = false;
+				break;
+			}
+			colorChanged = colorChanged || colors[j] != GetGlyphColor(line[j]);
+		}
+		if (colorChanged)
+			RecordColorChange(i, i + 1);
 	}
 }
 
@@ -4160,6 +4709,8 @@ void TextEditor::ColorizeInternal()
 			{
 				auto& g = line[currentIndex];
 				auto c = g.mChar;
+				const TokenClass previousClass = GetTokenClass(g);
+				const ImU32 previousColor = GetGlyphColor(g);
 
 				if (c != mLanguageDefinition->mPreprocChar &&
 					isspace(static_cast<unsigned char>(c)) == 0)
@@ -4170,27 +4721,35 @@ void TextEditor::ColorizeInternal()
 
 				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
 
+				// Every flag is rewritten, so none is left over from text that was here before
+				const auto markStringGlyph = [&](Glyph& aGlyph) {
+					aGlyph.mMultiLineComment = inComment;
+					aGlyph.mComment = withinSingleLineComment;
+					aGlyph.mPreprocessor = withinPreproc;
+				};
+
 				if (withinString)
 				{
-					line[currentIndex].mMultiLineComment = inComment;
+					markStringGlyph(g);
 
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].mMultiLineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
+					// A doubled quote or an escaped character is skipped as a pair
+					if ((c == '\"' && currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"') || c == '\\')
 					{
 						currentIndex += 1;
 						if (currentIndex < (int)line.size())
-							line[currentIndex].mMultiLineComment = inComment;
+						{
+							auto& next = line[currentIndex];
+							const TokenClass nextClass = GetTokenClass(next);
+							const ImU32 nextColor = GetGlyphColor(next);
+							markStringGlyph(next);
+							if (nextClass != GetTokenClass(next))
+								RecordTokenClassChange(currentLine, currentLine + 1);
+							else if (nextColor != GetGlyphColor(next))
+								RecordColorChange(currentLine, currentLine + 1);
+						}
 					}
+					else if (c == '\"')
+						withinString = false;
 				}
 				else
 				{
@@ -4200,7 +4759,7 @@ void TextEditor::ColorizeInternal()
 					if (c == '\"')
 					{
 						withinString = true;
-						line[currentIndex].mMultiLineComment = inComment;
+						markStringGlyph(g);
 					}
 					else
 					{
@@ -4238,7 +4797,25 @@ void TextEditor::ColorizeInternal()
 				}
 				if (currentIndex < (int)line.size())
 					line[currentIndex].mPreprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
+				if (previousClass != GetTokenClass(g))
+					RecordTokenClassChange(currentLine, currentLine + 1);
+				else if (previousColor != GetGlyphColor(g))
+					RecordColorChange(currentLine, currentLine + 1);
+
+				// Continuation bytes take the flags of their character, nothing else rewrites them
+				const int charLength = currentIndex < (int)line.size() ? UTF8CharLength(line[currentIndex].mChar) : 1;
+				for (int k = currentIndex + 1; k < currentIndex + charLength && k < (int)line.size(); k++)
+				{
+					const Glyph& lead = line[currentIndex];
+					if (line[k].mComment != lead.mComment || line[k].mMultiLineComment != lead.mMultiLineComment || line[k].mPreprocessor != lead.mPreprocessor)
+					{
+						line[k].mComment = lead.mComment;
+						line[k].mMultiLineComment = lead.mMultiLineComment;
+						line[k].mPreprocessor = lead.mPreprocessor;
+						RecordTokenClassChange(currentLine, currentLine + 1);
+					}
+				}
+				currentIndex += charLength;
 				if (currentIndex >= (int)line.size())
 				{
 					currentIndex = 0;
@@ -3,7 +3,9 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <map>
@@ -180,6 +182,13 @@ public:
 	inline bool IsShortTabsEnabled() const { return mShortTabs; }
 	inline void SetWordWrapEnabled(bool aValue) { mWordWrapEnabled = aValue; }
 	inline bool IsWordWrapEnabled() const { return mWordWrapEnabled; }
+	/**
+	 * @brief Limit how many lines bracket matching looks at beyond the cursor line.
+	 *
+	 * Keeps cursor moves cheap next to unbalanced brackets in large files. 0 removes the limit.
+	 */
+	inline void SetBracketMatchingLineLimit(int aValue) { mBracketMatchingLineLimit = aValue < 0 ? 0 : aValue; }
+	inline int GetBracketMatchingLineLimit() const { return mBracketMatchingLineLimit; }
 	void SetZoomLevel(float aValue);
 	[[nodiscard]] float GetZoomLevel() const { return mZoomLevel; }
 
@@ -257,6 +266,81 @@ public:
 	void SetKeyboardInputInterceptor(std::function<bool()> callback) { mKeyboardInputInterceptor = std::move(callback); }
 	inline int GetUndoIndex() const { return mUndoIndex; };
 
+	/**
+	 * @brief A block of document lines replaced by a single edit.
+	 *
+	 * Lines [mFirstLine, mFirstLine + mOldCount) of the document before the change
+	 * correspond to lines [mFirstLine, mFirstLine + mNewCount) after it. Lines outside
+	 * that block are untouched, lines after it are shifted by mNewCount - mOldCount.
+	 */
+	struct LineChange
+	{
+		std::uint64_t mVersion = 0; // document version after the change
+		int mFirstLine = 0;
+		int mOldCount = 0;
+		int mNewCount = 0;
+	};
+
+	/**
+	 * @brief Monotonically increasing counter bumped by every change to the document text.
+	 */
+	[[nodiscard]] std::uint64_t GetDocumentVersion() const;
+	/**
+	 * @brief Append the line changes recorded after aVersion to outChanges, oldest first.
+	 *
+	 * Only a bounded history is kept. Returns false when it no longer reaches back to
+	 * aVersion, in which case the caller should treat the whole document as changed.
+	 */
+	bool GetLineChangesSince(std::uint64_t aVersion, std::vector<LineChange>& outChanges) const;
+
+	/**
+	 * @brief Lexical class of a glyph, as last set by the colorizer.
+	 */
+	enum class TokenClass : std::uint8_t
+	{
+		Code,
+		Comment,
+		String,
+		Preprocessor
+	};
+
+	/**
+	 * @brief Read a glyph of the document in place, without copying the line.
+	 *
+	 * No bounds checking: aCharIndex must be below GetLineLength(aLine). Token classes
+	 * follow the colorizer, which runs a few lines per frame, so they can change without
+	 * the text changing; GetTokenClassChangesSince() reports those lines.
+	 */
+	[[nodiscard]] char GetGlyphChar(int aLine, int aCharIndex) const { return mLines[aLine][aCharIndex].mChar; }
+	[[nodiscard]] TokenClass GetGlyphTokenClass(int aLine, int aCharIndex) const { return GetTokenClass(mLines[aLine][aCharIndex]); }
+
+	/**
+	 * @brief Like GetDocumentVersion(), but also bumped when the token classes of a line change.
+	 */
+	[[nodiscard]] std::uint64_t GetTokenClassVersion() const;
+	/**
+	 * @brief Like GetLineChangesSince(), for GetTokenClassVersion().
+	 *
+	 * Reports text edits plus lines whose token classes changed, the latter as in-place
+	 * changes, so analyzers reading token classes can follow this journal alone.
+	 */
+	bool GetTokenClassChangesSince(std::uint64_t aVersion, std::vector<LineChange>& outChanges) const;
+	/**
+	 * @brief Color of a glyph as Render() draws it; same bounds rules as GetGlyphChar().
+	 */
+	[[nodiscard]] ImU32 GetGlyphColor(int aLine, int aCharIndex) const { return GetGlyphColor(mLines[aLine][aCharIndex]); }
+	/**
+	 * @brief Like GetTokenClassVersion(), but also bumped when the glyph colors of a line change.
+	 */
+	[[nodiscard]] std::uint64_t GetColorVersion() const;
+	/**
+	 * @brief Like GetLineChangesSince(), for GetColorVersion().
+	 *
+	 * Reports text edits plus lines whose glyph colors changed, including every line when
+	 * the palette changes, so views drawing glyph colors can follow this journal alone.
+	 */
+	bool GetColorChangesSince(std::uint64_t aVersion, std::vector<LineChange>& outChanges) const;
+
 	void SetText(const std::string& aText);
 	std::string GetText() const;
 
@@ -374,6 +458,18 @@ public:
 	 * @brief Hide inclusive line ranges in the editor (used for diff collapsing).
 	 */
 	void SetHiddenLineRanges(std::vector<LineRange> ranges);
+	/**
+	 * @brief Hide an inclusive line range, merged with the ranges already hidden.
+	 *
+	 * Only the visual lines of the range are rebuilt.
+	 */
+	void HideLineRange(LineRange aRange);
+	/**
+	 * @brief Show an inclusive line range again, keeping hidden ranges around it.
+	 *
+	 * Only the visual lines of the range are rebuilt.
+	 */
+	void ShowLineRange(LineRange aRange);
 	/**
 	 * @brief Clear hidden line ranges.
 	 */
@@ -512,6 +608,69 @@ public:
 	            bool aBorder = false,
 	            const render_callback& aCallback = {});
 
+	// ----------- Frame instrumentation ----------- //
+
+	/**
+	 * @brief Parts of Render() timed by the frame instrumentation.
+	 */
+	enum class ProfileScope : std::uint8_t
+	{
+		Frame,        // The whole Render() call
+		Input,        // Keyboard and mouse handling
+		Colorize,     // Colorizer pass
+		VisualLines,  // Visual line cache rebuilds, wherever they happen
+		DrawLines,    // Backgrounds, decorations and glyphs of the visible lines
+		Max
+	};
+
+	struct ProfileEvent
+	{
+		ProfileScope mScope = ProfileScope::Frame;
+		double mStartMicroseconds = 0.0;  // Since profiling was enabled
+		double mDurationMicroseconds = 0.0;
+	};
+
+	/**
+	 * @brief What one Render() call spent its time on.
+	 *
+	 * Counters cover everything the editor did since the previous frame ended, so work
+	 * triggered between frames (e.g. a colorizer pass run by an edit) is included.
+	 */
+	struct FrameStats
+	{
+		std::uint64_t mFrame = 0;  // Frames rendered since profiling was enabled
+		std::array<double, (std::size_t)ProfileScope::Max> mScopeMicroseconds{};  // Total time per scope
+		std::vector<ProfileEvent> mEvents;  // Every timed scope, in the order they ended
+		int mLinesColorized = 0;
+		int mVisualLinesRebuilt = 0;  // Document lines laid out again
+		int mGlyphsDrawn = 0;
+		int mDrawCommands = 0;  // Added to the window draw list
+		int mDrawVertices = 0;
+		int mDrawAllocations = 0;  // Draw list buffers that had to grow
+	};
+
+	/**
+	 * @brief Turn the frame instrumentation on or off; turning it on clears the history.
+	 *
+	 * While off, scopes cost a branch and counters a plain integer add.
+	 */
+	void SetProfilingEnabled(bool aEnabled);
+	[[nodiscard]] bool IsProfilingEnabled() const { return mProfilingEnabled; }
+
+	/**
+	 * @brief Recorded frames, oldest first; only the last few hundred are kept.
+	 */
+	[[nodiscard]] int GetFrameStatsCount() const { return static_cast<int>(mFrameHistory.size()); }
+	[[nodiscard]] const FrameStats& GetFrameStats(int aIndex) const;
+	[[nodiscard]] const FrameStats* GetLastFrameStats() const;
+
+	/**
+	 * @brief Recorded frames in Chrome trace event JSON, for chrome://tracing or Perfetto.
+	 */
+	[[nodiscard]] std::string ExportChromeTrace() const;
+
+	[[nodiscard]] static const char* GetProfileScopeName(ProfileScope aScope);
+
 	void ImGuiDebugPanel(const std::string& panelName = "Debug");
 	void UnitTests();
 
@@ -521,6 +680,8 @@ public:
 
 private:
 	friend class text_editor_test_peer;
+	friend class text_editor_benchmark_peer;
+	friend class text_editor_fuzz_peer;
 	// ------------- Generic utils ------------- //
 
 	static inline ImVec4 U32ColorToVec4(ImU32 in)
@@ -656,6 +817,18 @@ private:
 		EditorState mAfter;
 	};
 
+	struct BracketToken
+	{
+		int mCharIndex = 0;
+		char mChar = 0;
+	};
+
+	struct BracketLine
+	{
+		std::vector<BracketToken> mTokens;
+		bool mValid = false;
+	};
+
 	[[nodiscard]] auto GetText(const Coordinates& aStart, const Coordinates& aEnd) const -> std::string;
 	[[nodiscard]] auto GetClipboardText() const -> std::string;
 
@@ -686,6 +859,13 @@ private:
 	void AddCursorsWithLineOffset(int aLineOffset);
 	bool FindNextOccurrence(const char* aText, int aTextSize, const Coordinates& aFrom, Coordinates& outStart, Coordinates& outEnd, bool aCaseSensitive = true);
 	bool FindMatchingBracket(int aLine, int aCharIndex, Coordinates& out);
+	void SyncBracketIndex();
+	void InvalidateBracketLines(int aFromLine, int aToLine);
+	const std::vector<BracketToken>& GetBracketTokens(int aLine);
+	bool IsCodeBracket(const Glyph& aGlyph) const;
+	TokenClass GetTokenClass(const Glyph& aGlyph) const;
+	void RecordTokenClassChange(int aFromLine, int aToLine);
+	void RecordColorChange(int aFromLine, int aToLine);
 	void ChangeCurrentLinesIndentation(bool aIncrease);
 	void MoveUpCurrentLines();
 	void MoveDownCurrentLines();
@@ -712,7 +892,9 @@ private:
 	void RemoveLines(int aStart, int aEnd);
 	void DeleteRange(const Coordinates& aStart, const Coordinates& aEnd);
 	void DeleteSelection(int aCursor = -1);
+	void DeleteSelection(int aCursor, UndoRecord& aRecord);
 
+	void RecordLineChange(int aFirstLine, int aOldCount, int aNewCount);
 	void RemoveGlyphsFromLine(int aLine, int aStartChar, int aEndChar = -1);
 	void AddGlyphsToLine(int aLine, int aTargetIndex, Line::iterator aSourceStart, Line::iterator aSourceEnd);
 	void AddGlyphToLine(int aLine, int aTargetIndex, Glyph aGlyph);
@@ -749,7 +931,11 @@ private:
 		~VisualLine() = default;
 	};
 
+	bool IsVisualLineCacheCurrent() const;
 	void EnsureVisualLines() const;
+	void AppendDocumentVisualLines(int aLine, int aWrapColumn, std::vector<VisualLine>& aOut) const;
+	void UpdateVisualLines(int aFirstLine, int aLastLine) const;
+	int GetGhostLineAnchor(int aGhostIndex) const;
 	int GetVisualLineCount() const;
 	int GetVisualLineForDocumentLine(int aLine) const;
 	int GetVisualLineForCoordinates(const Coordinates& aCoords) const;
@@ -774,6 +960,52 @@ private:
 	mutable bool mCachedWordWrapEnabled = false;
 	mutable int mCachedWrapColumn = -1;
 
+	struct LineChangeLog
+	{
+		std::uint64_t mVersion = 0;
+		std::uint64_t mBaseVersion = 0;  // Oldest version Since() can still answer for
+		mutable std::uint64_t mObservedVersion = 0;  // Last version handed out; changes after it may be coalesced
+		std::vector<LineChange> mChanges;  // Ring buffer, oldest entry at mHead
+		std::size_t mHead = 0;
+
+		void Record(int aFirstLine, int aOldCount, int aNewCount);
+		std::uint64_t Observe() const;
+		bool Since(std::uint64_t aVersion, std::vector<LineChange>& outChanges) const;
+	};
+	LineChangeLog mLineChanges;  // Text edits
+	LineChangeLog mTokenClassChanges;  // Text edits and token class changes
+	LineChangeLog mColorChanges;  // Text edits, token class and glyph color changes
+
+	// Times a scope into the current frame when profiling is enabled
+	class ScopedProfileTimer
+	{
+	public:
+		ScopedProfileTimer(const TextEditor& aEditor, ProfileScope aScope);
+		~ScopedProfileTimer();
+		ScopedProfileTimer(const ScopedProfileTimer&) = delete;
+		ScopedProfileTimer& operator=(const ScopedProfileTimer&) = delete;
+
+	private:
+		const TextEditor* mEditor;  // Null while profiling is disabled
+		ProfileScope mScope;
+		std::chrono::steady_clock::time_point mStart;
+	};
+
+	// Frame boundaries; aDrawList is the window draw list the frame renders into, if any
+	void BeginProfileFrame(const ImDrawList* aDrawList);
+	void EndProfileFrame(const ImDrawList* aDrawList);
+
+	bool mProfilingEnabled = false;
+	std::chrono::steady_clock::time_point mProfileEpoch;
+	mutable FrameStats mCurrentFrameStats;
+	std::vector<FrameStats> mFrameHistory;  // Ring buffer, oldest entry at mFrameHistoryHead
+	std::size_t mFrameHistoryHead = 0;
+	std::uint64_t mFrameCounter = 0;
+	std::chrono::steady_clock::time_point mFrameStart;
+	int mFrameDrawCommandsStart = 0;
+	int mFrameDrawVerticesStart = 0;
+	std::array<int, 3> mFrameDrawCapacities{};
+
 	EditorState mState;
 	std::vector<UndoRecord> mUndoBuffer;
 	int mUndoIndex = 0;
@@ -822,6 +1054,10 @@ private:
 	std::vector<std::pair<int, int>> m_line_change_cursor_char_indices;
 	bool mCursorOnBracket = false;
 	Coordinates mMatchingBracketCoords;
+	int mBracketMatchingLineLimit = 10000;
+	std::vector<BracketLine> mBracketLines;  // Per line brackets outside strings and comments, built on demand
+	std::uint64_t mBracketIndexVersion = 0;  // Document version mBracketLines was synced to
+	std::vector<LineChange> mBracketIndexChanges;
 
 	int mColorRangeMin = 0;
 	int mColorRangeMax = 0;
@@ -14,6 +14,11 @@ void TextEditorAutocomplete::ClearProviders()
     Close();
 }
 
+TextEditorAutocomplete::~TextEditorAutocomplete()
+{
+    CancelRequest();
+}
+
 void TextEditorAutocomplete::Trigger(const TextEditor& editor, char trigger_char)
 {
     if (!config_.enabled || providers_.empty())
@@ -22,39 +27,115 @@ void TextEditorAutocomplete::Trigger(const TextEditor& editor, char trigger_char
     int line, column;
     editor.GetCursorPosition(line, column);
 
+    CancelRequest();
     trigger_line_ = line;
     trigger_column_ = column;
-
-    // Collect completions from all providers
+    owned_items_.clear();
     current_items_.clear();
+    matched_items_.clear();
+    filtered_items_.clear();
+    displayed_items_.clear();
+    filter_text_.clear();
+    selected_index_ = 0;
+    is_active_ = false;
 
-    for (const auto& provider : providers_)
+    // Ask all providers; indexed and quick ones deliver right away, slow ones when they finish
+    request_token_.cancelled_ = std::make_shared<std::atomic<bool>>(false);
+    const CompletionCallback done = [inbox = inbox_, generation = generation_](std::vector<CompletionItem> items) {
+        const std::lock_guard<std::mutex> lock(inbox->mutex);
+        inbox->deliveries.emplace_back(generation, std::move(items));
+    };
+    for (int p = 0; p < static_cast<int>(providers_.size()); ++p)
     {
-        auto items = provider->GetCompletions(editor, line, column, trigger_char);
-        current_items_.insert(current_items_.end(),
-                            std::make_move_iterator(items.begin()),
-                            std::make_move_iterator(items.end()));
+        candidates_.clear();
+        if (providers_[static_cast<std::size_t>(p)]->GetCandidates(editor, line, column, trigger_char, candidates_))
+        {
+            for (const auto& candidate : candidates_)
+                current_items_.push_back(Entry{candidate.text, candidate.priority, p, candidate.id});
+            continue;
+        }
+        ++pending_providers_;
+        providers_[static_cast<std::size_t>(p)]->GetCompletionsAsync(editor, line, column, trigger_char, request_token_, done);
     }
 
-    if (current_items_.empty())
-    {
+    if (!current_items_.empty())
+        OnItemsChanged();
+    if (!PollCompletions() && pending_providers_ == 0 && current_items_.empty())
         Close();
-        return;
+}
+
+bool TextEditorAutocomplete::PollCompletions()
+{
+    {
+        const std::lock_guard<std::mutex> lock(inbox_->mutex);
+        received_.swap(inbox_->deliveries);
     }
 
-    std::sort(current_items_.begin(), current_items_.end(),
-             [](const CompletionItem& a, const CompletionItem& b) {
-                 return a.priority > b.priority;
-             });
+    const bool was_pending = pending_providers_ > 0;
+    bool arrived = false;
+    for (auto& [generation, items] : received_)
+    {
+        if (generation != generation_ || pending_providers_ == 0)
+            continue;  // Stale: the request was superseded or closed
+        --pending_providers_;
+        for (auto& item : items)
+        {
+            owned_items_.push_back(std::move(item));
+            const CompletionItem& owned = owned_items_.back();
+            current_items_.push_back(Entry{owned.filter_text.empty() ? owned.label : owned.filter_text,
+                                           owned.priority, -1, static_cast<std::uint32_t>(owned_items_.size() - 1)});
+        }
+        arrived = true;
+    }
+    received_.clear();
 
-    filter_text_.clear();
+    if (arrived)
+        OnItemsChanged();
+
+    if (was_pending && pending_providers_ == 0 && current_items_.empty())
+    {
+        Close();
+    }
+    return arrived;
+}
+
+void TextEditorAutocomplete::OnItemsChanged()
+{
+    // Keep the selected item selected while later providers add theirs
+    std::string selected_label;
+    if (is_active_ && selected_index_ >= 0 && selected_index_ < static_cast<int>(displayed_items_.size()))
+        selected_label = GetFilteredItem(selected_index_).label;
+
+    std::stable_sort(current_items_.begin(), current_items_.end(),
+                     [](const Entry& a, const Entry& b) {
+                         return a.priority > b.priority;
+                     });
     FilterCompletions(filter_text_);
-    selected_index_ = 0;
+    for (int i = 0; i < static_cast<int>(displayed_items_.size()) && !selected_label.empty(); ++i)
+    {
+        if (GetFilteredItem(i).label == selected_label)
+        {
+            selected_index_ = i;
+            break;
+        }
+    }
     is_active_ = !filtered_items_.empty();
 }
 
+void TextEditorAutocomplete::CancelRequest()
+{
+    if (request_token_.cancelled_)
+    {
+        request_token_.cancelled_->store(true, std::memory_order_relaxed);
+        request_token_.cancelled_.reset();
+    }
+    ++generation_;
+    pending_providers_ = 0;
+}
+
 bool TextEditorAutocomplete::Render(TextEditor& editor)
 {
+    PollCompletions();
     if (!is_active_ || filtered_items_.empty())
         return false;
 
@@ -75,33 +156,47 @@ bool TextEditorAutocomplete::Render(TextEditor& editor)
         ImGuiWindowFlags_AlwaysAutoResize;
 
     if (auto window = imgui::scoped::Window("##autocomplete", nullptr, window_flags)) {
-        // Render list of items
+        // Render only the visible rows, so max_items can run into the thousands
+        const int item_count = static_cast<int>(filtered_items_.size());
+        const float row_height = ImGui::GetTextLineHeightWithSpacing();
         ImVec2 const list_size(0.0f, std::min(config_.popup_max_height,
-                         static_cast<float>(filtered_items_.size()) * ImGui::GetTextLineHeightWithSpacing()));
+                         static_cast<float>(item_count) * row_height));
         if (auto items_child = imgui::scoped::Child("##items", list_size, ImGuiChildFlags_None, 0)) {
-            for (int i = 0; i < static_cast<int>(filtered_items_.size()) && i < config_.max_items; ++i)
+            ImGuiListClipper clipper;
+            clipper.Begin(item_count, row_height);
+            while (clipper.Step())
             {
-                bool is_selected = (i == selected_index_);
-                RenderCompletionItem(filtered_items_[i], is_selected);
-                if (ImGui::IsItemClicked(ImGuiMouseButton_Left)) {
-                    selected_index_ = i;
-                    item_selected = true;
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+                {
+                    ImGui::PushID(i);
+                    if (RenderCompletionItem(GetFilteredItem(i), i == selected_index_)) {
+                        selected_index_ = i;
+                        scrolled_index_ = i;
+                        item_selected = true;
+                    }
+                    ImGui::PopID();
                 }
             }
-        }
+            clipper.End();
 
-        // Auto-scroll to selected item
-        if (selected_index_ >= 0 && selected_index_ < static_cast<int>(filtered_items_.size()))
-        {
-            float item_pos_y = selected_index_ * ImGui::GetTextLineHeightWithSpacing();
-            ImGui::SetScrollFromPosY(item_pos_y - ImGui::GetScrollY());
+            // Bring the selection into view when it moves, leaving the wheel alone otherwise
+            if (selected_index_ != scrolled_index_ && selected_index_ >= 0 && selected_index_ < item_count)
+            {
+                const float item_top = static_cast<float>(selected_index_) * row_height;
+                const float view_height = ImGui::GetWindowHeight();
+                if (item_top < ImGui::GetScrollY())
+                    ImGui::SetScrollY(item_top);
+                else if (item_top + row_height > ImGui::GetScrollY() + view_height)
+                    ImGui::SetScrollY(item_top + row_height - view_height);
+                scrolled_index_ = selected_index_;
+            }
         }
 
         // Documentation panel
         if (config_.show_documentation && selected_index_ >= 0 &&
             selected_index_ < static_cast<int>(filtered_items_.size()))
         {
-            const auto& item = filtered_items_[selected_index_];
+            const auto& item = GetFilteredItem(selected_index_);
             if (!item.documentation.empty())
             {
                 ImGui::Separator();
@@ -161,9 +256,13 @@ bool TextEditorAutocomplete::HandleKeyboard()
 
 void TextEditorAutocomplete::Close()
 {
+    CancelRequest();
     is_active_ = false;
+    owned_items_.clear();
     current_items_.clear();
+    matched_items_.clear();
     filtered_items_.clear();
+    displayed_items_.clear();
     selected_index_ = 0;
     filter_text_.clear();
 }
@@ -177,7 +276,7 @@ TextEditorAutocomplete::AcceptSelected(TextEditor& editor)
         return std::nullopt;
     }
 
-    auto item = filtered_items_[selected_index_];
+    auto item = GetFilteredItem(selected_index_);
     if (item.replace_start_char >= 0 && item.replace_end_char >= item.replace_start_char && trigger_line_ >= 0) {
         (void)editor.ReplaceRange(
             trigger_line_,
@@ -203,43 +302,89 @@ TextEditorAutocomplete::AcceptSelected(TextEditor& editor)
     return item;
 }
 
-void TextEditorAutocomplete::FilterCompletions(const std::string& filter)
+void TextEditorAutocomplete::SetFilterText(std::string_view filter)
 {
-    filtered_items_.clear();
+    // Whatever matches the longer filter matched the shorter one, in both matching modes
+    const bool extends = filter.size() >= filter_text_.size() &&
+                         filter.substr(0, filter_text_.size()) == filter_text_ &&
+                         matched_fuzzy_ == config_.fuzzy_matching;
+    filter_text_.assign(filter.data(), filter.size());
+    if (extends)
+        NarrowCompletions(filter_text_);
+    else
+        FilterCompletions(filter_text_);
+    is_active_ = !filtered_items_.empty();
+}
 
-    if (filter.empty())
+void TextEditorAutocomplete::FilterCompletions(std::string_view filter)
+{
+    matched_items_.clear();
+    matched_fuzzy_ = config_.fuzzy_matching;
+
+    // Score every item once; sorting only reads the cached scores
+    for (int i = 0; i < static_cast<int>(current_items_.size()); ++i)
     {
-        filtered_items_ = current_items_;
-        return;
+        const int score = filter.empty() ? 0 : GetFuzzyMatchScore(current_items_[static_cast<std::size_t>(i)].text, filter);
+        if (score >= 0)
+        {
+            matched_items_.push_back(ScoredItem{i, score});
+        }
     }
+    last_scored_items_ = static_cast<int>(current_items_.size());
+
+    SelectTopItems();
+}
 
-    for (const auto& item : current_items_)
+void TextEditorAutocomplete::NarrowCompletions(std::string_view filter)
+{
+    last_scored_items_ = static_cast<int>(matched_items_.size());
+    std::size_t kept = 0;
+    for (const ScoredItem& matched : matched_items_)
     {
-        int score = GetFuzzyMatchScore(item, filter);
+        const int score = GetFuzzyMatchScore(current_items_[static_cast<std::size_t>(matched.item)].text, filter);
         if (score >= 0)
         {
-            filtered_items_.push_back(item);
+            matched_items_[kept++] = ScoredItem{matched.item, score};
         }
     }
+    matched_items_.resize(kept);
 
-    // Sort by match score
-    std::sort(filtered_items_.begin(), filtered_items_.end(),
-             [this, &filter](const CompletionItem& a, const CompletionItem& b) {
-                 int score_a = GetFuzzyMatchScore(a, filter);
-                 int score_b = GetFuzzyMatchScore(b, filter);
-                 if (score_a != score_b)
-                     return score_a > score_b;
-                 return a.priority > b.priority;
-             });
+    SelectTopItems();
+}
+
+void TextEditorAutocomplete::SelectTopItems()
+{
+    // current_items_ is sorted by priority, so the index breaks ties by priority
+    const auto better = [](const ScoredItem& a, const ScoredItem& b) {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.item < b.item;
+    };
+    const std::size_t shown = config_.max_items > 0
+        ? std::min(matched_items_.size(), static_cast<std::size_t>(config_.max_items))
+        : matched_items_.size();
+    filtered_items_.resize(shown);
+    std::partial_sort_copy(matched_items_.begin(), matched_items_.end(),
+                           filtered_items_.begin(), filtered_items_.end(), better);
+
+    // Only the shown items are built
+    displayed_items_.clear();
+    for (const ScoredItem& shown_item : filtered_items_)
+    {
+        const Entry& entry = current_items_[static_cast<std::size_t>(shown_item.item)];
+        if (entry.provider < 0)
+            displayed_items_.push_back(owned_items_[entry.id]);
+        else
+            displayed_items_.push_back(providers_[static_cast<std::size_t>(entry.provider)]->MaterializeItem(entry.id));
+    }
 
     selected_index_ = 0;
+    scrolled_index_ = -1;
 }
 
-int TextEditorAutocomplete::GetFuzzyMatchScore(const CompletionItem& item,
-                                               const std::string& filter) const
+int TextEditorAutocomplete::GetFuzzyMatchScore(std::string_view text,
+                                               std::string_view filter) const
 {
-    const std::string& text = item.filter_text.empty() ? item.label : item.filter_text;
-
     if (!config_.fuzzy_matching)
     {
         // Simple prefix match
@@ -248,35 +393,78 @@ int TextEditorAutocomplete::GetFuzzyMatchScore(const CompletionItem& item,
         return -1;
     }
 
-    // Fuzzy matching: score based on how well filter matches text
-    int score = 0;
-    size_t filter_idx = 0;
-    size_t text_idx = 0;
-    bool consecutive = true;
+    return ScoreFuzzyMatch(text, filter);
+}
 
-    while (filter_idx < filter.length() && text_idx < text.length())
+int TextEditorAutocomplete::ScoreFuzzyMatch(std::string_view text, std::string_view filter)
+{
+    if (filter.empty())
+        return 0;
+    if (filter.size() > text.size())
+        return -1;
+
+    const auto lower = [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); };
+    const auto is_word_char = [](char c) { return std::isalnum(static_cast<unsigned char>(c)) != 0; };
+
+    // Earliest end of a match, then the latest start matching up to it: the tightest window
+    std::size_t filter_index = 0;
+    std::size_t end = 0;
+    for (; end < text.size(); ++end)
     {
-        if (std::tolower(filter[filter_idx]) == std::tolower(text[text_idx]))
-        {
-            score += consecutive ? 10 : 5;  // Bonus for consecutive matches
-            filter_idx++;
-            consecutive = true;
-        }
-        else
+        if (lower(text[end]) == lower(filter[filter_index]) && ++filter_index == filter.size())
+            break;
+    }
+    if (filter_index < filter.size())
+        return -1;
+    std::size_t start = end;
+    for (std::size_t remaining = filter.size(); ; --start)
+    {
+        if (lower(text[start]) == lower(filter[remaining - 1]) && --remaining == 0)
+            break;
+    }
+
+    // Score the window left to right like fzf: bonuses at word starts, penalties for gaps
+    constexpr int score_match = 16;
+    constexpr int bonus_boundary = 8;
+    constexpr int bonus_camel = 7;
+    constexpr int bonus_consecutive = 4;
+    constexpr int bonus_first = 12;
+    constexpr int penalty_gap_start = 3;
+    constexpr int penalty_gap_extension = 1;
+
+    int score = start == 0 ? bonus_first : 0;
+    filter_index = 0;
+    bool in_gap = false;
+    bool previous_matched = false;
+    for (std::size_t i = start; i <= end && filter_index < filter.size(); ++i)
+    {
+        const char c = text[i];
+        if (lower(c) != lower(filter[filter_index]))
         {
-            consecutive = false;
+            score -= in_gap ? penalty_gap_extension : penalty_gap_start;
+            in_gap = true;
+            previous_matched = false;
+            continue;
         }
-        text_idx++;
-    }
 
-    // Did we match all filter characters?
-    if (filter_idx < filter.length())
-        return -1;  // Not all characters matched
+        score += score_match;
+        if (c == filter[filter_index])
+            ++score;  // Same case
+        const char previous = i > 0 ? text[i - 1] : '\0';
+        if (i == 0 || (!is_word_char(previous) && is_word_char(c)))
+            score += bonus_boundary;
+        else if (std::islower(static_cast<unsigned char>(previous)) != 0 && std::isupper(static_cast<unsigned char>(c)) != 0)
+            score += bonus_camel;
+        if (previous_matched)
+            score += bonus_consecutive;
+        previous_matched = true;
+        in_gap = false;
+        ++filter_index;
+    }
 
-    // Bonus for shorter matches
+    // Shorter texts win ties
     score += 100 / static_cast<int>(text.length() + 1);
-
-    return score;
+    return std::max(score, 0);
 }
 
 const char* TextEditorAutocomplete::GetIconForKind(CompletionItemKind kind) const
@@ -322,18 +510,15 @@ ImU32 TextEditorAutocomplete::GetColorForKind(CompletionItemKind kind) const
     }
 }
 
-void TextEditorAutocomplete::RenderCompletionItem(const CompletionItem& item, bool is_selected)
+bool TextEditorAutocomplete::RenderCompletionItem(const CompletionItem& item, bool is_selected)
 {
     std::optional<imgui::scoped::StyleColor> selected_bg{};
     if (is_selected) {
         selected_bg.emplace(ImGuiCol_Header, vscode::colors::to_u32(vscode::colors::list_selection_bg));
     }
 
-    if (ImGui::Selectable(("##item" + item.label).c_str(), is_selected,
-                         ImGuiSelectableFlags_AllowOverlap))
-    {
-        // Handled by caller
-    }
+    // The caller pushes the row index as the ID
+    const bool clicked = ImGui::Selectable("##item", is_selected, ImGuiSelectableFlags_AllowOverlap);
 
     ImGui::SameLine();
 
@@ -359,33 +544,155 @@ void TextEditorAutocomplete::RenderCompletionItem(const CompletionItem& item, bo
         ImGui::TextDisabled("%s", item.detail.c_str());
     }
 
+    return clicked;
 }
 
 // KeywordCompletionProvider implementation
 
+namespace {
+
+[[nodiscard]] int CompareIgnoringCase(std::string_view a, std::string_view b)
+{
+    const std::size_t length = std::min(a.size(), b.size());
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        const int ca = std::tolower(static_cast<unsigned char>(a[i]));
+        const int cb = std::tolower(static_cast<unsigned char>(b[i]));
+        if (ca != cb)
+            return ca < cb ? -1 : 1;
+    }
+    if (a.size() == b.size())
+        return 0;
+    return a.size() < b.size() ? -1 : 1;
+}
+
+[[nodiscard]] bool IsIdentifierChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '_';
+}
+
+// Identifier ending at the cursor, as text and as a character range of the line
+bool ReadIdentifierBeforeCursor(const TextEditor& editor, int line, int column,
+                                std::string& prefix, int& start_char, int& end_char)
+{
+    prefix.clear();
+    start_char = -1;
+    end_char = -1;
+    if (line < 0 || line >= editor.GetLineCount())
+        return false;
+
+    end_char = std::min(editor.ColumnToCharacterIndex(line, column), editor.GetLineLength(line));
+    start_char = end_char;
+    while (start_char > 0 && IsIdentifierChar(editor.GetGlyphChar(line, start_char - 1)))
+        --start_char;
+    for (int i = start_char; i < end_char; ++i)
+        prefix += editor.GetGlyphChar(line, i);
+    return true;
+}
+
+} // namespace
+
 KeywordCompletionProvider::KeywordCompletionProvider(std::vector<std::string> keywords)
-    : keywords_(std::move(keywords))
 {
+    std::sort(keywords.begin(), keywords.end(), [](const std::string& a, const std::string& b) {
+        const int order = CompareIgnoringCase(a, b);
+        return order != 0 ? order < 0 : a < b;
+    });
+    keywords.erase(std::unique(keywords.begin(), keywords.end()), keywords.end());
+
+    std::size_t pool_size = 0;
+    for (const auto& keyword : keywords)
+        pool_size += keyword.size();
+    pool_.reserve(pool_size);
+    word_starts_.reserve(keywords.size() + 1);
+    for (const auto& keyword : keywords)
+    {
+        word_starts_.push_back(static_cast<std::uint32_t>(pool_.size()));
+        pool_ += keyword;
+    }
+    word_starts_.push_back(static_cast<std::uint32_t>(pool_.size()));
 }
 
-std::vector<TextEditorAutocomplete::CompletionItem>
-KeywordCompletionProvider::GetCompletions([[maybe_unused]] const TextEditor& editor,
-                                         [[maybe_unused]] int line,
-                                         [[maybe_unused]] int column,
-                                         [[maybe_unused]] char trigger_char)
+std::pair<int, int> KeywordCompletionProvider::FindPrefixRange(std::string_view prefix) const
 {
-    std::vector<TextEditorAutocomplete::CompletionItem> items;
+    // Words are sorted ignoring case, so those sharing a prefix are adjacent
+    int first = 0;
+    int count = GetWordCount();
+    while (count > 0)
+    {
+        const int step = count / 2;
+        if (CompareIgnoringCase(GetWord(first + step).substr(0, prefix.size()), prefix) < 0)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+    int last = first;
+    count = GetWordCount() - first;
+    while (count > 0)
+    {
+        const int step = count / 2;
+        if (CompareIgnoringCase(GetWord(last + step).substr(0, prefix.size()), prefix) == 0)
+        {
+            last += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+    return {first, last};
+}
 
-    for (const auto& keyword : keywords_)
+bool KeywordCompletionProvider::GetCandidates(const TextEditor& editor,
+                                              int line,
+                                              int column,
+                                              [[maybe_unused]] char trigger_char,
+                                              std::vector<TextEditorAutocomplete::CompletionCandidate>& out)
+{
+    // The identifier before the cursor picks the words and is replaced on accept
+    std::string prefix;
+    (void)ReadIdentifierBeforeCursor(editor, line, column, prefix, replace_start_char_, replace_end_char_);
+
+    const auto [first, last] = FindPrefixRange(prefix);
+    out.reserve(out.size() + static_cast<std::size_t>(last - first));
+    for (int i = first; i < last; ++i)
     {
-        TextEditorAutocomplete::CompletionItem item;
-        item.label = keyword;
-        item.insert_text = keyword;
-        item.kind = TextEditorAutocomplete::CompletionItemKind::Keyword;
-        item.priority = 50;
-        items.push_back(std::move(item));
+        out.push_back(TextEditorAutocomplete::CompletionCandidate{GetWord(i), static_cast<std::uint32_t>(i), 50});
     }
+    return true;
+}
+
+TextEditorAutocomplete::CompletionItem KeywordCompletionProvider::MaterializeItem(std::uint32_t id) const
+{
+    TextEditorAutocomplete::CompletionItem item(std::string(GetWord(static_cast<int>(id))));
+    item.kind = TextEditorAutocomplete::CompletionItemKind::Keyword;
+    item.priority = 50;
+    item.replace_start_char = replace_start_char_;
+    item.replace_end_char = replace_end_char_;
+    return item;
+}
 
+std::vector<TextEditorAutocomplete::CompletionItem>
+KeywordCompletionProvider::GetCompletions(const TextEditor& editor,
+                                         int line,
+                                         int column,
+                                         char trigger_char)
+{
+    std::vector<TextEditorAutocomplete::CompletionCandidate> candidates;
+    (void)GetCandidates(editor, line, column, trigger_char, candidates);
+
+    std::vector<TextEditorAutocomplete::CompletionItem> items;
+    items.reserve(candidates.size());
+    for (const auto& candidate : candidates)
+    {
+        items.push_back(MaterializeItem(candidate.id));
+    }
     return items;
 }
 
@@ -393,3 +700,324 @@ std::vector<char> KeywordCompletionProvider::GetTriggerCharacters() const
 {
     return {};  // Keywords don't need special trigger characters
 }
+
+// DocumentWordIndex implementation
+
+bool DocumentWordIndex::WordLess::operator()(std::string_view a, std::string_view b) const
+{
+    const int order = CompareIgnoringCase(a, b);
+    return order != 0 ? order < 0 : a < b;
+}
+
+bool DocumentWordIndex::RankLess::operator()(const Ranked& a, const Ranked& b) const
+{
+    return a.count != b.count ? a.count > b.count : WordLess()(a.word->first, b.word->first);
+}
+
+static std::string BucketKey(std::string_view word)
+{
+    std::string key(word.substr(0, DocumentWordIndex::kBucketLength));
+    for (char& c : key)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return key;
+}
+
+void DocumentWordIndex::Update(const TextEditor& editor)
+{
+    last_read_lines_ = 0;
+    auto document = std::find_if(documents_.begin(), documents_.end(),
+                                 [&editor](const Document& d) { return d.editor == &editor; });
+    const std::uint64_t version = editor.GetDocumentVersion();
+    const int line_count = editor.GetLineCount();
+    if (document != documents_.end() && document->version == version &&
+        static_cast<int>(document->line_words.size()) == line_count)
+    {
+        return;
+    }
+
+    bool incremental = document != documents_.end();
+    if (!incremental)
+    {
+        documents_.push_back(Document{&editor, 0, {}});
+        document = documents_.end() - 1;
+    }
+    changes_.clear();
+    incremental = incremental && editor.GetLineChangesSince(document->version, changes_);
+    document->version = version;
+    auto& lines = document->line_words;
+
+    // Removed lines give their words back, inserted ones start empty; both ends are reread
+    int dirty_begin = -1;
+    int dirty_end = -1;
+    for (const auto& change : changes_)
+    {
+        if (!incremental)
+            break;
+        const int first = change.mFirstLine;
+        const int old_end = first + change.mOldCount;
+        const int new_end = first + change.mNewCount;
+        const int delta = change.mNewCount - change.mOldCount;
+        if (first < 0 || old_end > static_cast<int>(lines.size()))
+        {
+            incremental = false;
+            break;
+        }
+
+        const int common = std::min(change.mOldCount, change.mNewCount);
+        if (delta < 0)
+        {
+            for (int line = first + common; line < old_end; ++line)
+                ClearLine(lines[static_cast<std::size_t>(line)]);
+            lines.erase(lines.begin() + first + common, lines.begin() + old_end);
+        }
+        else if (delta > 0)
+        {
+            lines.insert(lines.begin() + first + common, static_cast<std::size_t>(delta), {});
+        }
+
+        const auto map_line = [&](int line, bool is_end) {
+            if (line <= first)
+                return line;
+            if (line >= old_end)
+                return line + delta;
+            return is_end ? new_end : first;
+        };
+        dirty_begin = dirty_begin < 0 ? first : std::min(map_line(dirty_begin, false), first);
+        dirty_end = dirty_end < 0 ? new_end : std::max(map_line(dirty_end, true), new_end);
+    }
+
+    if (!incremental || static_cast<int>(lines.size()) != line_count)
+    {
+        for (auto& line_words : lines)
+            ClearLine(line_words);
+        lines.clear();
+        lines.resize(static_cast<std::size_t>(line_count));
+        dirty_begin = 0;
+        dirty_end = line_count;
+    }
+
+    for (int line = std::max(dirty_begin, 0); line < std::min(dirty_end, line_count); ++line)
+        ReadLine(editor, line, lines[static_cast<std::size_t>(line)]);
+    RankPendingWords();
+}
+
+void DocumentWordIndex::RemoveEditor(const TextEditor& editor)
+{
+    const auto document = std::find_if(documents_.begin(), documents_.end(),
+                                       [&editor](const Document& d) { return d.editor == &editor; });
+    if (document == documents_.end())
+        return;
+    for (auto& line_words : document->line_words)
+        ClearLine(line_words);
+    documents_.erase(document);
+    RankPendingWords();
+}
+
+void DocumentWordIndex::FindPrefix(std::string_view prefix, int max_words,
+                                   std::vector<std::pair<std::string_view, int>>& out) const
+{
+    out.clear();
+    last_visited_words_ = 0;
+    if (max_words <= 0)
+        return;
+
+    const std::string key = BucketKey(prefix);
+    if (prefix.size() <= kBucketLength)
+    {
+        // Every word of the buckets starting with the prefix matches: merge their rankings
+        using Cursor = std::pair<Ranking::const_iterator, Ranking::const_iterator>;
+        std::vector<Cursor> cursors;
+        for (auto bucket = buckets_.lower_bound(key); bucket != buckets_.end() && bucket->first.compare(0, key.size(), key) == 0; ++bucket)
+            cursors.emplace_back(bucket->second.begin(), bucket->second.end());
+        const auto worse = [](const Cursor& a, const Cursor& b) { return RankLess()(*b.first, *a.first); };
+        std::make_heap(cursors.begin(), cursors.end(), worse);
+        while (!cursors.empty() && static_cast<int>(out.size()) < max_words)
+        {
+            std::pop_heap(cursors.begin(), cursors.end(), worse);
+            auto& cursor = cursors.back();
+            out.emplace_back(cursor.first->word->first, cursor.first->count);
+            ++last_visited_words_;
+            if (++cursor.first == cursor.second)
+                cursors.pop_back();
+            else
+                std::push_heap(cursors.begin(), cursors.end(), worse);
+        }
+        return;
+    }
+
+    // Walk the bucket most frequent first, done after max_words matches, alongside the words
+    // sorted by spelling, done at the first word past the prefix
+    const auto bucket = buckets_.find(key);
+    if (bucket == buckets_.end())
+        return;
+    const auto matches = [prefix](std::string_view word) {
+        return CompareIgnoringCase(word.substr(0, prefix.size()), prefix) == 0;
+    };
+
+    // The all-uppercase spelling sorts first among those equal ignoring case
+    std::string lowest(prefix);
+    for (char& c : lowest)
+        c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    auto spelled = words_.lower_bound(std::string_view(lowest));
+    std::vector<Ranked> spelled_matches;
+    for (auto ranked = bucket->second.begin(); ranked != bucket->second.end(); ++ranked)
+    {
+        ++last_visited_words_;
+        if (matches(ranked->word->first))
+        {
+            out.emplace_back(ranked->word->first, ranked->count);
+            if (static_cast<int>(out.size()) == max_words)
+                return;
+        }
+
+        if (spelled == words_.end() || !matches(spelled->first))
+        {
+            // Every match was seen in spelling order
+            const auto taken = std::min(spelled_matches.size(), static_cast<std::size_t>(max_words));
+            std::partial_sort(spelled_matches.begin(), spelled_matches.begin() + static_cast<std::ptrdiff_t>(taken),
+                              spelled_matches.end(), RankLess());
+            out.clear();
+            for (std::size_t i = 0; i < taken; ++i)
+                out.emplace_back(spelled_matches[i].word->first, spelled_matches[i].count);
+            return;
+        }
+        ++last_visited_words_;
+        spelled_matches.push_back(Ranked{spelled->second.count, spelled});
+        ++spelled;
+    }
+}
+
+int DocumentWordIndex::GetCount(std::string_view word) const
+{
+    const auto it = words_.find(word);
+    return it == words_.end() ? 0 : it->second.count;
+}
+
+void DocumentWordIndex::AddWord(std::string_view word, std::vector<Words::iterator>& line_words)
+{
+    auto it = words_.find(word);
+    if (it == words_.end())
+        it = words_.emplace(std::string(word), WordEntry()).first;
+    if (it->second.count++ == 0)
+        ++distinct_words_;
+    if (!it->second.pending)
+    {
+        it->second.pending = true;
+        pending_.push_back(it);
+    }
+    line_words.push_back(it);
+}
+
+void DocumentWordIndex::ClearLine(std::vector<Words::iterator>& line_words)
+{
+    // Unused words stay until they are ranked, as pending_ may refer to them
+    for (const auto& it : line_words)
+    {
+        if (--it->second.count == 0)
+            --distinct_words_;
+        if (!it->second.pending)
+        {
+            it->second.pending = true;
+            pending_.push_back(it);
+        }
+    }
+    line_words.clear();
+}
+
+void DocumentWordIndex::RankPendingWords()
+{
+    for (const auto& it : pending_)
+    {
+        WordEntry& entry = it->second;
+        entry.pending = false;
+        if (entry.ranked != entry.count)
+        {
+            const auto bucket = buckets_.try_emplace(BucketKey(it->first)).first;
+            if (entry.ranked > 0 && entry.count > 0)
+            {
+                // Reuse the node to move the word to its new rank
+                auto node = bucket->second.extract(Ranked{entry.ranked, it});
+                node.value().count = entry.count;
+                bucket->second.insert(std::move(node));
+            }
+            else if (entry.count > 0)
+                bucket->second.insert(Ranked{entry.count, it});
+            else
+                bucket->second.erase(Ranked{entry.ranked, it});
+            entry.ranked = entry.count;
+            if (bucket->second.empty())
+                buckets_.erase(bucket);
+        }
+        if (entry.count == 0)
+            words_.erase(it);
+    }
+    pending_.clear();
+}
+
+void DocumentWordIndex::ReadLine(const TextEditor& editor, int line, std::vector<Words::iterator>& line_words)
+{
+    ClearLine(line_words);
+    ++last_read_lines_;
+
+    // Runs of identifier characters; those starting with a digit are numbers
+    std::string word;
+    const int length = editor.GetLineLength(line);
+    for (int i = 0; i < length;)
+    {
+        if (!IsIdentifierChar(editor.GetGlyphChar(line, i)))
+        {
+            ++i;
+            continue;
+        }
+        word.clear();
+        for (; i < length && IsIdentifierChar(editor.GetGlyphChar(line, i)); ++i)
+            word += editor.GetGlyphChar(line, i);
+        if (static_cast<int>(word.size()) >= min_word_length_ && std::isdigit(static_cast<unsigned char>(word[0])) == 0)
+            AddWord(word, line_words);
+    }
+}
+
+// DocumentWordCompletionProvider implementation
+
+bool DocumentWordCompletionProvider::GetCandidates(const TextEditor& editor,
+                                                   int line,
+                                                   int column,
+                                                   [[maybe_unused]] char trigger_char,
+                                                   std::vector<TextEditorAutocomplete::CompletionCandidate>& out)
+{
+    std::string prefix;
+    (void)ReadIdentifierBeforeCursor(editor, line, column, prefix, replace_start_char_, replace_end_char_);
+
+    index_->Update(editor);
+    // One more word in case the identifier being typed is among them
+    index_->FindPrefix(prefix, max_words_ + 1, matches_);
+
+    words_.clear();
+    words_.reserve(matches_.size());
+    for (const auto& [word, count] : matches_)
+    {
+        // The identifier being typed counts itself; offer it only if it occurs elsewhere
+        if (word == prefix && count <= 1)
+            continue;
+        if (static_cast<int>(words_.size()) == max_words_)
+            break;
+        words_.emplace_back(word);
+    }
+
+    // Most frequent first; the autocomplete keeps that order among equal scores
+    for (std::size_t i = 0; i < words_.size(); ++i)
+    {
+        out.push_back(TextEditorAutocomplete::CompletionCandidate{words_[i], static_cast<std::uint32_t>(i), 40});
+    }
+    return true;
+}
+
+TextEditorAutocomplete::CompletionItem DocumentWordCompletionProvider::MaterializeItem(std::uint32_t id) const
+{
+    TextEditorAutocomplete::CompletionItem item(words_[id]);
+    item.kind = TextEditorAutocomplete::CompletionItemKind::Text;
+    item.priority = 40;
+    item.replace_start_char = replace_start_char_;
+    item.replace_end_char = replace_end_char_;
+    return item;
+}
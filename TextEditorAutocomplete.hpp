@@ -5,12 +5,19 @@
 #include "utilities/imgui_scoped.hpp"
 #include "vscode/colors.hpp"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -74,10 +81,45 @@ public:
             : label(std::move(lbl)), insert_text(label), filter_text(label) {}
     };
 
+    /**
+     * @brief Completion named by a provider without building its CompletionItem yet
+     *
+     * Indexed providers hand these out for large vocabularies; only the items the popup
+     * shows are built, through ICompletionProvider::MaterializeItem.
+     */
+    struct CompletionCandidate
+    {
+        std::string_view text;  // Filter text; must stay valid until the next request
+        std::uint32_t id = 0;   // The provider's handle for MaterializeItem
+        int priority = 0;       // For sorting (higher = better)
+    };
+
+    /**
+     * @brief Cancellation flag shared by a completion request and its providers
+     *
+     * Set once the request is superseded by a new trigger or the popup closes; providers
+     * working in the background should check it and stop early.
+     */
+    class CancellationToken
+    {
+    public:
+        [[nodiscard]] bool IsCancelled() const { return cancelled_ && cancelled_->load(std::memory_order_relaxed); }
+
+    private:
+        friend class TextEditorAutocomplete;
+        std::shared_ptr<std::atomic<bool>> cancelled_;
+    };
+
+    /**
+     * @brief Receives the items of one provider for one request; callable from any thread
+     */
+    using CompletionCallback = std::function<void(std::vector<CompletionItem> items)>;
+
     /**
      * @brief Interface for completion providers
      *
-     * Implement this to provide custom completions (keywords, APIs, etc.)
+     * Implement this to provide custom completions (keywords, APIs, etc.). Quick providers
+     * override GetCompletions; slow ones override GetCompletionsAsync instead.
      */
     class ICompletionProvider
     {
@@ -93,10 +135,56 @@ public:
          * @return List of completion items
          */
         [[nodiscard]] virtual std::vector<CompletionItem> GetCompletions(
+            [[maybe_unused]] const TextEditor& editor,
+            [[maybe_unused]] int line,
+            [[maybe_unused]] int column,
+            [[maybe_unused]] char trigger_char)
+        {
+            return {};
+        }
+
+        /**
+         * @brief Start getting completions for a given position, delivering them later
+         *
+         * The editor is only valid during this call, so copy what a background task needs.
+         * Call done exactly once, from any thread; results of a superseded request are
+         * dropped. The default implementation calls GetCompletions and delivers at once.
+         * @param token Cancelled when the request is superseded
+         * @param done Receives the items
+         */
+        virtual void GetCompletionsAsync(
             const TextEditor& editor,
             int line,
             int column,
-            char trigger_char) = 0;
+            char trigger_char,
+            [[maybe_unused]] const CancellationToken& token,
+            const CompletionCallback& done)
+        {
+            done(GetCompletions(editor, line, column, trigger_char));
+        }
+
+        /**
+         * @brief Name the completions as candidates instead of items, synchronously
+         * @param out Receives the candidates
+         * @return false if the provider doesn't index its items; GetCompletionsAsync is used then
+         */
+        virtual bool GetCandidates(
+            [[maybe_unused]] const TextEditor& editor,
+            [[maybe_unused]] int line,
+            [[maybe_unused]] int column,
+            [[maybe_unused]] char trigger_char,
+            [[maybe_unused]] std::vector<CompletionCandidate>& out)
+        {
+            return false;
+        }
+
+        /**
+         * @brief Build the item of a candidate from the last GetCandidates call
+         */
+        [[nodiscard]] virtual CompletionItem MaterializeItem([[maybe_unused]] std::uint32_t id) const
+        {
+            return {};
+        }
 
         /**
          * @brief Get trigger characters for this provider
@@ -123,7 +211,7 @@ public:
 
     TextEditorAutocomplete() : config_() {}
     explicit TextEditorAutocomplete(Config config) : config_(std::move(config)) {}
-    ~TextEditorAutocomplete() = default;
+    ~TextEditorAutocomplete();
 
     // Non-copyable
     TextEditorAutocomplete(const TextEditorAutocomplete&) = delete;
@@ -145,11 +233,57 @@ public:
 
     /**
      * @brief Trigger autocomplete at current cursor position
+     *
+     * Asks every provider; the popup shows the items delivered so far and grows as the
+     * remaining providers finish. A pending earlier request is cancelled.
      * @param editor The text editor
      * @param trigger_char Character that triggered (or '\0' for manual)
      */
     void Trigger(const TextEditor& editor, char trigger_char = '\0');
 
+    /**
+     * @brief Merge the items providers delivered since the last call; Render calls it
+     * @return true if items of the current request arrived
+     */
+    bool PollCompletions();
+
+    /**
+     * @brief Check if providers of the current request have yet to deliver
+     */
+    [[nodiscard]] bool IsPending() const { return pending_providers_ > 0; }
+
+    /**
+     * @brief Narrow the items to those matching filter, best match first
+     *
+     * A filter extending the previous one only rescores the items that matched before;
+     * any other filter, such as after a backspace, rescores all items.
+     */
+    void SetFilterText(std::string_view filter);
+    [[nodiscard]] const std::string& GetFilterText() const { return filter_text_; }
+
+    /**
+     * @brief Items shown by the popup, best first, at most max_items
+     */
+    [[nodiscard]] int GetFilteredItemCount() const { return static_cast<int>(filtered_items_.size()); }
+    [[nodiscard]] const CompletionItem& GetFilteredItem(int index) const
+    {
+        return displayed_items_[static_cast<std::size_t>(index)];
+    }
+
+    /**
+     * @brief Score how well filter matches text as a case-insensitive subsequence
+     *
+     * Matches at word starts and camelCase humps, consecutive matches and a match at the
+     * start of text score higher; gaps cost. Does not allocate.
+     * @return Score (higher is better), or -1 if no match
+     */
+    [[nodiscard]] static int ScoreFuzzyMatch(std::string_view text, std::string_view filter);
+
+    /**
+     * @brief Number of items scored by the last filtering
+     */
+    [[nodiscard]] int GetLastScoredItemCount() const { return last_scored_items_; }
+
     /**
      * @brief Render the autocomplete popup
      * @param editor The text editor
@@ -191,25 +325,80 @@ private:
     Config config_;
     std::vector<std::unique_ptr<ICompletionProvider>> providers_;
 
+    // Match of current_items_[item], scored once per filter
+    struct ScoredItem
+    {
+        int item = 0;
+        int score = 0;
+    };
+
+    // Item of the current request, kept by owned_items_ or named by a provider's candidate
+    struct Entry
+    {
+        std::string_view text;  // Filter text
+        int priority = 0;
+        int provider = -1;      // Index into providers_, -1 for owned items
+        std::uint32_t id = 0;   // Index into owned_items_, or the candidate id
+    };
+
     bool is_active_ = false;
-    std::vector<CompletionItem> current_items_;
-    std::vector<CompletionItem> filtered_items_;
+    std::deque<CompletionItem> owned_items_;  // Delivered items; a deque keeps the text views valid
+    std::vector<Entry> current_items_;        // Sorted by priority
+    std::vector<CompletionCandidate> candidates_;
+    std::vector<CompletionItem> displayed_items_;  // Items of filtered_items_, built for the popup
+    std::vector<ScoredItem> matched_items_;   // Every item matching filter_text_, by index
+    std::vector<ScoredItem> filtered_items_;  // The best max_items of matched_items_, best first
+    bool matched_fuzzy_ = true;               // Matching mode of matched_items_
+    int last_scored_items_ = 0;
     int selected_index_ = 0;
+    int scrolled_index_ = -1;  // Selection the popup last scrolled into view, -1 after the list changed
     std::string filter_text_;
 
     int trigger_line_ = -1;
     int trigger_column_ = -1;
 
+    // Items delivered by providers, possibly from other threads, tagged with their request
+    struct Inbox
+    {
+        std::mutex mutex;
+        std::vector<std::pair<std::uint64_t, std::vector<CompletionItem>>> deliveries;
+    };
+    std::shared_ptr<Inbox> inbox_ = std::make_shared<Inbox>();
+    std::vector<std::pair<std::uint64_t, std::vector<CompletionItem>>> received_;
+    std::uint64_t generation_ = 0;  // Request the popup shows; bumped by Trigger and Close
+    CancellationToken request_token_;
+    int pending_providers_ = 0;
+
+    /**
+     * @brief Cancel the current request and drop its late deliveries
+     */
+    void CancelRequest();
+
+    /**
+     * @brief Filter completion items based on current input, keeping the best max_items
+     */
+    void FilterCompletions(std::string_view filter);
+
     /**
-     * @brief Filter completion items based on current input
+     * @brief Rescore only the items matching the previous filter, which filter extends
      */
-    void FilterCompletions(const std::string& filter);
+    void NarrowCompletions(std::string_view filter);
 
     /**
-     * @brief Get fuzzy match score for a completion item
+     * @brief Pick the best max_items of the matched items for the popup
+     */
+    void SelectTopItems();
+
+    /**
+     * @brief Sort the entries after new ones arrived and filter them again
+     */
+    void OnItemsChanged();
+
+    /**
+     * @brief Get match score for an item's filter text under the configured matching
      * @return Score (higher is better), or -1 if no match
      */
-    [[nodiscard]] int GetFuzzyMatchScore(const CompletionItem& item, const std::string& filter) const;
+    [[nodiscard]] int GetFuzzyMatchScore(std::string_view text, std::string_view filter) const;
 
     /**
      * @brief Get icon for completion item kind
@@ -223,12 +412,16 @@ private:
 
     /**
      * @brief Render a single completion item
+     * @return true if the item was clicked
      */
-    void RenderCompletionItem(const CompletionItem& item, bool is_selected);
+    bool RenderCompletionItem(const CompletionItem& item, bool is_selected);
 };
 
 /**
- * @brief Simple keyword-based completion provider
+ * @brief Keyword-based completion provider for large static vocabularies
+ *
+ * Stores its words once, sorted case-insensitively in a single string pool, and names
+ * the words starting with the identifier before the cursor as candidates.
  */
 class KeywordCompletionProvider : public TextEditorAutocomplete::ICompletionProvider
 {
@@ -241,8 +434,180 @@ public:
         int column,
         char trigger_char) override;
 
+    bool GetCandidates(
+        const TextEditor& editor,
+        int line,
+        int column,
+        char trigger_char,
+        std::vector<TextEditorAutocomplete::CompletionCandidate>& out) override;
+
+    [[nodiscard]] TextEditorAutocomplete::CompletionItem MaterializeItem(std::uint32_t id) const override;
+
     [[nodiscard]] std::vector<char> GetTriggerCharacters() const override;
 
+    /**
+     * @brief Range [first, last) of the words starting with prefix, ignoring case
+     */
+    [[nodiscard]] std::pair<int, int> FindPrefixRange(std::string_view prefix) const;
+
+    [[nodiscard]] int GetWordCount() const { return static_cast<int>(word_starts_.size()) - 1; }
+    [[nodiscard]] std::string_view GetWord(int index) const
+    {
+        const auto begin = word_starts_[static_cast<std::size_t>(index)];
+        return std::string_view(pool_).substr(begin, word_starts_[static_cast<std::size_t>(index) + 1] - begin);
+    }
+
+private:
+    std::string pool_;                        // All words back to back, in sorted order
+    std::vector<std::uint32_t> word_starts_;  // Offset of each word in pool_, then the pool size
+
+    // Identifier before the cursor at the last request, replaced by accepted items
+    int replace_start_char_ = -1;
+    int replace_end_char_ = -1;
+};
+
+/**
+ * @brief Frequency-counted index of the identifiers in one or more documents
+ *
+ * Follows each editor's line change journal, so an update only reads the lines changed
+ * since the last one. Several editors can share one index. Not thread-safe; call
+ * RemoveEditor before an indexed editor is destroyed.
+ */
+class DocumentWordIndex
+{
+public:
+    explicit DocumentWordIndex(int min_word_length = 3) : min_word_length_(min_word_length) {}
+
+    // Non-copyable: lines refer to the word entries
+    DocumentWordIndex(const DocumentWordIndex&) = delete;
+    DocumentWordIndex& operator=(const DocumentWordIndex&) = delete;
+
+    /**
+     * @brief Bring the words of an editor's document up to date, adding it if new
+     */
+    void Update(const TextEditor& editor);
+
+    /**
+     * @brief Forget the words of an editor's document
+     */
+    void RemoveEditor(const TextEditor& editor);
+
+    /**
+     * @brief Most frequent words starting with prefix, ignoring case
+     *
+     * Walks the words of the prefix's buckets most frequent first, so a short prefix looks
+     * at max_words words however many match. Longer prefixes also walk the words sorted by
+     * spelling and stop at whichever walk finishes first.
+     * @param max_words Maximum number of words to return
+     * @param out Receives the words and their counts, most frequent first
+     */
+    void FindPrefix(std::string_view prefix, int max_words, std::vector<std::pair<std::string_view, int>>& out) const;
+
+    /**
+     * @brief Occurrences of a word in all indexed documents
+     */
+    [[nodiscard]] int GetCount(std::string_view word) const;
+
+    [[nodiscard]] int GetDistinctWordCount() const { return distinct_words_; }
+
+    /**
+     * @brief Number of lines read by the last update
+     */
+    [[nodiscard]] int GetLastReadLineCount() const { return last_read_lines_; }
+
+    /**
+     * @brief Number of words looked at by the last FindPrefix
+     */
+    [[nodiscard]] int GetLastVisitedWordCount() const { return last_visited_words_; }
+
+    // Words are ranked in buckets by their first kBucketLength characters, lowercase
+    static constexpr std::size_t kBucketLength = 2;
+
+private:
+    // Sorted ignoring case, then by case, so words sharing a prefix are adjacent
+    struct WordLess
+    {
+        using is_transparent = void;
+        bool operator()(std::string_view a, std::string_view b) const;
+    };
+    struct WordEntry
+    {
+        int count = 0;
+        int ranked = 0;        // Count the word is ranked by in its bucket, 0 if not ranked
+        bool pending = false;  // Count changed since the buckets were brought up to date
+    };
+    using Words = std::map<std::string, WordEntry, WordLess>;
+
+    // Words of a bucket, most frequent first, then sorted like Words
+    struct Ranked
+    {
+        int count;
+        Words::const_iterator word;
+    };
+    struct RankLess
+    {
+        bool operator()(const Ranked& a, const Ranked& b) const;
+    };
+    using Ranking = std::set<Ranked, RankLess>;
+
+    struct Document
+    {
+        const TextEditor* editor = nullptr;
+        std::uint64_t version = 0;
+        std::vector<std::vector<Words::iterator>> line_words;
+    };
+
+    int min_word_length_;
+    Words words_;
+    std::map<std::string, Ranking> buckets_;  // Never empty
+    std::vector<Words::iterator> pending_;    // Words whose count changed, ranked at the end of an update
+    int distinct_words_ = 0;
+    std::vector<Document> documents_;
+    std::vector<TextEditor::LineChange> changes_;
+    int last_read_lines_ = 0;
+    mutable int last_visited_words_ = 0;
+
+    void AddWord(std::string_view word, std::vector<Words::iterator>& line_words);
+    void ClearLine(std::vector<Words::iterator>& line_words);
+
+    /**
+     * @brief Move the pending words to their place in their bucket, dropping those no longer used
+     */
+    void RankPendingWords();
+    void ReadLine(const TextEditor& editor, int line, std::vector<Words::iterator>& line_words);
+};
+
+/**
+ * @brief Completion provider offering the words of the documents in a DocumentWordIndex
+ */
+class DocumentWordCompletionProvider : public TextEditorAutocomplete::ICompletionProvider
+{
+public:
+    /**
+     * @param index Word index, possibly shared with the providers of other editors
+     * @param max_words Most frequent matching words offered per request
+     */
+    explicit DocumentWordCompletionProvider(std::shared_ptr<DocumentWordIndex> index, int max_words = 100)
+        : index_(std::move(index)), max_words_(max_words) {}
+
+    bool GetCandidates(
+        const TextEditor& editor,
+        int line,
+        int column,
+        char trigger_char,
+        std::vector<TextEditorAutocomplete::CompletionCandidate>& out) override;
+
+    [[nodiscard]] TextEditorAutocomplete::CompletionItem MaterializeItem(std::uint32_t id) const override;
+
+    [[nodiscard]] std::vector<char> GetTriggerCharacters() const override { return {}; }
+
 private:
-    std::vector<std::string> keywords_;
+    std::shared_ptr<DocumentWordIndex> index_;
+    int max_words_;
+
+    // Words of the last request, copied so that other editors updating the index can't move them
+    std::vector<std::string> words_;
+    std::vector<std::pair<std::string_view, int>> matches_;
+    int replace_start_char_ = -1;
+    int replace_end_char_ = -1;
 };
@@ -1,6 +1,4 @@
 #include "TextEditorBracketMatcher.hpp"
-#include <array>
-#include <memory_resource>
 
 void TextEditorBracketMatcher::AnalyzeDocument(const TextEditor& editor)
 {
@@ -8,36 +6,272 @@ void TextEditorBracketMatcher::AnalyzeDocument(const TextEditor& editor)
         return;
 
     // Skip re-analysis when document hasn't changed
-    const int undo_index = editor.GetUndoIndex();
-    const int line_count = editor.GetLineCount();
-    if (undo_index == last_undo_index_ && line_count == last_line_count_) {
+    const std::uint64_t version = editor.GetTokenClassVersion();
+    if (editor_ == &editor && version == document_version_ && !lines_.empty())
+        return;
+
+    last_tokenized_lines_ = 0;
+    last_paired_lines_ = 0;
+
+    // Nodes popped by earlier passes are never reused, start over once they dominate
+    changes_.clear();
+    const bool incremental = editor_ == &editor && !lines_.empty() &&
+                             nodes_.size() <= 2 * token_count_ + 4096 &&
+                             editor.GetTokenClassChangesSince(document_version_, changes_);
+    editor_ = &editor;
+    document_version_ = version;
+    bracket_pairs_dirty_ = true;
+
+    if (!incremental)
+    {
+        AnalyzeAll(editor);
+        return;
+    }
+
+    int dirty_begin = -1;
+    int dirty_end = -1;
+    for (const auto& change : changes_)
+    {
+        if (!ApplyLineChange(change, dirty_begin, dirty_end))
+        {
+            AnalyzeAll(editor);
+            return;
+        }
+    }
+    if (static_cast<int>(lines_.size()) != editor.GetLineCount() || lines_.empty())
+    {
+        AnalyzeAll(editor);
         return;
     }
-    last_undo_index_ = undo_index;
-    last_line_count_ = line_count;
+
+    TokenizeLines(editor, dirty_begin, dirty_end);
+    PairBrackets(dirty_begin, dirty_end);
+}
+
+std::optional<ImU32> TextEditorBracketMatcher::GetBracketColor(int line, int column) const
+{
+    if (!config_.enabled || !config_.colorize_brackets)
+        return std::nullopt;
+
+    const Token* token = FindToken(line, column);
+    if (token != nullptr && token->partner_line >= 0)
+    {
+        return GetColorForDepth(static_cast<int>(token->depth));
+    }
+
+    return std::nullopt;
+}
+
+std::optional<TextEditorBracketMatcher::BracketPair>
+TextEditorBracketMatcher::FindMatchingBracket(int cursor_line, int cursor_column) const
+{
+    if (!config_.enabled || !config_.highlight_matching)
+        return std::nullopt;
+
+    const Token* token = FindToken(cursor_line, cursor_column);
+    if (token == nullptr || token->partner_line < 0)
+        return std::nullopt;
+
+    if (IsOpenBracket(token->Char()))
+        return MakePair(cursor_line, *token);
+    const int partner_line = LineOf(token->partner_line);
+    return MakePair(partner_line, lines_[partner_line].tokens[token->partner_index]);
+}
+
+const std::vector<TextEditorBracketMatcher::BracketPair>& TextEditorBracketMatcher::GetBracketPairs() const
+{
+    if (!bracket_pairs_dirty_)
+        return bracket_pairs_;
+    bracket_pairs_dirty_ = false;
 
     bracket_pairs_.clear();
-    bracket_cache_.clear();
+    for (int line = 0; line < static_cast<int>(lines_.size()); ++line)
+    {
+        for (const auto& token : lines_[line].tokens)
+        {
+            if (token.partner_line < 0 || IsOpenBracket(token.Char()))
+                continue;
+            const int partner_line = LineOf(token.partner_line);
+            bracket_pairs_.push_back(MakePair(partner_line, lines_[partner_line].tokens[token.partner_index]));
+        }
+    }
+    return bracket_pairs_;
+}
 
-    if (line_count <= 0) {
+void TextEditorBracketMatcher::GetBracketPairsInLines(int first_line, int last_line,
+                                                      std::vector<BracketPair>& out) const
+{
+    out.clear();
+    first_line = std::max(first_line, 0);
+    last_line = std::min(last_line, static_cast<int>(lines_.size()) - 1);
+    if (first_line > last_line)
         return;
+
+    // Pairs opened above the range are exactly the ones still open at its first line
+    for (int node = lines_[first_line].stack; node >= 0; node = nodes_[node].parent)
+    {
+        const int open_line = LineOf(nodes_[node].line);
+        const Token& open = lines_[open_line].tokens[nodes_[node].index];
+        if (open.partner_line >= 0)
+            out.push_back(MakePair(open_line, open));
+    }
+
+    for (int line = first_line; line <= last_line; ++line)
+    {
+        for (const auto& token : lines_[line].tokens)
+        {
+            if (token.partner_line >= 0 && IsOpenBracket(token.Char()))
+                out.push_back(MakePair(line, token));
+        }
     }
+}
 
-    bracket_pairs_.reserve(static_cast<std::size_t>(line_count));
-    bracket_cache_.reserve(static_cast<std::size_t>(line_count) * 2U);
+TextEditorBracketMatcher::BracketPair TextEditorBracketMatcher::MakePair(int open_line, const Token& open) const
+{
+    const int close_line = LineOf(open.partner_line);
+    const Token& close = lines_[close_line].tokens[open.partner_index];
+    BracketPair pair;
+    pair.open_line = open_line;
+    pair.open_column = open.column;
+    pair.open_indent_column = lines_[open_line].indent_column;
+    pair.close_line = close_line;
+    pair.close_column = close.column;
+    pair.depth = static_cast<int>(open.depth);
+    pair.open_char = open.Char();
+    pair.close_char = close.Char();
+    return pair;
+}
 
-    std::array<std::byte, 4096> scratch_storage{};
-    std::pmr::monotonic_buffer_resource scratch_resource(scratch_storage.data(), scratch_storage.size());
-    std::pmr::vector<BracketPair> stack{&scratch_resource};
-    stack.reserve(static_cast<std::size_t>(std::max(8, line_count / 8)));
+void TextEditorBracketMatcher::AnalyzeAll(const TextEditor& editor)
+{
+    const int line_count = editor.GetLineCount();
+    lines_.clear();
+    lines_.resize(static_cast<std::size_t>(std::max(line_count, 0)));
+    nodes_.clear();
+    end_stack_ = -1;
+    token_count_ = 0;
+    gap_line_ = line_count;
+    gap_size_ = kGapLines;
+
+    if (line_count <= 0)
+        return;
+
+    TokenizeLines(editor, 0, line_count);
+    nodes_.reserve(token_count_ / 2 + 1);
+    PairBrackets(0, line_count);
+}
 
+bool TextEditorBracketMatcher::ApplyLineChange(const TextEditor::LineChange& change, int& dirty_begin,
+                                               int& dirty_end)
+{
+    const int first = change.mFirstLine;
+    const int old_end = first + change.mOldCount;
+    const int new_end = first + change.mNewCount;
+    const int delta = change.mNewCount - change.mOldCount;
+    if (first < 0 || old_end > static_cast<int>(lines_.size()))
+        return false;
+
+    // Lines from old_end on keep their stored numbers as the gap before them takes up the change;
+    // start over with a fresh gap once it would run out or grow too large
+    if (gap_size_ - delta < 0 || gap_size_ - delta > 2 * kGapLines)
+    {
+        MoveGap(static_cast<int>(lines_.size()));
+        gap_size_ = kGapLines;
+    }
+    MoveGap(old_end);
+
+    // The first new line starts with the stack the first old line started with. Lines kept in
+    // place hold on to their tokens, which TokenizeLines compares with what it reads again.
+    const int start_stack = first < static_cast<int>(lines_.size()) ? lines_[first].stack : end_stack_;
+    const int common = std::min(change.mOldCount, change.mNewCount);
+    if (delta < 0)
+    {
+        for (int line = first + common; line < old_end; ++line)
+            token_count_ -= lines_[line].tokens.size();
+        lines_.erase(lines_.begin() + first + common, lines_.begin() + old_end);
+    }
+    else if (delta > 0)
+    {
+        lines_.insert(lines_.begin() + first + common, static_cast<std::size_t>(delta), LineState());
+    }
+    if (first < static_cast<int>(lines_.size()))
+        lines_[first].stack = start_stack;
+    else
+        end_stack_ = start_stack;
+    gap_line_ = new_end;
+    gap_size_ -= delta;
+
+    const auto map_line = [&](int line, bool is_end) {
+        if (line <= first)
+            return line;
+        if (line >= old_end)
+            return line + delta;
+        return is_end ? new_end : first;
+    };
+    if (dirty_begin >= 0)
+    {
+        dirty_begin = std::min(map_line(dirty_begin, false), first);
+        dirty_end = std::max(map_line(dirty_end, true), new_end);
+    }
+    else
+    {
+        dirty_begin = first;
+        dirty_end = new_end;
+    }
+    return true;
+}
+
+void TextEditorBracketMatcher::MoveGap(int line)
+{
+    line = std::clamp(line, 0, static_cast<int>(lines_.size()));
+    if (line == gap_line_)
+        return;
+
+    // The lines the gap passes change their stored number, in their nodes and in their partners
+    const int begin = std::min(line, gap_line_);
+    const int end = std::min(std::max(line, gap_line_), static_cast<int>(lines_.size()));
+    const int shift = line > gap_line_ ? -gap_size_ : gap_size_;
+    moved_partners_.clear();
+    for (int moved = begin; moved < end; ++moved)
+    {
+        const auto& state = lines_[moved];
+        for (int index = 0; index < static_cast<int>(state.tokens.size()); ++index)
+        {
+            const Token& token = state.tokens[index];
+            if (token.partner_line < 0)
+                continue;
+
+            // Partners left behind by a removed line are paired again before they are read
+            const int partner_line = LineOf(token.partner_line);
+            if (partner_line < 0 || partner_line >= static_cast<int>(lines_.size()) ||
+                token.partner_index >= static_cast<int>(lines_[partner_line].tokens.size()))
+            {
+                continue;
+            }
+            const Token& partner = lines_[partner_line].tokens[token.partner_index];
+            if (partner.partner_index == index && LineOf(partner.partner_line) == moved)
+                moved_partners_.emplace_back(partner_line, token.partner_index);
+        }
+        for (int node = state.first_node; node < state.first_node + state.node_count; ++node)
+            nodes_[node].line += shift;
+    }
+    for (const auto& [partner_line, index] : moved_partners_)
+        lines_[partner_line].tokens[index].partner_line += shift;
+    gap_line_ = line;
+}
+
+void TextEditorBracketMatcher::TokenizeLines(const TextEditor& editor, int begin, int end)
+{
     const int tab_size = editor.GetTabSize();
-    std::string line_text;
-    for (int line = 0; line < line_count; ++line) {
-        editor.GetLineText(line, line_text);
+    last_tokenized_lines_ += std::max(0, end - begin);
+    for (int line = begin; line < end; ++line)
+    {
+        auto& state = lines_[line];
+        const int length = editor.GetLineLength(line);
 
         int indent_column = 0;
-        for (char ch : line_text) {
+        for (int col = 0; col < length; ++col) {
+            const char ch = editor.GetGlyphChar(line, col);
             if (ch == ' ' || ch == '\t') {
                 if (ch == '\t') {
                     const int advance = tab_size - (indent_column % tab_size);
@@ -49,83 +283,155 @@ void TextEditorBracketMatcher::AnalyzeDocument(const TextEditor& editor)
                 break;
             }
         }
-        for (int col = 0; col < static_cast<int>(line_text.length()); ++col)
-        {
-            char ch = line_text[col];
+        state.indent_column = indent_column;
 
-            if (IsOpenBracket(ch))
+        scanned_tokens_.clear();
+        for (int col = 0; col < length; ++col)
+        {
+            const char ch = editor.GetGlyphChar(line, col);
+            if (!IsOpenBracket(ch) && !IsCloseBracket(ch))
+                continue;
+
+            // Brackets in strings and comments don't nest
+            const auto token_class = editor.GetGlyphTokenClass(line, col);
+            if (token_class == TextEditor::TokenClass::Comment || token_class == TextEditor::TokenClass::String)
+                continue;
+
+            // A bracket read again keeps its pair until PairBrackets decides otherwise
+            Token token;
+            token.column = col;
+            token.ch = static_cast<unsigned char>(ch);
+            const std::size_t index = scanned_tokens_.size();
+            if (index < state.tokens.size() && state.tokens[index].ch == token.ch)
             {
-                // Push opening bracket
-                BracketPair pair;
-                pair.open_line = line;
-                pair.open_column = col;
-                pair.open_indent_column = indent_column;
-                pair.open_char = ch;
-                pair.depth = static_cast<int>(stack.size());
-
-                stack.push_back(pair);
-            }
-            else if (IsCloseBracket(ch))
-            {
-                // Pop and match closing bracket
-                auto open_match = GetMatchingOpenBracket(ch);
-
-                if (!stack.empty() && open_match && stack.back().open_char == *open_match)
-                {
-                    BracketPair pair = stack.back();
-                    stack.pop_back();
-
-                    pair.close_line = line;
-                    pair.close_column = col;
-                    pair.close_char = ch;
-
-                    // Store in cache and vector
-                    bracket_pairs_.push_back(pair);
-
-                    uint64_t open_key = MakeKey(pair.open_line, pair.open_column);
-                    uint64_t close_key = MakeKey(pair.close_line, pair.close_column);
-
-                    bracket_cache_[open_key] = pair;
-                    bracket_cache_[close_key] = pair;
-                }
-                // If stack is empty or brackets don't match, we have a mismatch
-                // Could highlight as error in future
+                token.partner_line = state.tokens[index].partner_line;
+                token.partner_index = state.tokens[index].partner_index;
+                token.depth = state.tokens[index].depth;
             }
+            scanned_tokens_.push_back(token);
         }
+        token_count_ -= state.tokens.size();
+        state.tokens.assign(scanned_tokens_.begin(), scanned_tokens_.end());
+        token_count_ += state.tokens.size();
     }
 }
 
-std::optional<ImU32> TextEditorBracketMatcher::GetBracketColor(int line, int column) const
+void TextEditorBracketMatcher::PairBrackets(int first_line, int dirty_end)
 {
-    if (!config_.enabled || !config_.colorize_brackets)
-        return std::nullopt;
-
-    uint64_t key = MakeKey(line, column);
-    auto it = bracket_cache_.find(key);
+    const int line_count = static_cast<int>(lines_.size());
+    int stack = first_line < line_count ? lines_[first_line].stack : end_stack_;
 
-    if (it != bracket_cache_.end())
+    int line = first_line;
+    for (; line < line_count; ++line)
     {
-        return GetColorForDepth(it->second.depth);
-    }
+        auto& state = lines_[line];
 
-    return std::nullopt;
-}
+        // Below the edit, the same open brackets mean the same pairs as before
+        if (line >= dirty_end && line > first_line && state.stack == stack)
+            break;
+        state.stack = stack;
+        ++last_paired_lines_;
 
-std::optional<TextEditorBracketMatcher::BracketPair>
-TextEditorBracketMatcher::FindMatchingBracket(int cursor_line, int cursor_column) const
-{
-    if (!config_.enabled || !config_.highlight_matching)
-        return std::nullopt;
+        const int stored_line = StoredLine(line);
+        const int nodes_before = static_cast<int>(nodes_.size());
+        for (int index = 0; index < static_cast<int>(state.tokens.size()); ++index)
+        {
+            auto& token = state.tokens[index];
+            if (IsOpenBracket(token.Char()))
+            {
+                // Its partner is set when a closing bracket pops it, or cleared at the end
+                StackNode node;
+                node.parent = stack;
+                node.line = stored_line;
+                node.index = index;
+                node.depth = stack < 0 ? 0 : nodes_[stack].depth + 1;
+                node.ch = token.Char();
+                token.depth = static_cast<std::uint32_t>(std::min(node.depth, kMaxTokenDepth));
+
+                stack = static_cast<int>(nodes_.size());
+                nodes_.push_back(node);
+                continue;
+            }
 
-    uint64_t key = MakeKey(cursor_line, cursor_column);
-    auto it = bracket_cache_.find(key);
+            // Pop and match closing bracket
+            token.partner_line = -1;
+            token.partner_index = -1;
+            const auto open_match = GetMatchingOpenBracket(token.Char());
+            if (stack >= 0 && open_match && nodes_[stack].ch == *open_match)
+            {
+                const StackNode& node = nodes_[stack];
+                Token& open = lines_[LineOf(node.line)].tokens[node.index];
+                open.partner_line = stored_line;
+                open.partner_index = index;
+                token.depth = open.depth;
+                token.partner_line = node.line;
+                token.partner_index = node.index;
+                stack = node.parent;
+            }
+            // If stack is empty or brackets don't match, we have a mismatch
+            // Could highlight as error in future
+        }
+
+        // Brackets left open go back to the nodes the last pairing pushed for them when those
+        // sit on the same stack, which keeps the stack of the next lines, and their pairs
+        int base = stack;
+        while (base >= nodes_before)
+            base = nodes_[base].parent;
+        int reused = base;
+        bool reuse = true;
+        for (int node = stack, upper = -1; node >= nodes_before && reuse; node = nodes_[node].parent)
+        {
+            int match = state.first_node;
+            const int match_end = state.first_node + state.node_count;
+            while (match < match_end && nodes_[match].index != nodes_[node].index)
+                ++match;
+            reuse = match < match_end && nodes_[match].ch == nodes_[node].ch &&
+                    (upper < 0 || nodes_[upper].parent == match);
+            if (upper < 0)
+                reused = match;
+            upper = match;
+            if (reuse && nodes_[node].parent < nodes_before)
+                reuse = nodes_[match].parent == base;
+        }
+        if (reuse)
+        {
+            // Nodes of brackets closed on the line are no longer referenced either
+            nodes_.resize(static_cast<std::size_t>(nodes_before));
+            if (stack < nodes_before)
+                state.node_count = 0;
+            stack = reused;
+        }
+        else
+        {
+            state.first_node = nodes_before;
+            state.node_count = static_cast<int>(nodes_.size()) - nodes_before;
+        }
+    }
 
-    if (it != bracket_cache_.end())
+    // Brackets still open at the end of the document have no pair
+    if (line == line_count)
     {
-        return it->second;
+        end_stack_ = stack;
+        for (int node = stack; node >= 0; node = nodes_[node].parent)
+        {
+            Token& open = lines_[LineOf(nodes_[node].line)].tokens[nodes_[node].index];
+            open.partner_line = -1;
+            open.partner_index = -1;
+        }
     }
+}
 
-    return std::nullopt;
+const TextEditorBracketMatcher::Token* TextEditorBracketMatcher::FindToken(int line, int column) const
+{
+    if (line < 0 || line >= static_cast<int>(lines_.size()))
+        return nullptr;
+
+    const auto& tokens = lines_[line].tokens;
+    const auto it = std::lower_bound(tokens.begin(), tokens.end(), column,
+                                     [](const Token& token, int value) { return token.column < value; });
+    if (it == tokens.end() || it->column != column)
+        return nullptr;
+    return &*it;
 }
 
 void TextEditorBracketMatcher::RenderBracketGuides(ImDrawList* draw_list,
@@ -140,36 +446,32 @@ void TextEditorBracketMatcher::RenderBracketGuides(ImDrawList* draw_list,
     const int last_visible = editor.GetLastVisibleLine();
     (void)text_start_x;
 
+    GetBracketPairsInLines(first_visible, last_visible, visible_pairs_);
+    if (visible_pairs_.empty())
+        return;
+
+    // Top of each visible line, shared by all guides crossing it
+    visible_line_tops_.clear();
+    for (int line = first_visible; line <= last_visible; ++line)
+        visible_line_tops_.push_back(editor.CoordinatesToScreenPos(TextEditor::Coordinates{line, 0}).y);
+
     // Draw vertical lines for bracket pairs that span multiple lines
-    for (const auto& pair : bracket_pairs_)
+    for (const auto& pair : visible_pairs_)
     {
-        // Only draw if the bracket pair spans multiple lines and is visible
         if (pair.close_line <= pair.open_line)
             continue;
 
         if (pair.open_char != '{' || pair.close_char != '}')
             continue;
 
-        if (pair.close_line < first_visible || pair.open_line > last_visible)
-            continue;
-
-        // Calculate Y positions relative to screen coordinates
-        int draw_start_line = std::max(pair.open_line, first_visible);
-        int draw_end_line = std::min(pair.close_line, last_visible);
+        const int draw_start_line = std::max(pair.open_line, first_visible);
+        const int draw_end_line = std::min(pair.close_line, last_visible);
 
-        const ImVec2 open_pos = editor.CoordinatesToScreenPos(
+        const float x = editor.CoordinatesToScreenPos(
             TextEditor::Coordinates{pair.open_line, pair.open_indent_column}
-        );
-        const ImVec2 start_pos = editor.CoordinatesToScreenPos(
-            TextEditor::Coordinates{draw_start_line, 0}
-        );
-        const ImVec2 end_pos = editor.CoordinatesToScreenPos(
-            TextEditor::Coordinates{draw_end_line, 0}
-        );
-
-        const float x = open_pos.x;
-        const float y_start = start_pos.y;
-        const float y_end = end_pos.y + line_height;
+        ).x;
+        const float y_start = visible_line_tops_[draw_start_line - first_visible];
+        const float y_end = visible_line_tops_[draw_end_line - first_visible] + line_height;
 
         // Draw the guide line with rainbow color based on depth
         ImU32 guide_color = GetColorForDepth(pair.depth);
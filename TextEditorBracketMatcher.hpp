@@ -7,8 +7,6 @@
 #include <array>
 #include <cstdint>
 #include <optional>
-#include <stack>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -20,6 +18,18 @@
  * - Matching bracket highlighting when cursor is on a bracket
  * - Bracket pair guides (vertical lines)
  * - Configurable bracket pairs per language
+ *
+ * The analysis is incremental: every line keeps its bracket tokens and the
+ * stack of brackets still open at its start. Edits and recolorized lines reported
+ * by TextEditor::GetTokenClassChangesSince() only re-read the changed lines, and
+ * pairing is redone from there until the open bracket stack is the same as before.
+ * Brackets the colorizer marks as string or comment are skipped.
+ *
+ * Pairs and stack nodes refer to lines by a stored number with a gap in it, as a gap
+ * buffer does: lines below the gap are stored as their line number, lines above it
+ * that plus the gap size. Inserting or removing lines at the gap only resizes it, so
+ * the lines below an edit move for free; moving the gap to the next edit costs the
+ * brackets of the lines it passes.
  */
 class TextEditorBracketMatcher
 {
@@ -79,7 +89,11 @@ public:
     TextEditorBracketMatcher& operator=(TextEditorBracketMatcher&&) noexcept = default;
 
     /**
-     * @brief Analyze the document and find all bracket pairs
+     * @brief Bring the bracket pairs up to date with the document
+     *
+     * Cheap when nothing changed, and proportional to the edited lines plus the
+     * brackets whose pairing they affect otherwise, plus the brackets between the
+     * edit and the previous one.
      * @param editor The text editor to analyze
      */
     void AnalyzeDocument(const TextEditor& editor);
@@ -119,26 +133,132 @@ public:
     void SetEnabled(bool enabled) { config_.enabled = enabled; }
     [[nodiscard]] bool IsEnabled() const { return config_.enabled; }
 
-    [[nodiscard]] const auto& GetBracketPairs() const { return bracket_pairs_; }
+    /**
+     * @brief All matched pairs, ordered by closing bracket position
+     */
+    [[nodiscard]] const std::vector<BracketPair>& GetBracketPairs() const;
+
+    /**
+     * @brief Matched pairs overlapping lines [first_line, last_line], in no particular order
+     *
+     * Costs the nesting depth at first_line plus the brackets in the range,
+     * independent of document size.
+     * @param out Receives the pairs; cleared first
+     */
+    void GetBracketPairsInLines(int first_line, int last_line, std::vector<BracketPair>& out) const;
+
+    /**
+     * @brief Number of lines re-read by the last analysis
+     */
+    [[nodiscard]] int GetLastTokenizedLineCount() const { return last_tokenized_lines_; }
+
+    /**
+     * @brief Number of lines whose brackets were paired again by the last analysis
+     */
+    [[nodiscard]] int GetLastPairedLineCount() const { return last_paired_lines_; }
 
 private:
+    // Kept to 16 bytes: one per bracket in the document, read per glyph while rendering
+    struct Token
+    {
+        int column = 0;
+        int partner_line = -1;         // Stored line of the matching bracket, -1 if unmatched
+        int partner_index = -1;        // Index of the matching bracket in that line's tokens
+        std::uint32_t depth : 24 = 0;  // Nesting depth of the pair, saturated at kMaxTokenDepth
+        std::uint32_t ch : 8 = 0;
+
+        [[nodiscard]] char Char() const { return static_cast<char>(ch); }
+    };
+    static constexpr int kMaxTokenDepth = (1 << 24) - 1;
+
+    // Open bracket on a persistent stack; lines share the nodes below their own
+    struct StackNode
+    {
+        int parent = -1;
+        int line = 0;   // Stored line of the bracket
+        int index = 0;  // Index of the bracket in the line's tokens
+        int depth = 0;
+        char ch = '\0';
+    };
+
+    struct LineState
+    {
+        std::vector<Token> tokens;  // Sorted by column
+        int indent_column = 0;
+        int stack = -1;             // StackNode open at the start of the line, -1 if none
+        int first_node = 0;         // Nodes pushed for the line's open brackets by its last pairing
+        int node_count = 0;
+    };
+
+    // Stored line numbers skip kGapLines numbers at first; the gap shrinks as lines are inserted
+    static constexpr int kGapLines = 1 << 29;
+
     Config config_;
-    std::vector<BracketPair> bracket_pairs_;
+    std::vector<LineState> lines_;
+    std::vector<StackNode> nodes_;
+    int end_stack_ = -1;  // StackNode open after the last line
+    std::size_t token_count_ = 0;
+    int gap_line_ = 0;    // First line stored past the gap
+    int gap_size_ = kGapLines;
+
+    // Scratch buffers reused by TokenizeLines and MoveGap
+    std::vector<Token> scanned_tokens_;
+    std::vector<std::pair<int, int>> moved_partners_;
 
-    // Cache: position -> bracket info
-    std::unordered_map<uint64_t, BracketPair> bracket_cache_;
+    // Built on demand from lines_
+    mutable std::vector<BracketPair> bracket_pairs_;
+    mutable bool bracket_pairs_dirty_ = true;
 
-    // Dirty tracking: skip re-analysis when document hasn't changed
-    int last_undo_index_ = -1;
-    int last_line_count_ = -1;
+    // Scratch buffers reused by RenderBracketGuides
+    std::vector<BracketPair> visible_pairs_;
+    std::vector<float> visible_line_tops_;
+
+    // Change tracking: skip re-analysis when document hasn't changed
+    const TextEditor* editor_ = nullptr;
+    std::uint64_t document_version_ = 0;
+    std::vector<TextEditor::LineChange> changes_;
+    int last_tokenized_lines_ = 0;
+    int last_paired_lines_ = 0;
 
     /**
-     * @brief Convert line/column to a hash key for fast lookup
+     * @brief Re-read every line and pair all brackets
      */
-    [[nodiscard]] static constexpr uint64_t MakeKey(int line, int column)
-    {
-        return (static_cast<uint64_t>(line) << 32) | static_cast<uint64_t>(column);
-    }
+    void AnalyzeAll(const TextEditor& editor);
+
+    /**
+     * @brief Update line states and line numbers for one change
+     * @param dirty_begin, dirty_end Line range to re-read (-1 if none yet), widened to cover the change
+     * @return false if the change doesn't fit the known lines
+     */
+    bool ApplyLineChange(const TextEditor::LineChange& change, int& dirty_begin, int& dirty_end);
+
+    [[nodiscard]] int LineOf(int stored) const { return stored < gap_line_ ? stored : stored - gap_size_; }
+    [[nodiscard]] int StoredLine(int line) const { return line < gap_line_ ? line : line + gap_size_; }
+
+    /**
+     * @brief Move the gap in the stored line numbers to just before line
+     */
+    void MoveGap(int line);
+
+    /**
+     * @brief Re-read the bracket tokens of lines [begin, end)
+     */
+    void TokenizeLines(const TextEditor& editor, int begin, int end);
+
+    /**
+     * @brief Pair brackets from a line on, stopping once a line past dirty_end starts with an unchanged stack
+     *
+     * A line whose brackets left open are the ones its last pairing left open, on the same
+     * stack, keeps its nodes, so the lines after it start with an unchanged stack.
+     */
+    void PairBrackets(int first_line, int dirty_end);
+
+    [[nodiscard]] const Token* FindToken(int line, int column) const;
+
+    /**
+     * @brief Build the pair of a matched opening bracket
+     */
+    [[nodiscard]] BracketPair MakePair(int open_line, const Token& open) const;
 
     /**
      * @brief Check if a character is an opening bracket
@@ -1,118 +1,124 @@
 #include "TextEditorCodeFolding.hpp"
 #include "TextEditor.h"
 #include <algorithm>
-#include <array>
 #include <cctype>
-#include <memory_resource>
+#include <climits>
+#include <iterator>
 
-void TextEditorCodeFolding::AnalyzeDocument(const TextEditor& editor)
+namespace
 {
-    if (!config_.enabled)
-        return;
 
-    // Skip re-analysis when document hasn't changed
-    const int undo_index = editor.GetUndoIndex();
-    const int line_count = editor.GetLineCount();
-    if (undo_index == last_undo_index_ && line_count == last_line_count_) {
-        return;
-    }
-    last_undo_index_ = undo_index;
-    last_line_count_ = line_count;
-
-    // Preserve fold state across re-analysis
-    std::unordered_map<int, bool> prev_fold_state;
-    for (const auto& region : regions_) {
-        if (region.is_folded) {
-            prev_fold_state[region.start_line] = true;
-        }
-    }
+using FoldRegion = TextEditorCodeFolding::FoldRegion;
 
-    regions_.clear();
-    line_to_region_.clear();
+// Indent level last, so a region derived again with another indent isn't taken for the old one
+[[nodiscard]] bool ByPosition(const FoldRegion& a, const FoldRegion& b)
+{
+    if (a.start_line != b.start_line)
+        return a.start_line < b.start_line;
+    return a.end_line != b.end_line ? a.end_line < b.end_line : a.indent_level < b.indent_level;
+}
 
-    if (line_count <= 0) {
-        return;
-    }
+[[nodiscard]] bool ByEnd(const FoldRegion& a, const FoldRegion& b)
+{
+    return a.end_line < b.end_line || (a.end_line == b.end_line && a.start_line < b.start_line);
+}
 
-    std::array<std::byte, 8192> scratch_storage{};
-    std::pmr::monotonic_buffer_resource scratch_resource(scratch_storage.data(), scratch_storage.size());
-
-    std::pmr::vector<int> line_indents{&scratch_resource};
-    std::pmr::vector<unsigned char> line_is_blank{&scratch_resource};
-    line_indents.resize(static_cast<std::size_t>(line_count));
-    line_is_blank.resize(static_cast<std::size_t>(line_count));
-
-    std::string line_text;
-    for (int line = 0; line < line_count; ++line) {
-        editor.GetLineText(line, line_text);
-        line_indents[static_cast<std::size_t>(line)] = GetIndentLevel(line_text);
-        line_is_blank[static_cast<std::size_t>(line)] =
-            static_cast<unsigned char>(
-                line_text.empty() ||
-                std::all_of(
-                    line_text.begin(),
-                    line_text.end(),
-                    [](unsigned char ch) { return std::isspace(ch) != 0; }
-                )
-            );
-    }
+[[nodiscard]] bool StartsBefore(const FoldRegion& region, int line)
+{
+    return region.start_line < line;
+}
 
-    std::vector<FoldRegion> detected_regions;
-    detected_regions.reserve(static_cast<std::size_t>(line_count / 2 + 8));
+[[nodiscard]] bool EndsBefore(const FoldRegion& region, int line)
+{
+    return region.end_line < line;
+}
+
+} // namespace
 
-    if (config_.detection_mode == DetectionMode::Braces ||
-        config_.detection_mode == DetectionMode::Both)
+void TextEditorCodeFolding::AnalyzeDocument(const TextEditor& editor)
+{
+    if (!config_.enabled)
+        return;
+
+    // Skip re-analysis when neither the text nor its token classes changed
+    const std::uint64_t token_version = editor.GetTokenClassVersion();
+    if (editor_ == &editor && token_version == last_token_version_ &&
+        analyzed_mode_ == config_.detection_mode && !lines_.empty())
     {
-        DetectBraceRegions(
-            editor,
-            std::span<const int>{line_indents.data(), line_indents.size()},
-            detected_regions
-        );
+        return;
     }
 
-    if (config_.detection_mode == DetectionMode::Indentation ||
-        config_.detection_mode == DetectionMode::Both)
+    last_tokenized_lines_ = 0;
+    last_scanned_lines_ = 0;
+
+    // Fold state follows the start line of each folded region through the edits
+    const auto merge_all = [this]() {
+        std::vector<int> folded_lines;
+        for (const auto& region : regions_) {
+            if (region.is_folded) {
+                folded_lines.push_back(region.start_line);
+            }
+        }
+        MergeRegions(folded_lines);
+    };
+
+    // Nodes popped by earlier passes are never reused, start over once they dominate
+    std::vector<TextEditor::LineChange> changes;
+    const bool incremental = editor_ == &editor && analyzed_mode_ == config_.detection_mode &&
+                             analyzed_min_lines_ == config_.min_lines_to_fold &&
+                             !lines_.empty() && nodes_.size() <= 2 * std::max(analyzed_nodes_, lines_.size()) + 4096 &&
+                             editor.GetTokenClassChangesSince(last_token_version_, changes);
+    editor_ = &editor;
+    last_token_version_ = token_version;
+    analyzed_mode_ = config_.detection_mode;
+    analyzed_min_lines_ = config_.min_lines_to_fold;
+
+    if (!incremental)
     {
-        DetectIndentationRegions(
-            std::span<const int>{line_indents.data(), line_indents.size()},
-            std::span<const unsigned char>{line_is_blank.data(), line_is_blank.size()},
-            detected_regions
-        );
+        AnalyzeAll(editor);
+        merge_all();
+        return;
     }
 
-    // Filter by minimum lines
-    regions_.reserve(detected_regions.size());
-    for (const auto& region : detected_regions)
+    hidden_spans_stale_ = false;
+    int dirty_begin = -1;
+    int dirty_end = -1;
+    for (const auto& change : changes)
     {
-        if ((region.end_line - region.start_line) >= config_.min_lines_to_fold)
+        if (!ApplyLineChange(change.mFirstLine, change.mOldCount, change.mNewCount, dirty_begin, dirty_end))
         {
-            regions_.push_back(region);
+            AnalyzeAll(editor);
+            merge_all();
+            return;
         }
     }
+    if (static_cast<int>(lines_.size()) != editor.GetLineCount() + 1)
+    {
+        AnalyzeAll(editor);
+        merge_all();
+        return;
+    }
 
-    // Sort by start line
-    std::sort(regions_.begin(), regions_.end(),
-             [](const FoldRegion& a, const FoldRegion& b) {
-                 return a.start_line < b.start_line;
-             });
-
-    // Restore fold state from before re-analysis
-    for (auto& region : regions_) {
-        auto it = prev_fold_state.find(region.start_line);
-        if (it != prev_fold_state.end()) {
-            region.is_folded = it->second;
-        }
+    if (dirty_begin >= 0)
+    {
+        TokenizeLines(editor, dirty_begin, dirty_end);
+        ScanRegions(dirty_begin, dirty_end);
     }
 
-    RebuildCache();
+    // Regions set through SetFoldRegions are replaced as a whole
+    if (!regions_derived_)
+        merge_all();
+    else if (hidden_spans_stale_)
+        RebuildHiddenSpans();
 }
 
 bool TextEditorCodeFolding::ToggleFold(int line)
 {
-    auto it = line_to_region_.find(line);
-    if (it != line_to_region_.end() && it->second < regions_.size())
+    const int index = FindRegionIndex(line);
+    if (index >= 0)
     {
-        regions_[it->second].is_folded = !regions_[it->second].is_folded;
+        regions_[index].is_folded = !regions_[index].is_folded;
+        RebuildHiddenSpans();
         return true;
     }
     return false;
@@ -120,12 +126,13 @@ bool TextEditorCodeFolding::ToggleFold(int line)
 
 bool TextEditorCodeFolding::Fold(int line)
 {
-    auto it = line_to_region_.find(line);
-    if (it != line_to_region_.end() && it->second < regions_.size())
+    const int index = FindRegionIndex(line);
+    if (index >= 0)
     {
-        if (!regions_[it->second].is_folded)
+        if (!regions_[index].is_folded)
         {
-            regions_[it->second].is_folded = true;
+            regions_[index].is_folded = true;
+            RebuildHiddenSpans();
             return true;
         }
     }
@@ -134,12 +141,13 @@ bool TextEditorCodeFolding::Fold(int line)
 
 bool TextEditorCodeFolding::Unfold(int line)
 {
-    auto it = line_to_region_.find(line);
-    if (it != line_to_region_.end() && it->second < regions_.size())
+    const int index = FindRegionIndex(line);
+    if (index >= 0)
     {
-        if (regions_[it->second].is_folded)
+        if (regions_[index].is_folded)
         {
-            regions_[it->second].is_folded = false;
+            regions_[index].is_folded = false;
+            RebuildHiddenSpans();
             return true;
         }
     }
@@ -152,6 +160,7 @@ void TextEditorCodeFolding::FoldAll()
     {
         region.is_folded = true;
     }
+    RebuildHiddenSpans();
 }
 
 void TextEditorCodeFolding::UnfoldAll()
@@ -160,29 +169,24 @@ void TextEditorCodeFolding::UnfoldAll()
     {
         region.is_folded = false;
     }
+    RebuildHiddenSpans();
 }
 
 bool TextEditorCodeFolding::IsLineHidden(int line) const
 {
-    for (const auto& region : regions_)
-    {
-        if (region.is_folded &&
-            line > region.start_line &&
-            line <= region.end_line)
-        {
-            return true;
-        }
-    }
-    return false;
+    // Last span starting at or before the line
+    const auto it = std::upper_bound(hidden_spans_.begin(), hidden_spans_.end(), line,
+                                     [](int value, const HiddenSpan& span) { return value < span.first_line; });
+    return it != hidden_spans_.begin() && line <= std::prev(it)->last_line;
 }
 
 std::optional<TextEditorCodeFolding::FoldRegion>
 TextEditorCodeFolding::GetRegionAtLine(int line) const
 {
-    auto it = line_to_region_.find(line);
-    if (it != line_to_region_.end() && it->second < regions_.size())
+    const int index = FindRegionIndex(line);
+    if (index >= 0)
     {
-        return regions_[it->second];
+        return regions_[index];
     }
     return std::nullopt;
 }
@@ -190,14 +194,7 @@ TextEditorCodeFolding::GetRegionAtLine(int line) const
 std::optional<TextEditorCodeFolding::FoldRegion>
 TextEditorCodeFolding::GetRegionStartingAtLine(int line) const
 {
-    for (const auto& region : regions_)
-    {
-        if (region.start_line == line)
-        {
-            return region;
-        }
-    }
-    return std::nullopt;
+    return GetRegionAtLine(line);
 }
 
 bool TextEditorCodeFolding::RenderFoldIcon(ImDrawList* draw_list, int line,
@@ -277,140 +274,508 @@ float TextEditorCodeFolding::RenderFoldPlaceholder(ImDrawList* draw_list,
     return text_size.x + 4;
 }
 
-int TextEditorCodeFolding::VisualLineToActualLine(int visual_line) const
+void TextEditorCodeFolding::SyncHiddenLines(TextEditor& editor)
 {
-    int actual_line = visual_line;
-    int hidden_lines = 0;
+    if (synced_editor_ == &editor && synced_revision_ == hidden_spans_revision_)
+        return;
 
-    for (const auto& region : regions_)
-    {
-        if (region.is_folded && actual_line >= region.start_line)
+    // Lines in the spans of one list but not of the other
+    const auto subtract = [](const std::vector<HiddenSpan>& from, const std::vector<HiddenSpan>& spans,
+                             std::vector<TextEditor::LineRange>& out) {
+        auto span = spans.begin();
+        for (const auto& range : from)
         {
-            int region_hidden = region.end_line - region.start_line;
-            if (actual_line <= region.start_line)
+            int line = range.first_line;
+            while (span != spans.end() && span->last_line < line)
+                ++span;
+            for (auto it = span; it != spans.end() && it->first_line <= range.last_line; ++it)
             {
-                // Visual line is before this fold
-                break;
+                if (it->first_line > line)
+                    out.emplace_back(line, it->first_line - 1);
+                line = std::max(line, it->last_line + 1);
             }
-            hidden_lines += region_hidden;
-            actual_line = visual_line + hidden_lines;
+            if (line <= range.last_line)
+                out.emplace_back(line, range.last_line);
         }
+    };
+
+    std::vector<TextEditor::LineRange> shown;
+    std::vector<TextEditor::LineRange> hidden;
+    if (synced_editor_ == &editor)
+    {
+        subtract(synced_spans_, hidden_spans_, shown);
+        subtract(hidden_spans_, synced_spans_, hidden);
     }
 
-    return actual_line;
+    // Edits move every span below them, replacing the ranges at once is cheaper then
+    constexpr std::size_t max_patched_spans = 16;
+    if (synced_editor_ != &editor || shown.size() + hidden.size() > max_patched_spans)
+    {
+        std::vector<TextEditor::LineRange> ranges;
+        ranges.reserve(hidden_spans_.size());
+        for (const auto& span : hidden_spans_)
+            ranges.emplace_back(span.first_line, span.last_line);
+        editor.SetHiddenLineRanges(std::move(ranges));
+    }
+    else
+    {
+        for (const auto& range : shown)
+            editor.ShowLineRange(range);
+        for (const auto& range : hidden)
+            editor.HideLineRange(range);
+    }
+
+    synced_editor_ = &editor;
+    synced_spans_ = hidden_spans_;
+    synced_revision_ = hidden_spans_revision_;
+}
+
+int TextEditorCodeFolding::VisualLineToActualLine(int visual_line) const
+{
+    // A span starts right after the visual line first_line - 1 - hidden_before
+    const auto it = std::upper_bound(hidden_spans_.begin(), hidden_spans_.end(), visual_line,
+                                     [](int value, const HiddenSpan& span) {
+                                         return value < span.first_line - span.hidden_before;
+                                     });
+    if (it == hidden_spans_.begin())
+        return visual_line;
+
+    const auto& span = *std::prev(it);
+    return visual_line + span.hidden_before + (span.last_line - span.first_line + 1);
 }
 
 int TextEditorCodeFolding::ActualLineToVisualLine(int actual_line) const
 {
+    const auto it = std::upper_bound(hidden_spans_.begin(), hidden_spans_.end(), actual_line,
+                                     [](int value, const HiddenSpan& span) { return value < span.first_line; });
+    if (it == hidden_spans_.begin())
+        return actual_line;
+
     // Check if line is hidden
-    if (IsLineHidden(actual_line))
+    const auto& span = *std::prev(it);
+    if (actual_line <= span.last_line)
         return -1;
 
-    int visual_line = actual_line;
+    return actual_line - span.hidden_before - (span.last_line - span.first_line + 1);
+}
 
-    for (const auto& region : regions_)
+void TextEditorCodeFolding::AnalyzeAll(const TextEditor& editor)
+{
+    const int line_count = std::max(editor.GetLineCount(), 0);
+    lines_.clear();
+    lines_.resize(static_cast<std::size_t>(line_count) + 1);
+    nodes_.clear();
+    brace_regions_.clear();
+    indent_regions_.clear();
+    regions_derived_ = false;  // Merged as a whole afterwards
+
+    TokenizeLines(editor, 0, line_count);
+    ScanRegions(0, line_count);
+    analyzed_nodes_ = nodes_.size();
+}
+
+bool TextEditorCodeFolding::ApplyLineChange(int first, int old_count, int new_count, int& dirty_begin,
+                                            int& dirty_end)
+{
+    const int old_end = first + old_count;
+    const int new_end = first + new_count;
+    const int delta = new_count - old_count;
+    if (first < 0 || old_count < 0 || new_count < 0 || old_end >= static_cast<int>(lines_.size()))
+        return false;
+
+    const int min_lines = std::max(config_.min_lines_to_fold, 1);
+    const auto shown = [min_lines](const FoldRegion& region) { return region.end_line - region.start_line >= min_lines; };
+    const int common = std::min(old_count, new_count);
+    if (delta < 0)
     {
-        if (region.is_folded && actual_line > region.end_line)
+        // Regions ending on removed lines are derived again, folds starting there are dropped
+        removed_regions_.clear();
+        added_regions_.clear();
+        for (auto* regions : {&brace_regions_, &indent_regions_})
+        {
+            const auto begin = std::lower_bound(regions->begin(), regions->end(), first + common, EndsBefore);
+            const auto end = std::lower_bound(begin, regions->end(), old_end, EndsBefore);
+            std::copy_if(begin, end, std::back_inserter(removed_regions_), shown);
+            regions->erase(begin, end);
+        }
+        ApplyRegionChanges(removed_regions_, added_regions_);
+        for (auto it = std::lower_bound(regions_.begin(), regions_.end(), first + common, StartsBefore);
+             it != regions_.end() && it->start_line < old_end; ++it)
         {
-            visual_line -= (region.end_line - region.start_line);
+            hidden_spans_stale_ = hidden_spans_stale_ || it->is_folded;
+            it->is_folded = false;
         }
     }
 
-    return visual_line;
-}
-
-void TextEditorCodeFolding::DetectBraceRegions(const TextEditor& editor,
-                                               std::span<const int> line_indents,
-                                               std::vector<FoldRegion>& out_regions)
-{
-    std::array<std::byte, 4096> scratch_storage{};
-    std::pmr::monotonic_buffer_resource scratch_resource(scratch_storage.data(), scratch_storage.size());
-    std::pmr::vector<int> brace_stack{&scratch_resource};
-    brace_stack.reserve(static_cast<std::size_t>(std::max(8, editor.GetLineCount() / 8)));
-
-    std::string line;
-    const int line_count = editor.GetLineCount();
-    for (int i = 0; i < line_count; ++i)
+    // The first new line starts with the state the first old line started with
+    const LineState start_state = lines_[first];
+    if (delta < 0)
+        lines_.erase(lines_.begin() + first + common, lines_.begin() + old_end);
+    else if (delta > 0)
+        lines_.insert(lines_.begin() + first + common, static_cast<std::size_t>(delta), LineState());
+    lines_[first].brace_stack = start_state.brace_stack;
+    lines_[first].indent_stack = start_state.indent_stack;
+    lines_[first].last_code_line = start_state.last_code_line;
+
+    if (delta != 0)
     {
-        editor.GetLineText(i, line);
+        // Positions below the change move with it
+        const auto moved = [&](int line) { return line >= old_end ? line + delta : line; };
+        for (auto& state : lines_)
+        {
+            if (state.last_code_line >= first + common && state.last_code_line < old_end)
+                state.last_code_line = -2;
+            else
+                state.last_code_line = moved(state.last_code_line);
+        }
+        for (auto& node : nodes_)
+            node.line = moved(node.line);
 
-        for (char ch : line)
+        // Regions across the change grow or shrink, which may take them past the minimum length
+        removed_regions_.clear();
+        added_regions_.clear();
+        for (auto* regions : {&brace_regions_, &indent_regions_})
         {
-            if (ch == '{')
+            for (auto it = std::lower_bound(regions->begin(), regions->end(), old_end, EndsBefore); it != regions->end(); ++it)
             {
-                brace_stack.push_back(i);
+                const bool was_shown = shown(*it);
+                it->start_line = moved(it->start_line);
+                it->end_line += delta;
+                if (was_shown != shown(*it))
+                    (was_shown ? removed_regions_ : added_regions_).push_back(*it);
             }
-            else if (ch == '}')
+        }
+
+        // Regions starting on removed lines keep their line, those moved up to it sort among them
+        const auto window_begin = std::lower_bound(regions_.begin(), regions_.end(), first + common, StartsBefore) - regions_.begin();
+        const auto window_end = std::lower_bound(regions_.begin(), regions_.end(), old_end - std::min(delta, 0), StartsBefore) - regions_.begin();
+        for (auto& region : regions_)
+        {
+            region.start_line = moved(region.start_line);
+            region.end_line = moved(region.end_line);
+        }
+        std::sort(regions_.begin() + window_begin, regions_.begin() + window_end, ByPosition);
+
+        const auto cache_size = static_cast<int>(line_to_region_.size());
+        if (delta > 0 && old_end < cache_size)
+            line_to_region_.insert(line_to_region_.begin() + old_end, static_cast<std::size_t>(delta), -1);
+        else if (delta < 0 && new_end < cache_size)
+        {
+            line_to_region_.erase(line_to_region_.begin() + new_end, line_to_region_.begin() + std::min(old_end, cache_size));
+            std::fill(line_to_region_.begin() + new_end,
+                      line_to_region_.begin() + std::min(old_end, static_cast<int>(line_to_region_.size())), -1);
+        }
+        for (auto i = window_begin; i < window_end; ++i)
+        {
+            const auto line = static_cast<std::size_t>(regions_[static_cast<std::size_t>(i)].start_line);
+            if (line >= line_to_region_.size())
+                line_to_region_.resize(line + 1, -1);
+            line_to_region_[line] = static_cast<int>(i);
+        }
+        ApplyRegionChanges(removed_regions_, added_regions_);
+
+        // Spans below the change move with it, one reaching into it is rebuilt from the regions
+        auto span = std::lower_bound(hidden_spans_.begin(), hidden_spans_.end(), first,
+                                     [](const HiddenSpan& hidden, int line) { return hidden.last_line < line; });
+        if (span != hidden_spans_.end() && span->first_line <= old_end)
+            hidden_spans_stale_ = true;
+        else if (span != hidden_spans_.end())
+        {
+            for (; span != hidden_spans_.end(); ++span)
             {
-                if (!brace_stack.empty())
-                {
-                    int start_line = brace_stack.back();
-                    brace_stack.pop_back();
-
-                    FoldRegion region;
-                    region.start_line = start_line;
-                    region.end_line = i;
-                    region.indent_level = line_indents[static_cast<std::size_t>(start_line)];
-                    out_regions.push_back(region);
-                }
+                span->first_line += delta;
+                span->last_line += delta;
             }
+            ++hidden_spans_revision_;
         }
     }
+
+    const auto map_line = [&](int line, bool is_end) {
+        if (line <= first)
+            return line;
+        if (line >= old_end)
+            return line + delta;
+        return is_end ? new_end : first;
+    };
+    if (dirty_begin >= 0)
+    {
+        dirty_begin = std::min(map_line(dirty_begin, false), first);
+        dirty_end = std::max(map_line(dirty_end, true), new_end);
+    }
+    else
+    {
+        dirty_begin = first;
+        dirty_end = new_end;
+    }
+    return true;
 }
 
-void TextEditorCodeFolding::DetectIndentationRegions(std::span<const int> line_indents,
-                                                     std::span<const unsigned char> line_is_blank,
-                                                     std::vector<FoldRegion>& out_regions)
+void TextEditorCodeFolding::TokenizeLines(const TextEditor& editor, int begin, int end)
 {
-    const int line_count = static_cast<int>(line_indents.size());
-    for (int i = 0; i < line_count; ++i)
+    const bool want_braces = config_.detection_mode == DetectionMode::Braces ||
+                             config_.detection_mode == DetectionMode::Both;
+    last_tokenized_lines_ += std::max(0, end - begin);
+    for (int line = begin; line < end; ++line)
     {
-        int current_indent = line_indents[static_cast<std::size_t>(i)];
+        auto& state = lines_[static_cast<std::size_t>(line)];
+        const int length = editor.GetLineLength(line);
+        int indent = 0;
+        int col = 0;
+        for (; col < length; ++col) {
+            const char ch = editor.GetGlyphChar(line, col);
+            if (ch == ' ')
+                indent++;
+            else if (ch == '\t')
+                indent += 4;  // Assume tab = 4 spaces
+            else
+                break;
+        }
+        while (col < length && std::isspace(static_cast<unsigned char>(editor.GetGlyphChar(line, col))) != 0)
+            ++col;
+        state.indent = indent;
+        state.blank = col == length;
+        state.closes = 0;
+        state.opens = 0;
+
+        if (!want_braces)
+            continue;
+
+        // Braces paired within the line never span lines, only the rest is kept
+        for (; col < length; ++col) {
+            const char ch = editor.GetGlyphChar(line, col);
+            if (ch != '{' && ch != '}')
+                continue;
+            const auto token_class = editor.GetGlyphTokenClass(line, col);
+            if (token_class == TextEditor::TokenClass::Comment || token_class == TextEditor::TokenClass::String)
+                continue;
+            if (ch == '{')
+                ++state.opens;
+            else if (state.opens > 0)
+                --state.opens;
+            else
+                ++state.closes;
+        }
+    }
+}
 
-        // Look ahead for lines with deeper indentation
-        int end_line = i;
-        for (int j = i + 1; j < line_count; ++j)
+void TextEditorCodeFolding::ScanRegions(int first_line, int dirty_end)
+{
+    const bool want_braces = config_.detection_mode == DetectionMode::Braces ||
+                             config_.detection_mode == DetectionMode::Both;
+    const bool want_indent = config_.detection_mode == DetectionMode::Indentation ||
+                             config_.detection_mode == DetectionMode::Both;
+    const int line_count = static_cast<int>(lines_.size()) - 1;
+
+    int brace_stack = lines_[first_line].brace_stack;
+    int indent_stack = lines_[first_line].indent_stack;
+    int last_code = lines_[first_line].last_code_line;
+    const int first_last_code = last_code;
+
+    scanned_brace_regions_.clear();
+    scanned_indent_regions_.clear();
+    const auto make_region = [&](const StackNode& node, int end_line) {
+        FoldRegion region;
+        region.start_line = node.line;
+        region.end_line = end_line;
+        region.indent_level = node.indent;
+        return region;
+    };
+    // An indented block ends at the last non-blank line before the line that closes it
+    const auto close_block = [&](int node) {
+        if (last_code > nodes_[node].line)
+            scanned_indent_regions_.push_back(make_region(nodes_[node], last_code));
+        return nodes_[node].parent;
+    };
+    // Pushes count nodes for line, reusing the ones the next line started with if they match
+    const auto push = [&](int stack, int old_stack, int line, int indent, int count) {
+        int node = old_stack;
+        int matched = 0;
+        for (; matched < count && node >= 0 && nodes_[node].line == line && nodes_[node].indent == indent; ++matched)
+            node = nodes_[node].parent;
+        if (count > 0 && matched == count && node == stack)
+            return old_stack;
+        for (int i = 0; i < count; ++i)
         {
-            // Skip empty lines
-            if (line_is_blank[static_cast<std::size_t>(j)] != 0)
-                continue;
+            nodes_.push_back(StackNode{stack, line, indent});
+            stack = static_cast<int>(nodes_.size()) - 1;
+        }
+        return stack;
+    };
 
-            int next_indent = line_indents[static_cast<std::size_t>(j)];
+    int line = first_line;
+    for (; line < line_count; ++line)
+    {
+        auto& state = lines_[static_cast<std::size_t>(line)];
 
-            if (next_indent > current_indent)
-            {
-                end_line = j;
-            }
-            else
+        // Below the edit, the same open braces and blocks mean the same regions as before
+        if (line >= dirty_end && line > first_line && state.brace_stack == brace_stack &&
+            state.indent_stack == indent_stack && state.last_code_line == last_code)
+        {
+            break;
+        }
+        state.brace_stack = brace_stack;
+        state.indent_stack = indent_stack;
+        state.last_code_line = last_code;
+        ++last_scanned_lines_;
+
+        if (want_braces)
+        {
+            for (int i = 0; i < state.closes && brace_stack >= 0; ++i)
             {
-                break;
+                scanned_brace_regions_.push_back(make_region(nodes_[brace_stack], line));
+                brace_stack = nodes_[brace_stack].parent;
             }
+            brace_stack = push(brace_stack, lines_[static_cast<std::size_t>(line) + 1].brace_stack, line,
+                               state.indent, state.opens);
         }
 
-        if (end_line > i)
+        if (state.blank)
+            continue;
+        if (want_indent)
         {
-            FoldRegion region;
-            region.start_line = i;
-            region.end_line = end_line;
-            region.indent_level = current_indent;
-            out_regions.push_back(region);
+            while (indent_stack >= 0 && nodes_[indent_stack].indent >= state.indent)
+                indent_stack = close_block(indent_stack);
+            indent_stack = push(indent_stack, lines_[static_cast<std::size_t>(line) + 1].indent_stack, line,
+                                state.indent, 1);
         }
+        last_code = line;
+    }
+
+    const bool reached_end = line == line_count;
+    if (reached_end)
+    {
+        auto& end_state = lines_[static_cast<std::size_t>(line_count)];
+        end_state.brace_stack = brace_stack;
+        end_state.indent_stack = indent_stack;
+        end_state.last_code_line = last_code;
+        while (indent_stack >= 0)
+            indent_stack = close_block(indent_stack);
     }
+
+    // Replace the regions closed by the scanned lines, which end next to each other
+    const int min_lines = std::max(config_.min_lines_to_fold, 1);
+    const auto shown = [min_lines](const FoldRegion& region) { return region.end_line - region.start_line >= min_lines; };
+    removed_regions_.clear();
+    added_regions_.clear();
+    const auto replace = [&](std::vector<FoldRegion>& regions, std::vector<FoldRegion>& scanned,
+                             int end_begin, int end_end) {
+        const auto begin = std::lower_bound(regions.begin(), regions.end(), end_begin, EndsBefore);
+        const auto end = reached_end ? regions.end() : std::lower_bound(begin, regions.end(), end_end, EndsBefore);
+        std::sort(scanned.begin(), scanned.end(), ByEnd);
+        if (regions_derived_)
+        {
+            std::copy_if(begin, end, std::back_inserter(removed_regions_), shown);
+            std::copy_if(scanned.begin(), scanned.end(), std::back_inserter(added_regions_), shown);
+        }
+        if (end - begin == static_cast<std::ptrdiff_t>(scanned.size()))
+        {
+            std::copy(scanned.begin(), scanned.end(), begin);
+            return;
+        }
+        const auto position = regions.erase(begin, end);
+        regions.insert(position, scanned.begin(), scanned.end());
+    };
+    replace(brace_regions_, scanned_brace_regions_, first_line, line);
+    replace(indent_regions_, scanned_indent_regions_, first_last_code, last_code);
+    ApplyRegionChanges(removed_regions_, added_regions_);
+}
+
+void TextEditorCodeFolding::MergeRegions(std::vector<int>& folded_lines)
+{
+    std::sort(folded_lines.begin(), folded_lines.end());
+
+    regions_.clear();
+    regions_.reserve(brace_regions_.size() + indent_regions_.size());
+    regions_.insert(regions_.end(), brace_regions_.begin(), brace_regions_.end());
+    regions_.insert(regions_.end(), indent_regions_.begin(), indent_regions_.end());
+
+    // Filter by minimum lines and restore fold state from before re-analysis
+    const int min_lines = std::max(config_.min_lines_to_fold, 1);
+    std::erase_if(regions_, [&](const FoldRegion& region) {
+        return region.end_line - region.start_line < min_lines;
+    });
+    std::sort(regions_.begin(), regions_.end(), ByPosition);
+    for (auto& region : regions_)
+        region.is_folded = std::binary_search(folded_lines.begin(), folded_lines.end(), region.start_line);
+
+    regions_derived_ = true;
+    RebuildCache();
 }
 
-int TextEditorCodeFolding::GetIndentLevel(const std::string& line) const
+void TextEditorCodeFolding::ApplyRegionChanges(std::vector<FoldRegion>& removed, std::vector<FoldRegion>& added)
 {
-    int indent = 0;
-    for (char ch : line)
+    if (!regions_derived_)
+        return;
+
+    // Regions derived again unchanged keep their entry
+    std::sort(removed.begin(), removed.end(), ByPosition);
+    std::sort(added.begin(), added.end(), ByPosition);
+    std::vector<FoldRegion> gone;
+    std::vector<FoldRegion> fresh;
+    std::set_difference(removed.begin(), removed.end(), added.begin(), added.end(), std::back_inserter(gone), ByPosition);
+    std::set_difference(added.begin(), added.end(), removed.begin(), removed.end(), std::back_inserter(fresh), ByPosition);
+    if (gone.empty() && fresh.empty())
+        return;
+
+    // Only the entries starting between the first and last changed start line are rewritten
+    const int first_line = std::min(gone.empty() ? INT_MAX : gone.front().start_line,
+                                    fresh.empty() ? INT_MAX : fresh.front().start_line);
+    const int last_line = std::max(gone.empty() ? INT_MIN : gone.back().start_line,
+                                   fresh.empty() ? INT_MIN : fresh.back().start_line);
+    const auto begin = std::lower_bound(regions_.begin(), regions_.end(), first_line, StartsBefore);
+    const auto end = std::lower_bound(begin, regions_.end(), last_line + 1, StartsBefore);
+
+    // Fold state follows the start line
+    for (auto& region : fresh)
     {
-        if (ch == ' ')
-            indent++;
-        else if (ch == '\t')
-            indent += 4;  // Assume tab = 4 spaces
-        else
-            break;
+        for (auto it = std::lower_bound(begin, end, region.start_line, StartsBefore);
+             it != end && it->start_line == region.start_line; ++it)
+        {
+            region.is_folded = region.is_folded || it->is_folded;
+        }
+        hidden_spans_stale_ = hidden_spans_stale_ || region.is_folded;
     }
-    return indent;
+
+    std::vector<FoldRegion> kept;
+    auto next_gone = gone.begin();
+    for (auto it = begin; it != end; ++it)
+    {
+        while (next_gone != gone.end() && ByPosition(*next_gone, *it))
+            ++next_gone;
+        if (next_gone != gone.end() && !ByPosition(*it, *next_gone))
+        {
+            hidden_spans_stale_ = hidden_spans_stale_ || it->is_folded;
+            ++next_gone;
+            continue;
+        }
+        kept.push_back(*it);
+    }
+    std::vector<FoldRegion> window;
+    window.reserve(kept.size() + fresh.size());
+    std::merge(kept.begin(), kept.end(), fresh.begin(), fresh.end(), std::back_inserter(window), ByPosition);
+
+    const auto first = begin - regions_.begin();
+    const auto old_size = end - begin;
+    if (static_cast<std::ptrdiff_t>(window.size()) == old_size)
+        std::copy(window.begin(), window.end(), begin);
+    else
+        regions_.insert(regions_.erase(begin, end), window.begin(), window.end());
+
+    // Start lines past the window keep their region, only its index moves
+    const int shift = static_cast<int>(window.size() - static_cast<std::size_t>(old_size));
+    if (shift != 0)
+    {
+        for (auto line = static_cast<std::size_t>(last_line) + 1; line < line_to_region_.size(); ++line)
+        {
+            if (line_to_region_[line] >= 0)
+                line_to_region_[line] += shift;
+        }
+    }
+    if (line_to_region_.size() <= static_cast<std::size_t>(last_line))
+        line_to_region_.resize(static_cast<std::size_t>(last_line) + 1, -1);
+    std::fill(line_to_region_.begin() + first_line, line_to_region_.begin() + last_line + 1, -1);
+    for (std::size_t i = 0; i < window.size(); ++i)
+        line_to_region_[static_cast<std::size_t>(window[i].start_line)] = static_cast<int>(first + static_cast<std::ptrdiff_t>(i));
 }
 
 bool TextEditorCodeFolding::IsOpeningBraceLine(const std::string& line) const
@@ -422,12 +787,58 @@ bool TextEditorCodeFolding::IsOpeningBraceLine(const std::string& line) const
     return it != line.rend() && *it == '{';
 }
 
+int TextEditorCodeFolding::FindRegionIndex(int line) const
+{
+    if (line < 0 || line >= static_cast<int>(line_to_region_.size()))
+        return -1;
+    return line_to_region_[static_cast<std::size_t>(line)];
+}
+
 void TextEditorCodeFolding::RebuildCache()
 {
+    // Regions from SetFoldRegions may come in any order
+    if (!std::is_sorted(regions_.begin(), regions_.end(), ByPosition))
+        std::stable_sort(regions_.begin(), regions_.end(), ByPosition);
+
     line_to_region_.clear();
+    if (!regions_.empty())
+        line_to_region_.resize(static_cast<std::size_t>(std::max(regions_.back().start_line + 1, 0)), -1);
 
     for (size_t i = 0; i < regions_.size(); ++i)
     {
-        line_to_region_[regions_[i].start_line] = i;
+        if (regions_[i].start_line >= 0)
+            line_to_region_[static_cast<std::size_t>(regions_[i].start_line)] = static_cast<int>(i);
+    }
+
+    RebuildHiddenSpans();
+}
+
+void TextEditorCodeFolding::RebuildHiddenSpans()
+{
+    hidden_spans_.clear();
+    ++hidden_spans_revision_;
+    hidden_spans_stale_ = false;
+
+    // Regions are sorted by start line, so overlapping or adjacent spans arrive in order
+    int hidden = 0;
+    for (const auto& region : regions_)
+    {
+        if (!region.is_folded || !region.IsValid())
+            continue;
+
+        const int first_line = region.start_line + 1;
+        if (!hidden_spans_.empty() && first_line <= hidden_spans_.back().last_line + 1)
+        {
+            auto& span = hidden_spans_.back();
+            if (region.end_line > span.last_line)
+            {
+                hidden += region.end_line - span.last_line;
+                span.last_line = region.end_line;
+            }
+            continue;
+        }
+
+        hidden_spans_.push_back(HiddenSpan{first_line, region.end_line, hidden});
+        hidden += region.end_line - region.start_line;
     }
 }
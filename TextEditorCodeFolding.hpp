@@ -1,10 +1,9 @@
 #pragma once
 
 #include "imgui.h"
+#include <cstdint>
 #include <vector>
-#include <unordered_map>
 #include <optional>
-#include <span>
 #include <string>
 
 // Forward declaration
@@ -116,14 +115,14 @@ public:
     [[nodiscard]] bool IsLineHidden(int line) const;
 
     /**
-     * @brief Get the fold region that contains this line
+     * @brief Get the fold region that ToggleFold, Fold and Unfold act on at this line
      * @param line Line number
      * @return Fold region, or nullopt if none
      */
     [[nodiscard]] std::optional<FoldRegion> GetRegionAtLine(int line) const;
 
     /**
-     * @brief Get fold region that starts at this line
+     * @brief Get fold region that starts at this line, the widest if several do
      * @param line Line number
      * @return Fold region, or nullopt if none starts here
      */
@@ -165,6 +164,16 @@ public:
      */
     [[nodiscard]] int ActualLineToVisualLine(int actual_line) const;
 
+    /**
+     * @brief Hide the lines of folded regions in the editor's visual line model
+     *
+     * Only the spans whose fold state changed since the last call are hidden or shown
+     * again, so toggling one fold rebuilds only its lines. The folding owns the
+     * editor's hidden line ranges while it is synced.
+     * @param editor The text editor showing the document
+     */
+    void SyncHiddenLines(TextEditor& editor);
+
     /**
      * @brief Get all fold regions
      */
@@ -176,6 +185,7 @@ public:
      */
     void SetFoldRegions(std::vector<FoldRegion> regions) {
         regions_ = std::move(regions);
+        regions_derived_ = false;
         RebuildCache();
     }
 
@@ -186,35 +196,120 @@ public:
     void SetEnabled(bool enabled) { config_.enabled = enabled; }
     [[nodiscard]] bool IsEnabled() const { return config_.enabled; }
 
+    /**
+     * @brief Number of lines re-read by the last analysis
+     */
+    [[nodiscard]] int GetLastTokenizedLineCount() const { return last_tokenized_lines_; }
+
+    /**
+     * @brief Number of lines whose regions were derived again by the last analysis
+     */
+    [[nodiscard]] int GetLastScannedLineCount() const { return last_scanned_lines_; }
+
 private:
     Config config_;
     std::vector<FoldRegion> regions_;
+    bool regions_derived_ = false;  // regions_ holds the detected regions, so edits can splice it
+
+    // Cache: start line -> index of the widest region starting there, -1 if none
+    std::vector<int> line_to_region_;
+
+    // Lines hidden by folded regions, merged into disjoint spans sorted by line
+    struct HiddenSpan
+    {
+        int first_line = 0;
+        int last_line = 0;
+        int hidden_before = 0;  // Hidden lines in the spans before this one
+    };
+    std::vector<HiddenSpan> hidden_spans_;
+    std::uint64_t hidden_spans_revision_ = 0;
+    bool hidden_spans_stale_ = false;  // A folded region changed, rebuild the spans after the analysis
+
+    // Hidden spans last handed to the editor by SyncHiddenLines
+    TextEditor* synced_editor_ = nullptr;
+    std::vector<HiddenSpan> synced_spans_;
+    std::uint64_t synced_revision_ = 0;
+
+    // Open brace or indented line on a persistent stack; lines share the nodes below their own.
+    // A rescanned line reuses the node it pushed before, so unchanged lines keep their stacks.
+    struct StackNode
+    {
+        int parent = -1;
+        int line = 0;
+        int indent = 0;
+    };
+
+    // Per-line summary, one extra entry holds the state after the last line
+    struct LineState
+    {
+        int indent = 0;
+        bool blank = true;
+        int closes = 0;           // '}' not matched within the line
+        int opens = 0;            // '{' not matched within the line
+        int brace_stack = -1;     // StackNode of the braces open at the start of the line
+        int indent_stack = -1;    // StackNode of the lines whose block is open at the start of the line
+        int last_code_line = -1;  // Last non-blank line above, -2 once that line was removed
+    };
 
-    // Cache: line -> region index
-    std::unordered_map<int, size_t> line_to_region_;
+    std::vector<LineState> lines_;
+    std::vector<StackNode> nodes_;
 
-    // Dirty tracking: skip re-analysis when document hasn't changed
-    int last_undo_index_ = -1;
-    int last_line_count_ = -1;
+    // Detected regions, each sorted by end line then start line, so the regions a scan closes are adjacent
+    std::vector<FoldRegion> brace_regions_;
+    std::vector<FoldRegion> indent_regions_;
+    std::vector<FoldRegion> scanned_brace_regions_;
+    std::vector<FoldRegion> scanned_indent_regions_;
+
+    // Entries of regions_ an analysis step removes and adds
+    std::vector<FoldRegion> removed_regions_;
+    std::vector<FoldRegion> added_regions_;
+
+    // Change tracking: skip re-analysis when neither the text nor its token classes changed
+    const TextEditor* editor_ = nullptr;
+    std::uint64_t last_token_version_ = 0;
+    DetectionMode analyzed_mode_ = DetectionMode::Both;
+    int analyzed_min_lines_ = 0;
+    std::size_t analyzed_nodes_ = 0;
+    int last_tokenized_lines_ = 0;
+    int last_scanned_lines_ = 0;
+
+    /**
+     * @brief Re-read every line and derive all regions
+     */
+    void AnalyzeAll(const TextEditor& editor);
 
     /**
-     * @brief Detect fold regions using brace matching.
+     * @brief Update line states, regions and hidden spans for one change
+     *
+     * Nothing outside the changed lines is touched unless the change adds or removes lines.
+     * @param dirty_begin, dirty_end Line range to re-read (-1 if none yet), widened to cover the change
+     * @return false if the change doesn't fit the known lines
      */
-    void DetectBraceRegions(const TextEditor& editor,
-                            std::span<const int> line_indents,
-                            std::vector<FoldRegion>& out_regions);
+    bool ApplyLineChange(int first, int old_count, int new_count, int& dirty_begin, int& dirty_end);
 
     /**
-     * @brief Detect fold regions using indentation.
+     * @brief Re-read indentation and braces outside strings and comments of lines [begin, end)
      */
-    void DetectIndentationRegions(std::span<const int> line_indents,
-                                  std::span<const unsigned char> line_is_blank,
-                                  std::vector<FoldRegion>& out_regions);
+    void TokenizeLines(const TextEditor& editor, int begin, int end);
 
     /**
-     * @brief Get indentation level of a line
+     * @brief Derive regions from first_line on, until a line at or past dirty_end starts
+     *        with the same open braces and blocks as before
      */
-    [[nodiscard]] int GetIndentLevel(const std::string& line) const;
+    void ScanRegions(int first_line, int dirty_end);
+
+    /**
+     * @brief Rebuild regions_ from the detected regions, folding those starting at folded_lines
+     */
+    void MergeRegions(std::vector<int>& folded_lines);
+
+    /**
+     * @brief Splice removed and added entries into regions_ and patch the start-line cache
+     *
+     * Entries both removed and added stay where they are. Added entries are folded if a region
+     * starting on their line was; hidden spans go stale if a folded region is involved.
+     */
+    void ApplyRegionChanges(std::vector<FoldRegion>& removed, std::vector<FoldRegion>& added);
 
     /**
      * @brief Check if line contains only opening brace
@@ -222,7 +317,17 @@ private:
     [[nodiscard]] bool IsOpeningBraceLine(const std::string& line) const;
 
     /**
-     * @brief Rebuild the line-to-region cache
+     * @brief Region index starting at line, -1 if none
+     */
+    [[nodiscard]] int FindRegionIndex(int line) const;
+
+    /**
+     * @brief Rebuild the line-to-region cache and the hidden spans
      */
     void RebuildCache();
+
+    /**
+     * @brief Rebuild the hidden spans after a fold state change
+     */
+    void RebuildHiddenSpans();
 };
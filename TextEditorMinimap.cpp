@@ -8,44 +8,6 @@ static float SmoothLerp(float current, float target, float speed)
     return current + (target - current) * std::min(1.0f, speed);
 }
 
-namespace {
-
-[[nodiscard]] auto IsBracketChar(char value) -> bool
-{
-    return value == '(' || value == ')' || value == '{' || value == '}' ||
-           value == '[' || value == ']' || value == '<' || value == '>';
-}
-
-[[nodiscard]] auto ResolveRunColor(
-    TextEditorMinimap::LineColorKind kind,
-    ImU32 color_default,
-    ImU32 color_string,
-    ImU32 color_comment,
-    ImU32 color_number,
-    ImU32 color_bracket,
-    ImU32 color_type
-) -> ImU32
-{
-    switch (kind)
-    {
-    case TextEditorMinimap::LineColorKind::String:
-        return color_string;
-    case TextEditorMinimap::LineColorKind::Comment:
-        return color_comment;
-    case TextEditorMinimap::LineColorKind::Number:
-        return color_number;
-    case TextEditorMinimap::LineColorKind::Bracket:
-        return color_bracket;
-    case TextEditorMinimap::LineColorKind::Type:
-        return color_type;
-    case TextEditorMinimap::LineColorKind::Default:
-    default:
-        return color_default;
-    }
-}
-
-} // namespace
-
 // Apply alpha to color
 static ImU32 ApplyAlpha(ImU32 color, float alpha)
 {
@@ -59,6 +21,71 @@ static ImU32 ApplyAlpha(const vscode::colors::ColorRef& color, float alpha)
     return vscode::colors::apply_alpha(color, alpha);
 }
 
+// Move the lines of a row table, where row r holds lines [row_lines[r], row_lines[r + 1]),
+// after lines were inserted (delta > 0) or removed at line. Rows [first_row, end_row) receive
+// other lines; later rows keep theirs, which only move. Returns false when the rows cannot
+// hold between one and max_lines lines each any more.
+static bool MoveRowLines(std::vector<int>& row_lines, int line, int delta, int max_lines, int& first_row, int& end_row)
+{
+    const int rows = static_cast<int>(row_lines.size()) - 1;
+    const int line_count = row_lines.back() + delta;
+    if (line_count < rows || line_count > max_lines * rows)
+        return false;
+
+    // Inserted lines join the row of the line before them, which is usually the line that was split
+    auto row_of = [&row_lines, rows](int l) {
+        const auto it = std::upper_bound(row_lines.begin(), row_lines.begin() + rows, l);
+        return std::max(0, static_cast<int>(it - row_lines.begin()) - 1);
+    };
+    first_row = row_of(delta > 0 ? line - 1 : line);
+    end_row = first_row + 1;
+    if (delta > 0)
+    {
+        for (int r = first_row + 1; r <= rows; ++r)
+            row_lines[static_cast<std::size_t>(r)] += delta;
+    }
+    else
+    {
+        const int removed_end = line - delta;
+        end_row = row_of(removed_end - 1) + 1;
+        for (int r = first_row + 1; r <= rows; ++r)
+        {
+            int& boundary = row_lines[static_cast<std::size_t>(r)];
+            boundary = boundary >= removed_end ? boundary + delta : std::min(boundary, line);
+        }
+    }
+
+    // Even out the rows around them when one holds more than max_lines, or nothing
+    bool uneven = false;
+    for (int r = first_row; r < end_row; ++r)
+    {
+        const int count = row_lines[static_cast<std::size_t>(r) + 1] - row_lines[static_cast<std::size_t>(r)];
+        uneven = uneven || count == 0 || count > max_lines;
+    }
+    if (!uneven)
+        return true;
+
+    // Widen the window until its lines fill every row without exceeding max_lines; the whole
+    // table qualifies, as checked above
+    const int changed_begin = first_row;
+    const int changed_end = end_row;
+    for (int spread = 8;; spread *= 2)
+    {
+        first_row = std::max(0, changed_begin - spread);
+        end_row = std::min(rows, changed_end + spread);
+        const int window_lines = row_lines[static_cast<std::size_t>(end_row)] - row_lines[static_cast<std::size_t>(first_row)];
+        const int window_rows = end_row - first_row;
+        if ((window_lines >= window_rows && window_lines <= max_lines * window_rows) || window_rows == rows)
+            break;
+    }
+    const int begin_line = row_lines[static_cast<std::size_t>(first_row)];
+    const int window_lines = row_lines[static_cast<std::size_t>(end_row)] - begin_line;
+    const int window_rows = end_row - first_row;
+    for (int r = 1; r < window_rows; ++r)
+        row_lines[static_cast<std::size_t>(first_row + r)] = begin_line + static_cast<int>(static_cast<std::int64_t>(r) * window_lines / window_rows);
+    return true;
+}
+
 bool TextEditorMinimap::Render(const TextEditor& editor, const ImVec2& available_region)
 {
     if (!config_.enabled)
@@ -118,53 +145,104 @@ bool TextEditorMinimap::Render(const TextEditor& editor, const ImVec2& available
         float line_height = content_height / static_cast<float>(total_lines);
         float actual_line_h = std::max(1.0f, line_height * 0.75f);
 
-        // Syntax colors (modern palette)
-        ImU32 color_default  = ApplyAlpha(vscode::colors::minimap_text, config_.opacity_foreground);
-        ImU32 color_string   = ApplyAlpha(vscode::colors::minimap_string, config_.opacity_foreground);
-        ImU32 color_comment  = ApplyAlpha(vscode::colors::minimap_comment, config_.opacity_foreground);
-        ImU32 color_number   = ApplyAlpha(vscode::colors::syntax_number, config_.opacity_foreground);
-        ImU32 color_bracket  = ApplyAlpha(vscode::colors::minimap_bracket, config_.opacity_foreground);
-        ImU32 color_type     = ApplyAlpha(vscode::colors::syntax_type, config_.opacity_foreground);
-
-        for (int i = 0; i < total_lines; ++i)
+        const float opacity = config_.opacity_foreground;
+        render_stats_.quads = 0;
+        if (texture_host_.create && texture_host_.update)
         {
-            if (i < 0 || i >= static_cast<int>(cached_line_summaries_.size()))
-                continue;
-            const auto& line_summary = cached_line_summaries_[static_cast<std::size_t>(i)];
-            if (line_summary.runs.empty())
-                continue;
-
-            float y = minimap_min.y + (static_cast<float>(i) / static_cast<float>(total_lines)) * content_height;
-            float base_x = minimap_min.x + 4.0f + static_cast<float>(line_summary.indent_columns) * 0.8f;
-            float max_x = minimap_max.x - 4.0f;
-
-            for (const auto& run : line_summary.runs)
+            // One image for the whole document; edits only rasterize their rows again
+            const float base_x = minimap_min.x + 4.0f;
+            const int width = std::max(1, static_cast<int>(minimap_max.x - 4.0f - base_x));
+            const ImTextureID texture = UpdateTexture(editor, width);
+            draw_list->AddImage(texture,
+                                ImVec2(base_x, minimap_min.y),
+                                ImVec2(base_x + static_cast<float>(width), minimap_min.y + content_height),
+                                ImVec2(0.0f, 0.0f),
+                                ImVec2(1.0f, static_cast<float>(pixel_rows_) / static_cast<float>(texture_->height)),
+                                ApplyAlpha(IM_COL32_WHITE, opacity));
+            ++render_stats_.quads;
+        }
+        else if (total_lines > (std::max(1, static_cast<int>(content_height)) << kLodBaseShift))
+        {
+            // Lines outnumber pixel rows: draw the coarsest level with a row per pixel at most
+            UpdateLod(editor);
+            const int pixel_rows = std::max(1, static_cast<int>(content_height));
+            std::size_t level = 0;
+            while (level + 1 < lod_levels_.size() && lod_levels_[level].size() / kLodCells > static_cast<std::size_t>(pixel_rows))
+                ++level;
+            const auto& cells = lod_levels_[level];
+            const int rows = static_cast<int>(cells.size() / kLodCells);
+            const int base_rows = static_cast<int>(lod_row_lines_.size()) - 1;
+            const float base_x = minimap_min.x + 4.0f;
+            const float max_x = minimap_max.x - 4.0f;
+
+            for (int row = 0; row < rows; ++row)
             {
-                float run_x = base_x + static_cast<float>(run.start_column);
-                if (run_x >= max_x)
+                // A row covers 1 << level rows of level 0, which hold their own number of lines
+                const int first_line = lod_row_lines_[static_cast<std::size_t>(std::min(row << level, base_rows))];
+                const int end_line = lod_row_lines_[static_cast<std::size_t>(std::min((row + 1) << level, base_rows))];
+                if (end_line == first_line)
+                    continue;
+                const float y = minimap_min.y + (static_cast<float>(first_line) / static_cast<float>(total_lines)) * content_height;
+                const float row_h = std::max(1.0f, static_cast<float>(end_line - first_line) / static_cast<float>(total_lines) * content_height * 0.75f);
+                const auto full_coverage = static_cast<float>((end_line - first_line) * kLodCellColumns);
+                const LodCell* row_cells = cells.data() + static_cast<std::size_t>(row) * kLodCells;
+                for (int cell = 0; cell < kLodCells; ++cell)
                 {
-                    break;
+                    const float cell_x = base_x + static_cast<float>(cell * kLodCellColumns);
+                    if (cell_x >= max_x)
+                        break;
+                    if (row_cells[cell].coverage == 0)
+                        continue;
+
+                    // Sparse cells fade instead of filling the whole cell
+                    const float density = std::min(1.0f, static_cast<float>(row_cells[cell].coverage) / full_coverage);
+                    draw_list->AddRectFilled(
+                        ImVec2(cell_x, y),
+                        ImVec2(std::min(cell_x + static_cast<float>(kLodCellColumns), max_x), y + row_h),
+                        ApplyAlpha(row_cells[cell].color, opacity * (0.35f + 0.65f * density))
+                    );
+                    ++render_stats_.quads;
                 }
+            }
+        }
+        else
+        {
+            for (int i = 0; i < total_lines; ++i)
+            {
+                if (i < 0 || i >= static_cast<int>(cached_line_summaries_.size()))
+                    continue;
+                const auto& line_summary = cached_line_summaries_[static_cast<std::size_t>(i)];
+                if (line_summary.run_count == 0)
+                    continue;
 
-                float run_width = static_cast<float>(run.length) + 0.2f;
-                float clamped_width = std::min(run_width, max_x - run_x);
-                if (clamped_width <= 0.0f)
+                float y = minimap_min.y + (static_cast<float>(i) / static_cast<float>(total_lines)) * content_height;
+                float base_x = minimap_min.x + 4.0f + static_cast<float>(line_summary.indent_columns) * 0.8f;
+                float max_x = minimap_max.x - 4.0f;
+
+                const LineRun* runs = run_pool_.data() + line_summary.first_run;
+                for (std::uint32_t r = 0; r < line_summary.run_count; ++r)
                 {
-                    continue;
+                    const auto& run = runs[r];
+                    float run_x = base_x + static_cast<float>(run.start_column);
+                    if (run_x >= max_x)
+                    {
+                        break;
+                    }
+
+                    float run_width = static_cast<float>(run.length) + 0.2f;
+                    float clamped_width = std::min(run_width, max_x - run_x);
+                    if (clamped_width <= 0.0f)
+                    {
+                        continue;
+                    }
+
+                    draw_list->AddRectFilled(
+                        ImVec2(run_x, y),
+                        ImVec2(run_x + clamped_width, y + actual_line_h),
+                        opacity >= 1.0f ? run.color : ApplyAlpha(run.color, opacity)
+                    );
+                    ++render_stats_.quads;
                 }
-
-                draw_list->AddRectFilled(
-                    ImVec2(run_x, y),
-                    ImVec2(run_x + clamped_width, y + actual_line_h),
-                    ResolveRunColor(
-                        run.color,
-                        color_default,
-                        color_string,
-                        color_comment,
-                        color_number,
-                        color_bracket,
-                        color_type)
-                );
             }
         }
 
@@ -282,119 +360,540 @@ bool TextEditorMinimap::Render(const TextEditor& editor, const ImVec2& available
 
 void TextEditorMinimap::RebuildLineSummaries(const TextEditor& editor)
 {
-    const int undo_index = editor.GetUndoIndex();
-    const int line_count = editor.GetLineCount();
-    if (cached_undo_index_ == undo_index &&
-        cached_line_count_ == line_count &&
+    last_summarized_lines_ = 0;
+    const std::uint64_t version = editor.GetColorVersion();
+    const int line_count = std::max(0, editor.GetLineCount());
+    if (cached_editor_ == &editor && cached_color_version_ == version &&
         static_cast<int>(cached_line_summaries_.size()) == line_count)
     {
         return;
     }
 
-    cached_undo_index_ = undo_index;
-    cached_line_count_ = line_count;
-    cached_line_summaries_.clear();
-    cached_line_summaries_.resize(static_cast<std::size_t>(std::max(0, line_count)));
+    changes_.clear();
+    bool incremental = cached_editor_ == &editor && editor.GetColorChangesSince(cached_color_version_, changes_);
+    cached_editor_ = &editor;
+    cached_color_version_ = version;
 
-    std::string line_text;
-    for (int line = 0; line < line_count; ++line)
+    // Summaries outside the changed blocks only move with them
+    int dirty_begin = -1;
+    int dirty_end = -1;
+    for (const auto& change : changes_)
     {
-        editor.GetLineText(line, line_text);
-        auto& summary = cached_line_summaries_[static_cast<std::size_t>(line)];
-        summary.runs.clear();
-        if (line_text.empty())
+        if (!incremental)
+            break;
+        const int first = change.mFirstLine;
+        const int old_end = first + change.mOldCount;
+        const int new_end = first + change.mNewCount;
+        const int delta = change.mNewCount - change.mOldCount;
+        if (first < 0 || old_end > static_cast<int>(cached_line_summaries_.size()))
         {
-            summary.indent_columns = 0;
-            continue;
+            incremental = false;
+            break;
         }
 
-        std::size_t indent = 0;
-        for (char c : line_text)
+        const int common = std::min(change.mOldCount, change.mNewCount);
+        if (delta != 0 && !pixels_.empty() && !raster_all_)
         {
-            if (c == ' ')
-            {
-                ++indent;
-            }
-            else if (c == '\t')
-            {
-                indent += 4;
-            }
+            // Rows follow the lines one to one while they fit, and share them after that
+            const int line_count_before = static_cast<int>(cached_line_summaries_.size());
+            if (pixel_rows_ == line_count_before && line_count_before + delta <= config_.max_texture_rows)
+                ShiftPixelRows(first + common, delta);
             else
-            {
-                break;
-            }
+                RemapPixelRows(first + common, delta);
+        }
+        if (delta < 0)
+        {
+            const auto erase_begin = cached_line_summaries_.begin() + first + common;
+            const auto erase_end = cached_line_summaries_.begin() + old_end;
+            for (auto it = erase_begin; it != erase_end; ++it)
+                dead_runs_ += it->run_count;
+            cached_line_summaries_.erase(erase_begin, erase_end);
+        }
+        else if (delta > 0)
+        {
+            cached_line_summaries_.insert(cached_line_summaries_.begin() + first + common,
+                                          static_cast<std::size_t>(delta), LineSummary());
         }
-        summary.indent_columns = static_cast<std::uint16_t>(std::min<std::size_t>(indent, std::numeric_limits<std::uint16_t>::max()));
 
-        bool in_string = false;
-        bool in_comment = false;
-        for (std::size_t index = indent; index < line_text.size(); ++index)
+        const auto map_line = [&](int line, bool is_end) {
+            if (line <= first)
+                return line;
+            if (line >= old_end)
+                return line + delta;
+            return is_end ? new_end : first;
+        };
+        dirty_begin = dirty_begin < 0 ? first : std::min(map_line(dirty_begin, false), first);
+        dirty_end = dirty_end < 0 ? new_end : std::max(map_line(dirty_end, true), new_end);
+        if (raster_begin_ >= 0)
         {
-            const char c = line_text[index];
+            raster_begin_ = map_line(raster_begin_, false);
+            raster_end_ = map_line(raster_end_, true);
+        }
 
-            if (!in_string &&
-                index + 1 < line_text.size() &&
-                c == '/' &&
-                line_text[index + 1] == '/')
+        if (!lod_levels_.empty() && !lod_all_)
+        {
+            if (delta != 0)
+                RemapLodRows(first + common, delta);
+            if (lod_begin_ >= 0)
             {
-                in_comment = true;
+                lod_begin_ = map_line(lod_begin_, false);
+                lod_end_ = map_line(lod_end_, true);
             }
+        }
+    }
 
-            if (!in_comment && (c == '"' || c == '\''))
-            {
-                in_string = !in_string;
-            }
+    if (!incremental || static_cast<int>(cached_line_summaries_.size()) != line_count)
+    {
+        cached_line_summaries_.clear();
+        cached_line_summaries_.resize(static_cast<std::size_t>(line_count));
+        run_pool_.clear();
+        dead_runs_ = 0;
+        dirty_begin = 0;
+        dirty_end = line_count;
+        raster_all_ = true;
+        lod_all_ = true;
+    }
+    else if (dirty_begin >= 0)
+    {
+        raster_begin_ = raster_begin_ < 0 ? dirty_begin : std::min(raster_begin_, dirty_begin);
+        raster_end_ = std::max(raster_end_, dirty_end);
+        lod_begin_ = lod_begin_ < 0 ? dirty_begin : std::min(lod_begin_, dirty_begin);
+        lod_end_ = std::max(lod_end_, dirty_end);
+    }
 
-            if (c == ' ' || c == '\t')
+    for (int line = std::max(dirty_begin, 0); line < std::min(dirty_end, line_count); ++line)
+    {
+        SummarizeLine(editor, line);
+        ++last_summarized_lines_;
+    }
+
+    if (dead_runs_ > 4096 && dead_runs_ * 2 > run_pool_.size())
+        CompactRunPool();
+}
+
+void TextEditorMinimap::SummarizeLine(const TextEditor& editor, int line)
+{
+    auto& summary = cached_line_summaries_[static_cast<std::size_t>(line)];
+
+    // Runs at the end of the pool are rewritten in place, so retyping one line leaves nothing dead
+    if (summary.run_count > 0 && summary.first_run + summary.run_count == run_pool_.size())
+        run_pool_.resize(summary.first_run);
+    else
+        dead_runs_ += summary.run_count;
+    summary.first_run = static_cast<std::uint32_t>(run_pool_.size());
+    summary.run_count = 0;
+
+    const int length = editor.GetLineLength(line);
+    int indent_end = 0;
+    std::size_t indent = 0;
+    for (; indent_end < length; ++indent_end)
+    {
+        const char c = editor.GetGlyphChar(line, indent_end);
+        if (c == ' ')
+            ++indent;
+        else if (c == '\t')
+            indent += 4;
+        else
+            break;
+    }
+    summary.indent_columns = static_cast<std::uint16_t>(std::min<std::size_t>(indent, std::numeric_limits<std::uint16_t>::max()));
+
+    constexpr std::size_t max_column = std::numeric_limits<std::uint16_t>::max();
+    for (int index = indent_end; index < length; ++index)
+    {
+        const char c = editor.GetGlyphChar(line, index);
+        if (c == ' ' || c == '\t')
+            continue;
+
+        const ImU32 color = editor.GetGlyphColor(line, index);
+        const std::size_t relative_column = static_cast<std::size_t>(index - indent_end);
+        if (summary.run_count > 0)
+        {
+            auto& run = run_pool_.back();
+            const std::size_t expected_column = static_cast<std::size_t>(run.start_column) + static_cast<std::size_t>(run.length);
+            if (run.color == color && relative_column == expected_column && run.length < max_column)
             {
+                ++run.length;
                 continue;
             }
+        }
 
-            LineColorKind color = LineColorKind::Default;
-            if (in_comment)
-            {
-                color = LineColorKind::Comment;
-            }
-            else if (in_string)
-            {
-                color = LineColorKind::String;
-            }
-            else if (std::isdigit(static_cast<unsigned char>(c)) != 0)
-            {
-                color = LineColorKind::Number;
-            }
-            else if (IsBracketChar(c))
-            {
-                color = LineColorKind::Bracket;
-            }
-            else if (std::isupper(static_cast<unsigned char>(c)) != 0 &&
-                     index + 1 < line_text.size() &&
-                     std::islower(static_cast<unsigned char>(line_text[index + 1])) != 0)
+        run_pool_.push_back(LineRun{
+            .start_column = static_cast<std::uint16_t>(std::min(relative_column, max_column)),
+            .length = 1,
+            .color = color,
+        });
+        ++summary.run_count;
+    }
+}
+
+void TextEditorMinimap::CompactRunPool()
+{
+    compacted_pool_.clear();
+    compacted_pool_.reserve(run_pool_.size() - dead_runs_);
+    for (auto& summary : cached_line_summaries_)
+    {
+        const auto runs = run_pool_.begin() + summary.first_run;
+        summary.first_run = static_cast<std::uint32_t>(compacted_pool_.size());
+        compacted_pool_.insert(compacted_pool_.end(), runs, runs + summary.run_count);
+    }
+    run_pool_.swap(compacted_pool_);
+    dead_runs_ = 0;
+}
+
+void TextEditorMinimap::SetTextureHost(TextureHost host)
+{
+    texture_.reset();
+    texture_host_ = std::move(host);
+    pixels_.clear();
+    row_lines_.clear();
+    stale_rows_.clear();
+    pixel_width_ = 0;
+    pixel_rows_ = 0;
+    raster_all_ = true;
+}
+
+ImTextureID TextEditorMinimap::UpdateTexture(const TextEditor& editor, int width)
+{
+    render_stats_.rasterized_rows = 0;
+    render_stats_.uploaded_rows = 0;
+    if (!texture_host_.create || !texture_host_.update)
+        return ImTextureID{};
+
+    RebuildLineSummaries(editor);
+    const int line_count = static_cast<int>(cached_line_summaries_.size());
+    const int rows = std::clamp(line_count, 1, std::max(1, config_.max_texture_rows));
+    width = std::max(1, width);
+
+    if (raster_all_ || width != pixel_width_ || rows != pixel_rows_)
+    {
+        pixel_width_ = width;
+        pixel_rows_ = rows;
+        pixels_.assign(static_cast<std::size_t>(rows) * static_cast<std::size_t>(width), 0);
+        stale_rows_.assign(static_cast<std::size_t>(rows), 0);
+        row_lines_.resize(static_cast<std::size_t>(rows) + 1);
+        for (int row = 0; row <= rows; ++row)
+            row_lines_[static_cast<std::size_t>(row)] = static_cast<int>((static_cast<std::int64_t>(row) * line_count + rows - 1) / rows);
+        RasterizeRows(0, rows);
+        MarkRowsStale(0, rows);
+    }
+    else
+    {
+        // Rows of the changed lines, together with the rows that gained or lost lines
+        const int last_line = std::min(raster_end_, line_count) - 1;
+        if (raster_begin_ >= 0 && last_line >= raster_begin_)
+        {
+            const int begin_row = GetRowOfLine(raster_begin_);
+            const int end_row = GetRowOfLine(last_line) + 1;
+            raster_row_begin_ = raster_row_begin_ < 0 ? begin_row : std::min(raster_row_begin_, begin_row);
+            raster_row_end_ = std::max(raster_row_end_, end_row);
+        }
+        if (raster_row_begin_ >= 0)
+            RasterizeRows(raster_row_begin_, std::min(raster_row_end_, pixel_rows_));
+    }
+    raster_all_ = false;
+    raster_begin_ = -1;
+    raster_end_ = -1;
+    raster_row_begin_ = -1;
+    raster_row_end_ = -1;
+
+    // Spare rows let the document grow without a new texture; only the used rows are sampled
+    if (!texture_ || texture_->width != pixel_width_ || texture_->height < pixel_rows_ ||
+        texture_->height > 4 * pixel_rows_ + 256)
+    {
+        const int height = std::min(std::max(1, config_.max_texture_rows), pixel_rows_ + pixel_rows_ / 4 + 64);
+        texture_.reset();
+        texture_ = std::make_unique<Texture>();
+        texture_->id = texture_host_.create(pixel_width_, height);
+        texture_->width = pixel_width_;
+        texture_->height = height;
+        texture_->destroy = texture_host_.destroy;
+        MarkRowsStale(0, pixel_rows_);
+    }
+
+    // One update per run of stale rows
+    const int upload_end = std::min(upload_end_, pixel_rows_);
+    for (int row = std::max(upload_begin_, 0); row < upload_end;)
+    {
+        if (!stale_rows_[static_cast<std::size_t>(row)])
+        {
+            ++row;
+            continue;
+        }
+        int run_end = row;
+        while (run_end < upload_end && stale_rows_[static_cast<std::size_t>(run_end)])
+            stale_rows_[static_cast<std::size_t>(run_end++)] = 0;
+        texture_host_.update(texture_->id,
+                             pixels_.data() + static_cast<std::size_t>(row) * static_cast<std::size_t>(pixel_width_),
+                             pixel_width_, row, run_end - row);
+        render_stats_.uploaded_rows += run_end - row;
+        row = run_end;
+    }
+    upload_begin_ = -1;
+    upload_end_ = -1;
+    return texture_->id;
+}
+
+void TextEditorMinimap::MarkRowsStale(int begin_row, int end_row)
+{
+    if (begin_row >= end_row)
+        return;
+    std::fill(stale_rows_.begin() + begin_row, stale_rows_.begin() + end_row, std::uint8_t{1});
+    upload_begin_ = upload_begin_ < 0 ? begin_row : std::min(upload_begin_, begin_row);
+    upload_end_ = std::max(upload_end_, end_row);
+}
+
+void TextEditorMinimap::ShiftPixelRows(int row, int delta)
+{
+    // The texture keeps the old rows, so a moved row is stale unless it matches the row it lands on
+    const int old_rows = pixel_rows_;
+    const int new_rows = old_rows + delta;
+    const auto width = static_cast<std::size_t>(pixel_width_);
+    stale_rows_.resize(static_cast<std::size_t>(std::max(old_rows, new_rows)), 1);
+    for (int target = row; target < new_rows; ++target)
+    {
+        auto& stale = stale_rows_[static_cast<std::size_t>(target)];
+        const int source = target - delta;
+        if (stale || target >= old_rows || source < row)
+        {
+            stale = 1;
+            continue;
+        }
+        const ImU32* moved = pixels_.data() + static_cast<std::size_t>(source) * width;
+        stale = !std::equal(moved, moved + width, pixels_.data() + static_cast<std::size_t>(target) * width);
+    }
+    stale_rows_.resize(static_cast<std::size_t>(new_rows));
+
+    const auto at = pixels_.begin() + static_cast<std::ptrdiff_t>(row) * pixel_width_;
+    if (delta < 0)
+        pixels_.erase(at, at + static_cast<std::ptrdiff_t>(-delta) * pixel_width_);
+    else
+        pixels_.insert(at, static_cast<std::size_t>(delta) * width, 0);
+    pixel_rows_ = new_rows;
+    row_lines_.resize(static_cast<std::size_t>(new_rows) + 1);
+    for (int r = row; r <= new_rows; ++r)
+        row_lines_[static_cast<std::size_t>(r)] = r;
+    if (raster_row_begin_ >= 0)
+    {
+        raster_row_begin_ = raster_row_begin_ <= row ? raster_row_begin_ : std::max(row, raster_row_begin_ + delta);
+        raster_row_end_ = raster_row_end_ <= row ? raster_row_end_ : std::max(row, raster_row_end_ + delta);
+    }
+    upload_begin_ = upload_begin_ < 0 ? row : std::min(upload_begin_, row);
+    upload_end_ = std::max(upload_end_, new_rows);
+}
+
+void TextEditorMinimap::RemapPixelRows(int line, int delta)
+{
+    // Rows may hold up to twice their share of lines before they are evened out
+    const int rows = pixel_rows_;
+    const int share = (row_lines_.back() + delta + rows - 1) / std::max(1, rows);
+    int first_row = 0;
+    int end_row = 0;
+    if (!MoveRowLines(row_lines_, line, delta, 2 * share, first_row, end_row))
+    {
+        // Back to one line per row
+        raster_all_ = true;
+        return;
+    }
+    raster_row_begin_ = raster_row_begin_ < 0 ? first_row : std::min(raster_row_begin_, first_row);
+    raster_row_end_ = std::max(raster_row_end_, end_row);
+}
+
+void TextEditorMinimap::RemapLodRows(int line, int delta)
+{
+    int first_row = 0;
+    int end_row = 0;
+    if (!MoveRowLines(lod_row_lines_, line, delta, 2 << kLodBaseShift, first_row, end_row))
+    {
+        lod_all_ = true;
+        return;
+    }
+    lod_row_begin_ = lod_row_begin_ < 0 ? first_row : std::min(lod_row_begin_, first_row);
+    lod_row_end_ = std::max(lod_row_end_, end_row);
+}
+
+void TextEditorMinimap::RasterizeRows(int begin_row, int end_row)
+{
+    row_pixels_.resize(static_cast<std::size_t>(pixel_width_));
+    ImU32* pixels = row_pixels_.data();
+    for (int row = begin_row; row < end_row; ++row)
+    {
+        std::fill(pixels, pixels + pixel_width_, 0);
+
+        // Lines whose row is this one; later lines draw over earlier ones
+        const int first_line = row_lines_[static_cast<std::size_t>(row)];
+        const int end_line = row_lines_[static_cast<std::size_t>(row) + 1];
+        for (int line = first_line; line < end_line; ++line)
+        {
+            const auto& summary = cached_line_summaries_[static_cast<std::size_t>(line)];
+            const int base_x = static_cast<int>(static_cast<float>(summary.indent_columns) * 0.8f);
+            const LineRun* runs = run_pool_.data() + summary.first_run;
+            for (std::uint32_t r = 0; r < summary.run_count; ++r)
             {
-                color = LineColorKind::Type;
+                const int run_x = base_x + runs[r].start_column;
+                if (run_x >= pixel_width_)
+                    break;
+                std::fill(pixels + run_x, pixels + std::min(run_x + static_cast<int>(runs[r].length), pixel_width_), runs[r].color);
             }
+        }
 
-            const std::size_t relative_column = index - indent;
-            if (!summary.runs.empty())
+        // A row that looks the same as before needs no upload
+        ImU32* target = pixels_.data() + static_cast<std::size_t>(row) * static_cast<std::size_t>(pixel_width_);
+        if (!std::equal(pixels, pixels + pixel_width_, target))
+        {
+            std::copy(pixels, pixels + pixel_width_, target);
+            MarkRowsStale(row, row + 1);
+        }
+    }
+    render_stats_.rasterized_rows += std::max(0, end_row - begin_row);
+}
+
+void TextEditorMinimap::UpdateLod(const TextEditor& editor)
+{
+    render_stats_.lod_rows = 0;
+    RebuildLineSummaries(editor);
+    const int line_count = static_cast<int>(cached_line_summaries_.size());
+
+    // Rows [row_begin, row_end) of each level are computed again, level 0 from the lines
+    int rows = 0;
+    int row_begin = 0;
+    int row_end = 0;
+    if (lod_all_ || lod_levels_.empty())
+    {
+        // Level 0 starts out with 1 << kLodBaseShift lines per row
+        rows = std::max(1, (line_count + (1 << kLodBaseShift) - 1) >> kLodBaseShift);
+        lod_row_lines_.resize(static_cast<std::size_t>(rows) + 1);
+        for (int row = 0; row <= rows; ++row)
+            lod_row_lines_[static_cast<std::size_t>(row)] = std::min(row << kLodBaseShift, line_count);
+        row_end = rows;
+    }
+    else
+    {
+        rows = static_cast<int>(lod_row_lines_.size()) - 1;
+        row_begin = lod_row_begin_;
+        row_end = lod_row_end_;
+        const int end = std::min(lod_end_, line_count);
+        if (lod_begin_ >= 0 && end > lod_begin_)
+        {
+            auto row_of = [this, rows](int line) {
+                const auto it = std::upper_bound(lod_row_lines_.begin(), lod_row_lines_.begin() + rows, line);
+                return std::max(0, static_cast<int>(it - lod_row_lines_.begin()) - 1);
+            };
+            row_begin = row_begin < 0 ? row_of(lod_begin_) : std::min(row_begin, row_of(lod_begin_));
+            row_end = std::max(row_end, row_of(end - 1) + 1);
+        }
+        if (row_begin < 0)
+        {
+            lod_begin_ = -1;
+            lod_end_ = -1;
+            return;
+        }
+    }
+    lod_all_ = false;
+    lod_begin_ = -1;
+    lod_end_ = -1;
+    lod_row_begin_ = -1;
+    lod_row_end_ = -1;
+
+    if (lod_levels_.empty())
+        lod_levels_.emplace_back();
+    lod_levels_[0].resize(static_cast<std::size_t>(rows) * kLodCells);
+    for (int row = row_begin; row < row_end; ++row)
+        BuildLodRow(row, lod_levels_[0].data() + static_cast<std::size_t>(row) * kLodCells);
+    render_stats_.lod_rows += row_end - row_begin;
+
+    std::size_t level = 1;
+    for (; rows > 1; ++level)
+    {
+        const int child_rows = rows;
+        rows = (rows + 1) / 2;
+        row_begin >>= 1;
+        row_end = ((row_end - 1) >> 1) + 1;
+        if (lod_levels_.size() <= level)
+            lod_levels_.emplace_back();
+        const auto& children = lod_levels_[level - 1];
+        auto& cells = lod_levels_[level];
+        cells.resize(static_cast<std::size_t>(rows) * kLodCells);
+        for (int row = row_begin; row < row_end; ++row)
+        {
+            const LodCell* first = children.data() + static_cast<std::size_t>(2 * row) * kLodCells;
+            const LodCell* second = 2 * row + 1 < child_rows ? first + kLodCells : nullptr;
+            LodCell* merged = cells.data() + static_cast<std::size_t>(row) * kLodCells;
+            for (int cell = 0; cell < kLodCells; ++cell)
             {
-                auto& run = summary.runs.back();
-                const std::size_t expected_column = static_cast<std::size_t>(run.start_column) + static_cast<std::size_t>(run.length);
-                if (run.color == color &&
-                    relative_column == expected_column &&
-                    run.length < std::numeric_limits<std::uint16_t>::max())
+                if (second == nullptr || second[cell].coverage == 0)
+                {
+                    merged[cell] = first[cell];
+                    continue;
+                }
+                if (first[cell].coverage == 0)
                 {
-                    ++run.length;
+                    merged[cell] = second[cell];
                     continue;
                 }
+                const std::uint64_t weight_a = first[cell].coverage;
+                const std::uint64_t weight_b = second[cell].coverage;
+                ImU32 color = 0;
+                for (int shift = 0; shift < 32; shift += 8)
+                {
+                    const std::uint64_t a = (first[cell].color >> shift) & 0xFF;
+                    const std::uint64_t b = (second[cell].color >> shift) & 0xFF;
+                    color |= static_cast<ImU32>((a * weight_a + b * weight_b) / (weight_a + weight_b)) << shift;
+                }
+                merged[cell].coverage = first[cell].coverage + second[cell].coverage;
+                merged[cell].color = color;
             }
+        }
+        render_stats_.lod_rows += row_end - row_begin;
+    }
+    lod_levels_.resize(level);
+}
+
+void TextEditorMinimap::BuildLodRow(int row, LodCell* cells) const
+{
+    constexpr int max_x = kLodCells * kLodCellColumns;
+    std::uint32_t coverage[kLodCells] = {};
+    std::uint32_t channels[kLodCells][4] = {};
 
-            summary.runs.push_back(LineRun{
-                .start_column = static_cast<std::uint16_t>(std::min<std::size_t>(relative_column, std::numeric_limits<std::uint16_t>::max())),
-                .length = 1,
-                .color = color,
-            });
+    const int end_line = lod_row_lines_[static_cast<std::size_t>(row) + 1];
+    for (int line = lod_row_lines_[static_cast<std::size_t>(row)]; line < end_line; ++line)
+    {
+        const auto& summary = cached_line_summaries_[static_cast<std::size_t>(line)];
+        const int base_x = static_cast<int>(static_cast<float>(summary.indent_columns) * 0.8f);
+        const LineRun* runs = run_pool_.data() + summary.first_run;
+        for (std::uint32_t r = 0; r < summary.run_count; ++r)
+        {
+            const int run_begin = base_x + runs[r].start_column;
+            const int run_end = std::min(run_begin + static_cast<int>(runs[r].length), max_x);
+            if (run_begin >= max_x)
+                break;
+            for (int cell = run_begin / kLodCellColumns; cell * kLodCellColumns < run_end; ++cell)
+            {
+                const auto covered = static_cast<std::uint32_t>(
+                    std::min(run_end, (cell + 1) * kLodCellColumns) - std::max(run_begin, cell * kLodCellColumns));
+                coverage[cell] += covered;
+                for (int channel = 0; channel < 4; ++channel)
+                    channels[cell][channel] += covered * ((runs[r].color >> (channel * 8)) & 0xFF);
+            }
         }
     }
+
+    for (int cell = 0; cell < kLodCells; ++cell)
+    {
+        cells[cell].coverage = coverage[cell];
+        cells[cell].color = 0;
+        if (coverage[cell] == 0)
+            continue;
+        for (int channel = 0; channel < 4; ++channel)
+            cells[cell].color |= (channels[cell][channel] / coverage[cell]) << (channel * 8);
+    }
+}
+
+int TextEditorMinimap::GetRowOfLine(int line) const
+{
+    // The last row starting at or before the line; rows left empty start where the next one does
+    const auto it = std::upper_bound(row_lines_.begin(), row_lines_.begin() + pixel_rows_, line);
+    return std::max(0, static_cast<int>(it - row_lines_.begin()) - 1);
 }
 
 int TextEditorMinimap::HandleInput([[maybe_unused]] TextEditor& editor,
@@ -8,7 +8,9 @@
 #include <cctype>
 #include <cmath>
 #include <cstdint>
+#include <functional>
 #include <limits>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -33,8 +35,44 @@ public:
         bool show_hover_preview = true;
         ImU32 viewport_color = vscode::colors::to_u32(vscode::colors::minimap_viewport);
         ImU32 hover_color = vscode::colors::to_u32(vscode::colors::minimap_hover);
+        int max_texture_rows = 4096;  // Longer documents share texture rows between lines
     };
 
+    /**
+     * @brief Texture callbacks of the host's renderer backend
+     *
+     * With create and update set, the minimap is rasterized into a pixel buffer with one
+     * row per document line and drawn as a single image; edits rasterize only the rows of
+     * the lines they changed, and only rows whose pixels changed are uploaded. Textures get
+     * spare rows so that new lines fit; update hands over rows [first_row, first_row + row_count)
+     * as IM_COL32 values, one row after the other, and may be called several times per frame.
+     */
+    struct TextureHost
+    {
+        std::function<ImTextureID(int width, int height)> create;
+        std::function<void(ImTextureID texture, const ImU32* pixels, int width, int first_row, int row_count)> update;
+        std::function<void(ImTextureID texture)> destroy;
+    };
+
+    struct RenderStats
+    {
+        int quads = 0;            // Rectangles and images added to the draw list
+        int rasterized_rows = 0;  // Texture rows drawn into the pixel buffer
+        int uploaded_rows = 0;    // Texture rows handed to TextureHost::update
+        int lod_rows = 0;         // Level-of-detail rows computed again
+    };
+
+    // Lines sharing a level-of-detail row, summarized per cell of kLodCellColumns columns
+    struct LodCell
+    {
+        std::uint32_t coverage = 0;  // Glyph columns covered, summed over the lines
+        ImU32 color = 0;             // Average color, weighted by coverage
+    };
+
+    static constexpr int kLodCells = 16;
+    static constexpr int kLodCellColumns = 8;
+    static constexpr int kLodBaseShift = 2;  // Rows of level 0 start out with 1 << kLodBaseShift lines
+
     TextEditorMinimap() : config_() {}
     explicit TextEditorMinimap(Config config) : config_(std::move(config)) {}
     ~TextEditorMinimap() = default;
@@ -77,45 +115,208 @@ public:
     void SetOpacity(float opacity) { config_.opacity_foreground = opacity; }
     [[nodiscard]] float GetOpacity() const { return config_.opacity_foreground; }
 
+    /**
+     * @brief Draw the minimap through host textures instead of one rectangle per run
+     * @param host Texture callbacks; an empty host goes back to drawing rectangles
+     */
+    void SetTextureHost(TextureHost host);
+
+    /**
+     * @brief Bring the minimap texture up to date with the editor
+     * @param editor The text editor to draw
+     * @param width Texture width in pixels, one pixel per column
+     * @return The texture, or a null texture without a texture host
+     */
+    ImTextureID UpdateTexture(const TextEditor& editor, int width);
+
+    /**
+     * @brief Bring the level-of-detail pyramid up to date with the editor
+     *
+     * Rows of level 0 summarize about 1 << kLodBaseShift lines each and row j of level k
+     * merges rows 2j and 2j + 1 of level k - 1, up to a single row. Render draws the
+     * coarsest level that still has a row per pixel when the document is taller than the
+     * panel. Inserted or removed lines join or leave the level 0 row of the edit, so edits
+     * compute again only the rows holding their lines on every level; a row left empty or
+     * with more than 2 << kLodBaseShift lines is evened out with its neighbours.
+     * @param editor The text editor to summarize
+     */
+    void UpdateLod(const TextEditor& editor);
+
+    [[nodiscard]] int GetLodLevelCount() const { return static_cast<int>(lod_levels_.size()); }
+
+    /**
+     * @brief Cells of a level, kLodCells per row
+     */
+    [[nodiscard]] const std::vector<LodCell>& GetLodLevel(int level) const { return lod_levels_[static_cast<std::size_t>(level)]; }
+
+    /**
+     * @brief First line of each level 0 row, then the line count
+     */
+    [[nodiscard]] const std::vector<int>& GetLodRowLines() const { return lod_row_lines_; }
+
+    [[nodiscard]] const std::vector<ImU32>& GetPixels() const { return pixels_; }
+    [[nodiscard]] int GetPixelWidth() const { return pixel_width_; }
+    [[nodiscard]] int GetPixelRows() const { return pixel_rows_; }
+
+    /**
+     * @brief Lines of each texture row; row r shows lines [rows[r], rows[r + 1])
+     *
+     * Rows show one line each up to Config::max_texture_rows lines. Past that, lines share
+     * rows: inserted and removed lines grow or shrink the row they are in, and the rows
+     * around it are evened out again when it holds more than twice its share or none.
+     */
+    [[nodiscard]] const std::vector<int>& GetRowLines() const { return row_lines_; }
+
+    /**
+     * @brief Draw list and texture work of the last Render or UpdateTexture
+     */
+    [[nodiscard]] const RenderStats& GetLastRenderStats() const { return render_stats_; }
+
     // Get the line that was clicked/dragged to (returns -1 if none)
     [[nodiscard]] int GetClickedLine() const { return clicked_line_; }
     void ResetClickedLine() { clicked_line_ = -1; }
 
-    enum class LineColorKind : std::uint8_t
-    {
-        Default,
-        String,
-        Comment,
-        Number,
-        Bracket,
-        Type
-    };
-
+    // Glyphs of one color without whitespace in between, colored as the editor draws them
     struct LineRun
     {
         std::uint16_t start_column = 0;
         std::uint16_t length = 0;
-        LineColorKind color = LineColorKind::Default;
+        ImU32 color = 0;
     };
 
     struct LineSummary
     {
         std::uint16_t indent_columns = 0;
-        std::vector<LineRun> runs;
+        std::uint32_t first_run = 0;  // Offset of the line's runs in the run pool
+        std::uint32_t run_count = 0;
     };
 
+    /**
+     * @brief Bring the line summaries up to date with the editor and return them
+     *
+     * Only the lines the editor's color journal reports since the last update are
+     * summarized again; the others move with the inserted and removed lines.
+     * @param editor The text editor to summarize
+     */
+    [[nodiscard]] const std::vector<LineSummary>& GetLineSummaries(const TextEditor& editor)
+    {
+        RebuildLineSummaries(editor);
+        return cached_line_summaries_;
+    }
+
+    /**
+     * @brief Runs of all lines; a summary's runs are [first_run, first_run + run_count)
+     */
+    [[nodiscard]] const std::vector<LineRun>& GetRunPool() const { return run_pool_; }
+
+    /**
+     * @brief Number of lines summarized by the last update
+     */
+    [[nodiscard]] int GetLastSummarizedLineCount() const { return last_summarized_lines_; }
+
 private:
     Config config_;
     int hovered_line_ = -1;
     int clicked_line_ = -1;
     bool is_dragging_ = false;
-    int cached_undo_index_ = -1;
-    int cached_line_count_ = -1;
     float hover_anim_ = 0.0f;
     std::vector<LineSummary> cached_line_summaries_;
 
+    // Runs of all lines in one pool; resummarized lines append theirs and leave the old ones dead
+    std::vector<LineRun> run_pool_;
+    std::vector<LineRun> compacted_pool_;
+    std::size_t dead_runs_ = 0;
+
+    // Change tracking: summaries are current for this editor at this color version
+    const TextEditor* cached_editor_ = nullptr;
+    std::uint64_t cached_color_version_ = 0;
+    std::vector<TextEditor::LineChange> changes_;
+    int last_summarized_lines_ = 0;
+
+    // Texture path: pixel rows follow the lines one to one unless capped by max_texture_rows
+    struct Texture
+    {
+        ImTextureID id{};
+        int width = 0;
+        int height = 0;
+        std::function<void(ImTextureID)> destroy;
+
+        ~Texture()
+        {
+            if (destroy)
+                destroy(id);
+        }
+    };
+    TextureHost texture_host_;
+    std::unique_ptr<Texture> texture_;
+    std::vector<ImU32> pixels_;
+    std::vector<ImU32> row_pixels_;      // One row being rasterized
+    std::vector<int> row_lines_;         // First line of each row, then the line count
+    std::vector<std::uint8_t> stale_rows_;  // Rows whose pixels differ from the texture
+    int pixel_width_ = 0;
+    int pixel_rows_ = 0;
+    bool raster_all_ = true;
+    int raster_begin_ = -1;  // Lines to rasterize again, -1 if none
+    int raster_end_ = -1;
+    int raster_row_begin_ = -1;  // Rows whose lines changed, -1 if none
+    int raster_row_end_ = -1;
+    int upload_begin_ = -1;  // Range holding the stale rows, -1 if none
+    int upload_end_ = -1;
+    RenderStats render_stats_;
+
+    // Level-of-detail pyramid, finest level first
+    std::vector<std::vector<LodCell>> lod_levels_;
+    bool lod_all_ = true;
+    int lod_begin_ = -1;  // Lines to summarize again, -1 if none
+    int lod_end_ = -1;
+    std::vector<int> lod_row_lines_;  // First line of each level 0 row, then the line count
+    int lod_row_begin_ = -1;  // Level 0 rows whose lines changed, -1 if none
+    int lod_row_end_ = -1;
+
     void RebuildLineSummaries(const TextEditor& editor);
 
+    /**
+     * @brief Summarize the indentation and colored runs of one line into its summary
+     */
+    void SummarizeLine(const TextEditor& editor, int line);
+
+    /**
+     * @brief Move the live runs to the front of the pool, in line order
+     */
+    void CompactRunPool();
+
+    /**
+     * @brief Insert (delta > 0) or remove (delta < 0) pixel rows at row, as lines were
+     */
+    void ShiftPixelRows(int row, int delta);
+
+    /**
+     * @brief Move the lines of shared rows after lines were inserted (delta > 0) or removed at line
+     */
+    void RemapPixelRows(int line, int delta);
+
+    /**
+     * @brief Move the lines of level 0 rows after lines were inserted (delta > 0) or removed at line
+     */
+    void RemapLodRows(int line, int delta);
+
+    /**
+     * @brief Draw the runs of the lines of rows [begin_row, end_row) into the pixel buffer
+     */
+    void RasterizeRows(int begin_row, int end_row);
+
+    void MarkRowsStale(int begin_row, int end_row);
+
+    /**
+     * @brief Summarize the lines of a level 0 row into its cells
+     */
+    void BuildLodRow(int row, LodCell* cells) const;
+
+    /**
+     * @brief Texture row showing a line
+     */
+    [[nodiscard]] int GetRowOfLine(int line) const;
+
     /**
      * @brief Render a single line in the minimap
      * @param draw_list ImGui draw list
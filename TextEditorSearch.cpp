@@ -0,0 +1,751 @@
+#include "TextEditorSearch.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iterator>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+
+[[nodiscard]] constexpr char FoldCase(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+[[nodiscard]] constexpr std::uint32_t TrigramKey(const char* p)
+{
+    return (static_cast<std::uint32_t>(static_cast<unsigned char>(FoldCase(p[0]))) << 16) |
+           (static_cast<std::uint32_t>(static_cast<unsigned char>(FoldCase(p[1]))) << 8) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(FoldCase(p[2])));
+}
+
+[[nodiscard]] int CountLineBreaks(std::string_view text)
+{
+    return static_cast<int>(std::count(text.begin(), text.end(), '\n'));
+}
+
+[[nodiscard]] bool MatchLess(const TextEditorSearchSession::Match& a,
+                             const TextEditorSearchSession::Match& b)
+{
+    return a.line != b.line ? a.line < b.line : a.char_index < b.char_index;
+}
+
+/**
+ * @brief Collect literal runs that every match of a pattern has to contain
+ * @return false if the pattern has a top-level alternation
+ */
+bool ExtractRequiredLiterals(std::string_view pattern, std::vector<std::string>& out_runs)
+{
+    struct Group
+    {
+        std::size_t first_run = 0;
+        bool optional = false;
+    };
+    std::vector<Group> groups;
+    std::string current;
+    const auto flush = [&]() {
+        if (current.size() >= 3)
+            out_runs.push_back(current);
+        current.clear();
+    };
+    const auto drop_last_atom = [&]() {
+        // The atom is a whole code point, continuation bytes and all
+        while (!current.empty() && (static_cast<unsigned char>(current.back()) & 0xC0) == 0x80)
+            current.pop_back();
+        if (!current.empty())
+            current.pop_back();
+        flush();
+    };
+
+    for (std::size_t i = 0; i < pattern.size(); ++i)
+    {
+        const char c = pattern[i];
+        switch (c)
+        {
+        case '\\':
+            if (i + 1 < pattern.size())
+            {
+                const char escaped = pattern[++i];
+                // \d, \w, \b, \n, \x41... are classes or special characters, not literals
+                if (std::isalnum(static_cast<unsigned char>(escaped)))
+                    flush();
+                else
+                    current += escaped;
+            }
+            break;
+        case '.':
+        case '^':
+        case '$':
+        case '+':
+            flush();
+            break;
+        case '?':
+        case '*':
+            drop_last_atom();
+            break;
+        case '{':
+        {
+            const std::size_t close = pattern.find('}', i);
+            if (close == std::string_view::npos)
+            {
+                current += c;
+                break;
+            }
+            if (pattern[i + 1] == '0' || pattern[i + 1] == ',')
+                drop_last_atom();
+            else
+                flush();
+            i = close;
+            break;
+        }
+        case '[':
+            flush();
+            ++i;
+            if (i < pattern.size() && pattern[i] == '^')
+                ++i;
+            // A ']' first in the class is a member, not its end
+            if (i < pattern.size() && pattern[i] == ']')
+                ++i;
+            for (; i < pattern.size() && pattern[i] != ']'; ++i)
+            {
+                if (pattern[i] == '\\')
+                    ++i;
+            }
+            break;
+        case '(':
+            flush();
+            // Lookarounds and other extensions don't consume what they mention
+            groups.push_back({out_runs.size(), i + 1 < pattern.size() && pattern[i + 1] == '?'});
+            break;
+        case ')':
+        {
+            flush();
+            if (groups.empty())
+                break;
+            const Group group = groups.back();
+            groups.pop_back();
+            const char next = i + 1 < pattern.size() ? pattern[i + 1] : '\0';
+            const bool repeated_optionally =
+                next == '?' || next == '*' ||
+                (next == '{' && i + 2 < pattern.size() && (pattern[i + 2] == '0' || pattern[i + 2] == ','));
+            if (group.optional || repeated_optionally)
+                out_runs.resize(group.first_run);
+            break;
+        }
+        case '|':
+            if (groups.empty())
+                return false;
+            // Nothing inside an alternating group is required
+            flush();
+            groups.back().optional = true;
+            break;
+        default:
+            current += c;
+            break;
+        }
+    }
+    flush();
+    return true;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// TextEditorTrigramIndex
+// ---------------------------------------------------------------------------
+
+struct TextEditorTrigramIndex::BuildJob
+{
+    std::string text;                       // Snapshot of all lines, concatenated
+    std::vector<std::uint32_t> line_starts; // line_count + 1 offsets into text
+    std::uint64_t version = 0;
+    std::chrono::steady_clock::time_point started;
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> finished{false};
+    IndexData result;
+    std::thread thread;
+
+    BuildJob() = default;
+    BuildJob(const BuildJob&) = delete;
+    BuildJob& operator=(const BuildJob&) = delete;
+    BuildJob(BuildJob&&) = delete;
+    BuildJob& operator=(BuildJob&&) = delete;
+
+    ~BuildJob()
+    {
+        cancelled.store(true, std::memory_order_relaxed);
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+TextEditorTrigramIndex::TextEditorTrigramIndex() : config_() {}
+TextEditorTrigramIndex::TextEditorTrigramIndex(Config config) : config_(config) {}
+TextEditorTrigramIndex::~TextEditorTrigramIndex() = default;
+TextEditorTrigramIndex::TextEditorTrigramIndex(TextEditorTrigramIndex&&) noexcept = default;
+TextEditorTrigramIndex& TextEditorTrigramIndex::operator=(TextEditorTrigramIndex&&) noexcept = default;
+
+void TextEditorTrigramIndex::Update(const TextEditor& editor)
+{
+    if ((config_.require_read_only && !editor.IsReadOnlyEnabled()) || editor_ != &editor)
+    {
+        Clear();
+        if (config_.require_read_only && !editor.IsReadOnlyEnabled())
+            return;
+        editor_ = &editor;
+    }
+
+    const std::uint64_t version = editor.GetDocumentVersion();
+    if (job_ && job_->finished.load(std::memory_order_acquire))
+        WaitForBuild();
+    if (data_ && data_->version == version)
+        return;
+    if (job_ && job_->version == version)
+        return;
+
+    // The text changed: whatever exists or is being built is stale
+    job_.reset();
+    data_.reset();
+
+    auto job = std::make_unique<BuildJob>();
+    job->started = std::chrono::steady_clock::now();
+    job->version = version;
+    const int line_count = editor.GetLineCount();
+    job->line_starts.reserve(static_cast<std::size_t>(line_count) + 1U);
+    std::string line_text;
+    for (int line = 0; line < line_count; ++line)
+    {
+        job->line_starts.push_back(static_cast<std::uint32_t>(job->text.size()));
+        editor.GetLineText(line, line_text);
+        job->text += line_text;
+    }
+    job->line_starts.push_back(static_cast<std::uint32_t>(job->text.size()));
+
+    BuildJob* raw = job.get();
+    job->thread = std::thread([raw]() {
+        Build(raw->text, raw->line_starts, raw->cancelled, raw->result);
+        raw->result.version = raw->version;
+        raw->result.build_milliseconds = std::chrono::duration<double, std::milli>(
+                                             std::chrono::steady_clock::now() - raw->started)
+                                             .count();
+        raw->finished.store(true, std::memory_order_release);
+    });
+    job_ = std::move(job);
+}
+
+void TextEditorTrigramIndex::WaitForBuild()
+{
+    if (!job_)
+        return;
+    job_->thread.join();
+    data_ = std::make_unique<IndexData>(std::move(job_->result));
+    job_.reset();
+}
+
+void TextEditorTrigramIndex::Clear()
+{
+    job_.reset();
+    data_.reset();
+    editor_ = nullptr;
+}
+
+bool TextEditorTrigramIndex::IsReadyFor(const TextEditor& editor) const
+{
+    return data_ && editor_ == &editor && data_->version == editor.GetDocumentVersion();
+}
+
+bool TextEditorTrigramIndex::QueryLiteral(std::string_view text, std::vector<int>& out_lines) const
+{
+    if (!data_)
+        return false;
+
+    std::vector<std::pair<std::string_view, int>> runs;
+    int line_offset = 0;
+    for (std::size_t begin = 0;; ++line_offset)
+    {
+        const std::size_t end = text.find('\n', begin);
+        const std::string_view segment = text.substr(begin, end - begin);
+        if (segment.size() >= 3)
+            runs.emplace_back(segment, line_offset);
+        if (end == std::string_view::npos)
+            break;
+        begin = end + 1;
+    }
+    return Intersect(runs, out_lines);
+}
+
+bool TextEditorTrigramIndex::QueryRegex(std::string_view pattern, std::vector<int>& out_lines) const
+{
+    if (!data_)
+        return false;
+
+    std::vector<std::string> literals;
+    if (!ExtractRequiredLiterals(pattern, literals))
+        return false;
+
+    std::vector<std::pair<std::string_view, int>> runs;
+    runs.reserve(literals.size());
+    for (const auto& literal : literals)
+        runs.emplace_back(literal, 0);
+    return Intersect(runs, out_lines);
+}
+
+TextEditorTrigramIndex::Stats TextEditorTrigramIndex::GetStats() const
+{
+    Stats stats;
+    stats.building = job_ != nullptr;
+    if (!data_)
+        return stats;
+
+    stats.memory_bytes = sizeof(IndexData) +
+                         (data_->keys.capacity() + data_->offsets.capacity() + data_->postings.capacity()) *
+                             sizeof(std::uint32_t);
+    stats.trigram_count = data_->keys.size();
+    stats.posting_count = data_->postings.size();
+    stats.line_count = data_->line_count;
+    stats.build_milliseconds = data_->build_milliseconds;
+    return stats;
+}
+
+void TextEditorTrigramIndex::Build(const std::string& text, const std::vector<std::uint32_t>& line_starts,
+                                   const std::atomic<bool>& cancelled, IndexData& out)
+{
+    const int line_count = static_cast<int>(line_starts.size()) - 1;
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> lists;
+
+    for (int line = 0; line < line_count; ++line)
+    {
+        if ((line & 1023) == 0 && cancelled.load(std::memory_order_relaxed))
+            return;
+
+        const std::uint32_t begin = line_starts[line];
+        const std::uint32_t end = line_starts[line + 1];
+        for (std::uint32_t i = begin; i + 3 <= end; ++i)
+        {
+            auto& list = lists[TrigramKey(text.data() + i)];
+            if (list.empty() || list.back() != static_cast<std::uint32_t>(line))
+                list.push_back(static_cast<std::uint32_t>(line));
+        }
+    }
+
+    // Flatten into sorted keys with one shared posting array
+    out.keys.reserve(lists.size());
+    std::size_t total = 0;
+    for (const auto& [key, list] : lists)
+    {
+        out.keys.push_back(key);
+        total += list.size();
+    }
+    std::sort(out.keys.begin(), out.keys.end());
+
+    out.offsets.reserve(out.keys.size() + 1U);
+    out.postings.reserve(total);
+    for (const std::uint32_t key : out.keys)
+    {
+        out.offsets.push_back(static_cast<std::uint32_t>(out.postings.size()));
+        const auto& list = lists[key];
+        out.postings.insert(out.postings.end(), list.begin(), list.end());
+    }
+    out.offsets.push_back(static_cast<std::uint32_t>(out.postings.size()));
+    out.line_count = line_count;
+}
+
+std::pair<const std::uint32_t*, const std::uint32_t*> TextEditorTrigramIndex::Postings(std::uint32_t key) const
+{
+    const auto it = std::lower_bound(data_->keys.begin(), data_->keys.end(), key);
+    if (it == data_->keys.end() || *it != key)
+        return {nullptr, nullptr};
+    const auto index = static_cast<std::size_t>(it - data_->keys.begin());
+    const std::uint32_t* postings = data_->postings.data();
+    return {postings + data_->offsets[index], postings + data_->offsets[index + 1]};
+}
+
+bool TextEditorTrigramIndex::Intersect(const std::vector<std::pair<std::string_view, int>>& runs,
+                                       std::vector<int>& out_lines) const
+{
+    struct List
+    {
+        const std::uint32_t* begin;
+        const std::uint32_t* end;
+        int offset;
+    };
+    std::vector<List> lists;
+    for (const auto& [run, offset] : runs)
+    {
+        for (std::size_t i = 0; i + 3 <= run.size(); ++i)
+        {
+            const auto [begin, end] = Postings(TrigramKey(run.data() + i));
+            if (begin == end)
+            {
+                out_lines.clear();
+                return true;  // Some trigram never occurs, nothing can match
+            }
+            lists.push_back({begin, end, offset});
+        }
+    }
+    if (lists.empty())
+        return false;
+
+    // Start from the rarest trigram and keep only lines every other list agrees on
+    std::sort(lists.begin(), lists.end(), [](const List& a, const List& b) {
+        return (a.end - a.begin) < (b.end - b.begin);
+    });
+    out_lines.clear();
+    for (const std::uint32_t* p = lists.front().begin; p != lists.front().end; ++p)
+    {
+        const int line = static_cast<int>(*p) - lists.front().offset;
+        if (line >= 0)
+            out_lines.push_back(line);
+    }
+    for (std::size_t l = 1; l < lists.size() && !out_lines.empty(); ++l)
+    {
+        const List& list = lists[l];
+        std::size_t kept = 0;
+        const std::uint32_t* p = list.begin;
+        for (const int line : out_lines)
+        {
+            const auto wanted = static_cast<std::uint32_t>(line + list.offset);
+            p = std::lower_bound(p, list.end, wanted);
+            if (p == list.end)
+                break;
+            if (*p == wanted)
+                out_lines[kept++] = line;
+        }
+        out_lines.resize(kept);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// TextEditorSearchSession
+// ---------------------------------------------------------------------------
+
+std::size_t TextEditorSearchSession::Update(const TextEditor& editor, std::string_view query,
+                                            bool case_sensitive)
+{
+    return Sync(editor, query, case_sensitive, false);
+}
+
+std::size_t TextEditorSearchSession::UpdateRegex(const TextEditor& editor, std::string_view pattern,
+                                                 bool case_sensitive)
+{
+    return Sync(editor, pattern, case_sensitive, true);
+}
+
+std::size_t TextEditorSearchSession::Sync(const TextEditor& editor, std::string_view query,
+                                          bool case_sensitive, bool is_regex)
+{
+    last_scanned_lines_ = 0;
+    last_refined_matches_ = 0;
+    line_text_line_ = -1;
+
+    const int line_count = editor.GetLineCount();
+    const std::uint64_t version = editor.GetDocumentVersion();
+
+    // Pick up edits made since the previous update
+    changes_.clear();
+    dirty_.clear();
+    bool full_scan = !valid_ || editor_ != &editor || case_sensitive != case_sensitive_ ||
+                     is_regex != is_regex_ || !editor.GetLineChangesSince(document_version_, changes_);
+    if (!full_scan && !changes_.empty())
+    {
+        const int reach = is_regex ? 0 : std::max(CountLineBreaks(query_), CountLineBreaks(query));
+        for (const auto& change : changes_)
+            ApplyLineChange(change, reach);
+    }
+
+    // Extending a literal query can only remove matches; anything else starts over
+    const bool same_query = query == query_;
+    const bool extends_query = !is_regex && !query_.empty() && query.size() > query_.size() &&
+                               query.substr(0, query_.size()) == query_;
+    if (!same_query && !extends_query)
+        full_scan = true;
+
+    editor_ = &editor;
+    document_version_ = version;
+    case_sensitive_ = case_sensitive;
+    is_regex_ = is_regex;
+    query_.assign(query);
+    valid_ = true;
+
+    segments_.clear();
+    for (std::size_t begin = 0;;)
+    {
+        const std::size_t end = query_.find('\n', begin);
+        segments_.emplace_back(std::string_view(query_).substr(begin, end - begin));
+        if (end == std::string::npos)
+            break;
+        begin = end + 1;
+    }
+
+    if (is_regex && full_scan && !query_.empty())
+    {
+        try
+        {
+            regex_.assign(query_, case_sensitive ? boost::regex_constants::ECMAScript
+                                                 : boost::regex_constants::ECMAScript | boost::regex_constants::icase);
+            regex_valid_ = true;
+        }
+        catch (const boost::regex_error&)
+        {
+            regex_valid_ = false;
+        }
+    }
+
+    if (query_.empty() || (is_regex && !regex_valid_))
+    {
+        matches_.clear();
+        return 0;
+    }
+
+    scanned_.clear();
+    if (full_scan)
+    {
+        matches_.clear();
+        candidates_.clear();
+        const bool narrowed = index_ != nullptr && index_->IsReadyFor(editor) &&
+                              (is_regex ? index_->QueryRegex(query_, candidates_)
+                                        : index_->QueryLiteral(query_, candidates_));
+        if (narrowed)
+        {
+            last_scanned_lines_ = static_cast<int>(candidates_.size());
+            for (const int line : candidates_)
+            {
+                if (line < line_count)
+                    ScanLine(editor, line);
+            }
+            matches_.swap(scanned_);
+            return matches_.size();
+        }
+        dirty_.clear();
+        dirty_.emplace_back(0, line_count);
+    }
+
+    // Rescan ranges may overlap after several edits
+    for (auto& [begin, end] : dirty_)
+    {
+        begin = std::clamp(begin, 0, line_count);
+        end = std::clamp(end, begin, line_count);
+    }
+    std::sort(dirty_.begin(), dirty_.end());
+    std::size_t merged_count = 0;
+    for (const auto& range : dirty_)
+    {
+        if (range.first == range.second)
+            continue;
+        if (merged_count > 0 && range.first <= dirty_[merged_count - 1].second)
+            dirty_[merged_count - 1].second = std::max(dirty_[merged_count - 1].second, range.second);
+        else
+            dirty_[merged_count++] = range;
+    }
+    dirty_.resize(merged_count);
+
+    // Previous matches outside the rescanned lines either still match or are dropped
+    if (extends_query && !full_scan)
+    {
+        last_refined_matches_ = static_cast<int>(matches_.size());
+        std::size_t kept = 0;
+        for (const auto& match : matches_)
+        {
+            Match refined;
+            if (MatchAt(editor, match.line, match.char_index, refined))
+                matches_[kept++] = refined;
+        }
+        matches_.resize(kept);
+    }
+
+    if (dirty_.empty())
+        return matches_.size();
+
+    for (const auto& [begin, end] : dirty_)
+    {
+        last_scanned_lines_ += end - begin;
+        for (int line = begin; line < end; ++line)
+            ScanLine(editor, line);
+    }
+
+    merged_.clear();
+    merged_.reserve(matches_.size() + scanned_.size());
+    std::merge(matches_.begin(), matches_.end(), scanned_.begin(), scanned_.end(),
+               std::back_inserter(merged_), MatchLess);
+    matches_.swap(merged_);
+
+    return matches_.size();
+}
+
+void TextEditorSearchSession::Reset()
+{
+    query_.clear();
+    valid_ = false;
+    editor_ = nullptr;
+    document_version_ = 0;
+    matches_.clear();
+    line_text_line_ = -1;
+}
+
+int TextEditorSearchSession::FindNextMatch(int line, int char_index) const
+{
+    if (matches_.empty())
+        return -1;
+
+    Match position;
+    position.line = line;
+    position.char_index = char_index;
+    const auto it = std::lower_bound(matches_.begin(), matches_.end(), position, MatchLess);
+    return it == matches_.end() ? 0 : static_cast<int>(it - matches_.begin());
+}
+
+void TextEditorSearchSession::ApplyLineChange(const TextEditor::LineChange& change, int reach)
+{
+    const int first = std::max(0, change.mFirstLine - reach);
+    const int old_end = change.mFirstLine + change.mOldCount;
+    const int new_end = change.mFirstLine + change.mNewCount;
+    const int delta = change.mNewCount - change.mOldCount;
+
+    // Matches that start close enough to touch the replaced lines are rescanned
+    std::size_t kept = 0;
+    for (auto match : matches_)
+    {
+        if (match.line >= first && match.line < old_end)
+            continue;
+        if (match.line >= old_end)
+        {
+            match.line += delta;
+            match.end_line += delta;
+        }
+        matches_[kept++] = match;
+    }
+    matches_.resize(kept);
+
+    // Map pending rescan ranges through the change, then add the replaced lines
+    const auto map_line = [&](int line, bool is_end) {
+        if (line <= change.mFirstLine)
+            return line;
+        if (line >= old_end)
+            return line + delta;
+        return is_end ? new_end : change.mFirstLine;
+    };
+    for (auto& [begin, end] : dirty_)
+    {
+        begin = map_line(begin, false);
+        end = map_line(end, true);
+    }
+    dirty_.emplace_back(first, new_end);
+}
+
+void TextEditorSearchSession::ScanLine(const TextEditor& editor, int line)
+{
+    const std::string& text = LineText(editor, line);
+
+    if (is_regex_)
+    {
+        const char* const begin = text.data();
+        const char* const end = begin + text.size();
+        boost::cmatch result;
+        auto flags = boost::regex_constants::match_default;
+        for (const char* pos = begin; pos <= end && boost::regex_search(pos, end, result, regex_, flags);)
+        {
+            const auto first = static_cast<int>(result[0].first - begin);
+            const auto last = static_cast<int>(result[0].second - begin);
+            if (last > first)
+                scanned_.push_back({line, first, line, last});
+            // Step over empty matches so the search always advances
+            pos = last > first ? result[0].second : result[0].second + 1;
+            flags |= boost::regex_constants::match_prev_avail;
+        }
+        return;
+    }
+
+    const std::string_view head = segments_.front();
+    if (text.size() < head.size())
+        return;
+
+    if (segments_.size() > 1)
+    {
+        // A multi-line match can only start where the first segment ends the line
+        Match match;
+        if (MatchAt(editor, line, static_cast<int>(text.size() - head.size()), match))
+            scanned_.push_back(match);
+        return;
+    }
+
+    if (case_sensitive_)
+    {
+        for (std::size_t pos = text.find(head); pos != std::string::npos; pos = text.find(head, pos + 1))
+        {
+            const int index = static_cast<int>(pos);
+            scanned_.push_back({line, index, line, index + static_cast<int>(head.size())});
+        }
+        return;
+    }
+    for (std::size_t pos = 0; pos + head.size() <= text.size(); ++pos)
+    {
+        if (SegmentEquals(text, pos, head))
+        {
+            const int index = static_cast<int>(pos);
+            scanned_.push_back({line, index, line, index + static_cast<int>(head.size())});
+        }
+    }
+}
+
+bool TextEditorSearchSession::MatchAt(const TextEditor& editor, int line, int char_index, Match& out)
+{
+    const int last_line = line + static_cast<int>(segments_.size()) - 1;
+    if (line < 0 || last_line >= editor.GetLineCount())
+        return false;
+
+    const std::string& text = LineText(editor, line);
+    const std::string_view head = segments_.front();
+    const auto start = static_cast<std::size_t>(char_index);
+    if (start > text.size() || text.size() - start < head.size() || !SegmentEquals(text, start, head))
+        return false;
+
+    if (segments_.size() == 1)
+    {
+        out = {line, char_index, line, char_index + static_cast<int>(head.size())};
+        return true;
+    }
+
+    // Every segment but the last has to run up to the end of its line
+    if (text.size() - start != head.size())
+        return false;
+    for (std::size_t i = 1; i < segments_.size(); ++i)
+    {
+        const std::string_view segment = segments_[i];
+        editor.GetLineText(line + static_cast<int>(i), other_line_text_);
+        const bool is_last = i + 1 == segments_.size();
+        if (other_line_text_.size() < segment.size() ||
+            (!is_last && other_line_text_.size() != segment.size()) ||
+            !SegmentEquals(other_line_text_, 0, segment))
+            return false;
+    }
+
+    out = {line, char_index, last_line, static_cast<int>(segments_.back().size())};
+    return true;
+}
+
+const std::string& TextEditorSearchSession::LineText(const TextEditor& editor, int line)
+{
+    if (line != line_text_line_)
+    {
+        editor.GetLineText(line, line_text_);
+        line_text_line_ = line;
+    }
+    return line_text_;
+}
+
+bool TextEditorSearchSession::SegmentEquals(std::string_view text, std::size_t offset,
+                                            std::string_view segment) const
+{
+    if (case_sensitive_)
+        return text.compare(offset, segment.size(), segment) == 0;
+    for (std::size_t i = 0; i < segment.size(); ++i)
+    {
+        if (FoldCase(text[offset + i]) != FoldCase(segment[i]))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include "TextEditor.h"
+
+#include <atomic>
+#include <boost/regex.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Trigram index over a TextEditor document for repeated searches
+ *
+ * Meant for large read-only documents (log viewers): the index is built on a
+ * background thread from a snapshot of the lines and maps every trigram (ASCII
+ * case folded) to the sorted list of lines containing it. Literal queries and
+ * the required literal parts of simple regular expressions are turned into a
+ * list of candidate lines, which the caller still has to verify.
+ */
+class TextEditorTrigramIndex
+{
+public:
+    struct Config
+    {
+        bool require_read_only = true;  // Only index while the editor is read-only
+    };
+
+    struct Stats
+    {
+        std::size_t memory_bytes = 0;
+        std::size_t trigram_count = 0;
+        std::size_t posting_count = 0;
+        int line_count = 0;
+        double build_milliseconds = 0.0;
+        bool building = false;
+    };
+
+    TextEditorTrigramIndex();
+    explicit TextEditorTrigramIndex(Config config);
+    ~TextEditorTrigramIndex();
+
+    // Non-copyable
+    TextEditorTrigramIndex(const TextEditorTrigramIndex&) = delete;
+    TextEditorTrigramIndex& operator=(const TextEditorTrigramIndex&) = delete;
+
+    // Movable
+    TextEditorTrigramIndex(TextEditorTrigramIndex&&) noexcept;
+    TextEditorTrigramIndex& operator=(TextEditorTrigramIndex&&) noexcept;
+
+    /**
+     * @brief Start, finish or drop the index build to follow the editor; call once per frame
+     * @param editor The text editor to index
+     */
+    void Update(const TextEditor& editor);
+
+    /**
+     * @brief Wait for a running build to finish and publish it
+     */
+    void WaitForBuild();
+
+    /**
+     * @brief Drop the index and cancel any running build
+     */
+    void Clear();
+
+    /**
+     * @brief Check whether the index describes the editor's current text
+     */
+    [[nodiscard]] bool IsReadyFor(const TextEditor& editor) const;
+
+    /**
+     * @brief Lines that may contain a literal
+     * @param text Text to look up, '\n' separates consecutive lines
+     * @param out_lines Receives candidate start lines in ascending order
+     * @return false if the index cannot narrow the search (not built, or no segment has 3 characters)
+     */
+    bool QueryLiteral(std::string_view text, std::vector<int>& out_lines) const;
+
+    /**
+     * @brief Lines that may contain a match of a regular expression
+     *
+     * Only literal runs that every match must contain are used, so patterns with
+     * top-level alternation or without a 3 character literal cannot be narrowed.
+     * @param pattern ECMAScript pattern, matched within single lines
+     * @param out_lines Receives candidate lines in ascending order
+     * @return false if the index cannot narrow the search
+     */
+    bool QueryRegex(std::string_view pattern, std::vector<int>& out_lines) const;
+
+    [[nodiscard]] Stats GetStats() const;
+
+    [[nodiscard]] auto& GetConfig() { return config_; }
+    [[nodiscard]] const auto& GetConfig() const { return config_; }
+
+private:
+    struct IndexData
+    {
+        std::vector<std::uint32_t> keys;     // Sorted trigram keys
+        std::vector<std::uint32_t> offsets;  // keys.size() + 1 offsets into postings
+        std::vector<std::uint32_t> postings; // Line numbers, ascending per key
+        std::uint64_t version = 0;
+        int line_count = 0;
+        double build_milliseconds = 0.0;
+    };
+    struct BuildJob;
+
+    Config config_;
+    const TextEditor* editor_ = nullptr;
+    std::unique_ptr<IndexData> data_;
+    std::unique_ptr<BuildJob> job_;
+
+    static void Build(const std::string& text, const std::vector<std::uint32_t>& line_starts,
+                      const std::atomic<bool>& cancelled, IndexData& out);
+
+    /**
+     * @brief Posting list for one trigram, empty if it never occurs
+     */
+    [[nodiscard]] std::pair<const std::uint32_t*, const std::uint32_t*> Postings(std::uint32_t key) const;
+
+    /**
+     * @brief Intersect the postings of every trigram of the given runs
+     * @param runs Literal runs paired with the line offset they must appear at
+     */
+    bool Intersect(const std::vector<std::pair<std::string_view, int>>& runs,
+                   std::vector<int>& out_lines) const;
+};
+
+/**
+ * @brief Incremental find-as-you-type for TextEditor
+ *
+ * Keeps every occurrence of the current query and reuses it for the next one:
+ * - Extending the query ("foo" -> "foob") only re-checks the previous match starts
+ * - Edits since the last update only rescan the changed lines, using
+ *   TextEditor::GetDocumentVersion() and TextEditor::GetLineChangesSince()
+ * - Anything else (shorter or different query, toggled case sensitivity,
+ *   another editor, lost edit history) falls back to a full scan, narrowed by a
+ *   TextEditorTrigramIndex when one is attached and up to date
+ *
+ * Overlapping occurrences are all reported ("aa" matches "aaa" twice), which is
+ * what makes the refinement exact.
+ */
+class TextEditorSearchSession
+{
+public:
+    /**
+     * @brief One occurrence of the query, as character indices (same convention as TextEditor::Highlight)
+     */
+    struct Match
+    {
+        int line = 0;
+        int char_index = 0;
+        int end_line = 0;
+        int end_char_index = 0;
+    };
+
+    TextEditorSearchSession() = default;
+    ~TextEditorSearchSession() = default;
+
+    // Non-copyable
+    TextEditorSearchSession(const TextEditorSearchSession&) = delete;
+    TextEditorSearchSession& operator=(const TextEditorSearchSession&) = delete;
+
+    // Movable
+    TextEditorSearchSession(TextEditorSearchSession&&) noexcept = default;
+    TextEditorSearchSession& operator=(TextEditorSearchSession&&) noexcept = default;
+
+    /**
+     * @brief Bring the match set up to date with the editor and a literal query
+     * @param editor The text editor to search
+     * @param query Text to find; '\n' matches a line break
+     * @param case_sensitive Whether ASCII letters must match case
+     * @return Number of matches
+     */
+    std::size_t Update(const TextEditor& editor, std::string_view query, bool case_sensitive = true);
+
+    /**
+     * @brief Bring the match set up to date with the editor and a regular expression
+     *
+     * Matches never span lines. Changing the pattern always rescans, edits only
+     * rescan the changed lines.
+     * @param editor The text editor to search
+     * @param pattern ECMAScript pattern; an invalid pattern yields no matches
+     * @param case_sensitive Whether letters must match case
+     * @return Number of matches
+     */
+    std::size_t UpdateRegex(const TextEditor& editor, std::string_view pattern, bool case_sensitive = true);
+
+    /**
+     * @brief Drop all results; the next update does a full scan
+     */
+    void Reset();
+
+    /**
+     * @brief Use an index to narrow full scans; the index must outlive the session
+     */
+    void SetIndex(const TextEditorTrigramIndex* index) { index_ = index; }
+
+    /**
+     * @brief All matches, sorted by position
+     */
+    [[nodiscard]] const std::vector<Match>& GetMatches() const { return matches_; }
+    [[nodiscard]] const std::string& GetQuery() const { return query_; }
+    [[nodiscard]] bool IsRegexValid() const { return !is_regex_ || regex_valid_; }
+
+    /**
+     * @brief Find the first match starting at or after a position, wrapping around
+     * @param line Line number
+     * @param char_index Character index in the line
+     * @return Index into GetMatches(), or -1 if there are no matches
+     */
+    [[nodiscard]] int FindNextMatch(int line, int char_index) const;
+
+    /**
+     * @brief Number of lines scanned from scratch by the last update
+     */
+    [[nodiscard]] int GetLastScannedLineCount() const { return last_scanned_lines_; }
+
+    /**
+     * @brief Number of previous matches re-checked by the last update
+     */
+    [[nodiscard]] int GetLastRefinedMatchCount() const { return last_refined_matches_; }
+
+private:
+    std::string query_;
+    bool case_sensitive_ = true;
+    bool is_regex_ = false;
+    bool regex_valid_ = false;
+    bool valid_ = false;
+    const TextEditor* editor_ = nullptr;
+    const TextEditorTrigramIndex* index_ = nullptr;
+    std::uint64_t document_version_ = 0;
+    boost::regex regex_;
+
+    std::vector<Match> matches_;
+    std::vector<Match> scanned_;                // scratch: matches found in rescanned lines
+    std::vector<Match> merged_;                 // scratch: survivors + scanned_
+    std::vector<TextEditor::LineChange> changes_;
+    std::vector<std::pair<int, int>> dirty_;    // [begin, end) line ranges to rescan
+    std::vector<int> candidates_;               // lines suggested by the index
+    std::vector<std::string_view> segments_;    // query split at '\n'
+
+    // GetLineText buffers, the first one caches a whole line across candidates
+    std::string line_text_;
+    std::string other_line_text_;
+    int line_text_line_ = -1;
+
+    int last_scanned_lines_ = 0;
+    int last_refined_matches_ = 0;
+
+    std::size_t Sync(const TextEditor& editor, std::string_view query, bool case_sensitive, bool is_regex);
+
+    /**
+     * @brief Shift and drop matches for one line change and record the lines to rescan
+     * @param reach How many lines above the change a match may start and still cover it
+     */
+    void ApplyLineChange(const TextEditor::LineChange& change, int reach);
+
+    /**
+     * @brief Collect all matches of the current query starting in a line
+     */
+    void ScanLine(const TextEditor& editor, int line);
+
+    /**
+     * @brief Check whether the current literal query occurs at a position
+     * @param out Receives the match on success
+     */
+    [[nodiscard]] bool MatchAt(const TextEditor& editor, int line, int char_index, Match& out);
+
+    [[nodiscard]] const std::string& LineText(const TextEditor& editor, int line);
+    [[nodiscard]] bool SegmentEquals(std::string_view text, std::size_t offset, std::string_view segment) const;
+};
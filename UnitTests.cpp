@@ -1,4 +1,12 @@
 #include "TextEditor.h"
+#include "TextEditorAutocomplete.hpp"
+#include "TextEditorBracketMatcher.hpp"
+#include "TextEditorCodeFolding.hpp"
+#include "TextEditorMinimap.hpp"
+#include "TextEditorSearch.hpp"
+
+#include <cstring>
+#include <thread>
 
 void TextEditor::UnitTests()
 {
@@ -201,6 +209,1208 @@ void TextEditor::UnitTests()
 		assert(SanitizeCoordinates(Coordinates(0, 5)) == Coordinates(0, 4));
 	}
 
+	// --- GetLineChangesSince --- //
+	{
+		SetText("a\nb\nc");
+		std::uint64_t version = GetDocumentVersion();
+		std::vector<LineChange> changes;
+		assert(GetLineChangesSince(version, changes) && changes.empty());
+
+		// adjacent changes nobody has seen yet are reported as one block
+		Coordinates where{ 1, 1 };
+		InsertTextAt(where, "x\ny");
+		assert(GetText() == "a\nbx\ny\nc");
+		assert(GetLineChangesSince(version, changes) && changes.size() == 1);
+		assert(changes[0].mFirstLine == 1 && changes[0].mOldCount == 1 && changes[0].mNewCount == 2);
+		assert(changes[0].mVersion == GetDocumentVersion());
+
+		// history is bounded, falling behind reports failure instead of partial results
+		const std::uint64_t old_version = GetDocumentVersion();
+		for (int i = 0; i < 300; i++)
+		{
+			InsertLine(0);
+			(void)GetDocumentVersion();
+		}
+		changes.clear();
+		assert(!GetLineChangesSince(old_version, changes));
+		assert(GetLineChangesSince(GetDocumentVersion() - 1, changes) && changes.size() == 1);
+	}
+
+	// --- FindMatchingBracket --- //
+	{
+		const auto prevLanguage = GetLanguageDefinition();
+		SetLanguageDefinition(LanguageDefinitionId::Cpp);
+		SetText("f(a[1], \")\") {\n\t// }\n\tg(\"{\");\n}\n{");
+		ColorizeInternal();
+		Coordinates match;
+		// brackets in strings and comments are skipped
+		assert(FindMatchingBracket(0, 1, match) && match == Coordinates(0, 11));
+		assert(FindMatchingBracket(0, 3, match) && match == Coordinates(0, 5));
+		assert(FindMatchingBracket(0, 13, match) && match == Coordinates(3, 0));
+		assert(FindMatchingBracket(3, 0, match) && match == Coordinates(0, 13));
+		assert(!FindMatchingBracket(1, 4, match));
+		assert(!FindMatchingBracket(4, 0, match));
+		// the search gives up after the line limit
+		SetBracketMatchingLineLimit(2);
+		assert(!FindMatchingBracket(0, 13, match));
+		SetBracketMatchingLineLimit(10000);
+		// the index follows edits
+		Coordinates where{ 2, 0 };
+		InsertTextAt(where, "}");
+		ColorizeInternal();
+		assert(FindMatchingBracket(0, 13, match) && match == Coordinates(2, 0));
+		where = { 0, 0 };
+		InsertTextAt(where, "x\n");
+		ColorizeInternal();
+		assert(FindMatchingBracket(1, 13, match) && match == Coordinates(3, 0));
+		assert(!FindMatchingBracket(4, 0, match));
+		SetLanguageDefinition(prevLanguage);
+	}
+
+	// --- TextEditorBracketMatcher --- //
+	{
+		const auto samePairs = [](const TextEditorBracketMatcher& a, const TextEditorBracketMatcher& b) {
+			const auto& x = a.GetBracketPairs();
+			const auto& y = b.GetBracketPairs();
+			if (x.size() != y.size())
+				return false;
+			for (size_t i = 0; i < x.size(); ++i)
+			{
+				if (x[i].open_line != y[i].open_line || x[i].open_column != y[i].open_column ||
+					x[i].close_line != y[i].close_line || x[i].close_column != y[i].close_column ||
+					x[i].depth != y[i].depth || x[i].open_indent_column != y[i].open_indent_column)
+					return false;
+			}
+			return true;
+		};
+
+		SetText("int f() {\n\tif (a[0]) {\n\t\tg();\n\t}\n\th(1);\n}\n");
+		TextEditorBracketMatcher matcher;
+		matcher.AnalyzeDocument(*this);
+		assert(matcher.GetBracketPairs().size() == 7 && matcher.GetLastTokenizedLineCount() == 7);
+		assert(matcher.GetBracketColor(2, 4).has_value() && !matcher.GetBracketColor(2, 0).has_value());
+		const auto pair = matcher.FindMatchingBracket(5, 0);
+		assert(pair && pair->open_line == 0 && pair->open_column == 8 && pair->depth == 0);
+
+		// a balanced edit re-reads and re-pairs only its own line
+		Coordinates where{ 2, 2 };
+		InsertTextAt(where, "k(x);");
+		matcher.AnalyzeDocument(*this);
+		assert(matcher.GetLastTokenizedLineCount() == 1 && matcher.GetLastPairedLineCount() == 1);
+		assert(matcher.GetBracketPairs().size() == 8);
+
+		// a new line moves the lines below it without pairing them again
+		where = { 0, 9 };
+		InsertTextAt(where, "\n");
+		matcher.AnalyzeDocument(*this);
+		assert(matcher.GetLastTokenizedLineCount() == 1 && matcher.GetLastPairedLineCount() == 1);
+		assert(matcher.GetBracketPairs().size() == 8 && matcher.FindMatchingBracket(6, 0)->open_line == 0);
+
+		// and typing on the line of an opening bracket keeps the pairs of the block it opens
+		where = { 0, 0 };
+		InsertTextAt(where, "x");
+		matcher.AnalyzeDocument(*this);
+		assert(matcher.GetLastTokenizedLineCount() == 1 && matcher.GetLastPairedLineCount() == 1);
+		assert(matcher.GetBracketPairs().size() == 8 && matcher.FindMatchingBracket(6, 0)->open_column == 9);
+
+		// random edits give the same pairs as a full analysis
+		unsigned int seed = 12345;
+		const auto next = [&seed](int aRange) {
+			seed = seed * 1103515245u + 12345u;
+			return static_cast<int>((seed >> 16) % static_cast<unsigned int>(aRange));
+		};
+		const char* pieces[] = { "{", "}", "(", ")", "[", "]", "\n", "x", "{\n}", "(\n\t", "\n)\n" };
+		for (int i = 0; i < 300; ++i)
+		{
+			const int line = next(GetLineCount());
+			Coordinates start{ line, next(GetLineMaxColumn(line) + 1) };
+			if (next(3) == 0)
+			{
+				const int endLine = Min(GetLineCount() - 1, line + next(3));
+				Coordinates end{ endLine, next(GetLineMaxColumn(endLine) + 1) };
+				if (end < start)
+					std::swap(start, end);
+				DeleteRange(start, end);
+			}
+			else
+				InsertTextAt(start, pieces[next(static_cast<int>(sizeof(pieces) / sizeof(pieces[0])))]);
+
+			matcher.AnalyzeDocument(*this);
+			if (next(4) == 0)
+				continue;  // let some edits pile up
+			TextEditorBracketMatcher reference;
+			reference.AnalyzeDocument(*this);
+			assert(samePairs(matcher, reference));
+
+			// a line range query returns exactly the pairs overlapping it
+			const int first = next(GetLineCount());
+			const int last = first + next(4);
+			std::vector<TextEditorBracketMatcher::BracketPair> inRange;
+			matcher.GetBracketPairsInLines(first, last, inRange);
+			size_t overlapping = 0;
+			for (const auto& p : matcher.GetBracketPairs())
+			{
+				if (p.open_line > last || p.close_line < first)
+					continue;
+				++overlapping;
+				assert(std::any_of(inRange.begin(), inRange.end(), [&p](const auto& q) {
+					return q.open_line == p.open_line && q.open_column == p.open_column &&
+						q.close_line == p.close_line && q.close_column == p.close_column && q.depth == p.depth;
+				}));
+			}
+			assert(overlapping == inRange.size());
+		}
+
+		// brackets in strings and comments don't nest once the colorizer has classified them
+		const auto prevLanguage = GetLanguageDefinition();
+		SetLanguageDefinition(LanguageDefinitionId::Cpp);
+		SetText("f(\")\") {\n\t// }\n}\n");
+		TextEditorBracketMatcher classified;
+		TextEditorCodeFolding folding;
+		const std::uint64_t textVersion = GetDocumentVersion();
+		const std::uint64_t classVersion = GetTokenClassVersion();
+		ColorizeInternal();
+		assert(GetDocumentVersion() == textVersion && GetTokenClassVersion() != classVersion);
+		assert(GetGlyphTokenClass(0, 3) == TokenClass::String && GetGlyphTokenClass(1, 4) == TokenClass::Comment);
+		classified.AnalyzeDocument(*this);
+		folding.AnalyzeDocument(*this);
+		assert(classified.GetBracketPairs().size() == 2);
+		const auto brace = classified.FindMatchingBracket(2, 0);
+		assert(brace && brace->open_line == 0 && brace->open_column == 7);
+		assert(folding.GetRegions().size() == 1 && folding.GetRegions()[0].end_line == 2);
+		SetLanguageDefinition(prevLanguage);
+	}
+
+	// --- TextEditorCodeFolding --- //
+	{
+		const auto sameRegions = [](const TextEditorCodeFolding& a, const TextEditorCodeFolding& b) {
+			const auto& x = a.GetRegions();
+			const auto& y = b.GetRegions();
+			if (x.size() != y.size())
+				return false;
+			for (size_t i = 0; i < x.size(); ++i)
+			{
+				if (x[i].start_line != y[i].start_line || x[i].end_line != y[i].end_line ||
+					x[i].indent_level != y[i].indent_level)
+					return false;
+			}
+			return true;
+		};
+
+		SetText("int f() {\n\tif (a) {\n\t\tg();\n\t\th();\n\t}\n}\n");
+		TextEditorCodeFolding folding;
+		folding.AnalyzeDocument(*this);
+		assert(folding.GetRegions().size() == 4 && folding.GetLastTokenizedLineCount() == 7);
+		assert(folding.Fold(1) && folding.IsLineHidden(3) && !folding.IsLineHidden(5));
+
+		// fold state follows its region when lines are inserted above it
+		Coordinates where{ 0, 0 };
+		InsertTextAt(where, "x\n");
+		folding.AnalyzeDocument(*this);
+		assert(folding.GetLastTokenizedLineCount() == 2);
+		assert(folding.GetRegionAtLine(2)->is_folded && !folding.IsLineHidden(2) && folding.IsLineHidden(5));
+
+		// a balanced edit re-reads and re-derives only its own line
+		where = { 3, 8 };
+		InsertTextAt(where, "k();");
+		folding.AnalyzeDocument(*this);
+		assert(folding.GetLastTokenizedLineCount() == 1 && folding.GetLastScannedLineCount() == 1);
+		assert(folding.GetRegions().size() == 4 && folding.GetRegionAtLine(2)->is_folded);
+
+		// typing leaves the editor's hidden lines alone, a new line above the fold moves them
+		folding.SyncHiddenLines(*this);
+		const auto hiddenRevision = mHiddenRangesRevision;
+		where = { 1, 0 };
+		InsertTextAt(where, "y");
+		folding.AnalyzeDocument(*this);
+		folding.SyncHiddenLines(*this);
+		assert(mHiddenRangesRevision == hiddenRevision && folding.GetRegionAtLine(2)->is_folded);
+		where = { 0, 1 };
+		InsertTextAt(where, "\n");
+		folding.AnalyzeDocument(*this);
+		folding.SyncHiddenLines(*this);
+		assert(mHiddenRangesRevision != hiddenRevision && folding.GetRegionStartingAtLine(3)->is_folded);
+		assert(!folding.IsLineHidden(3) && folding.IsLineHidden(4) && folding.IsLineHidden(6) && !folding.IsLineHidden(7));
+		assert(mHiddenLineRanges.size() == 1 && mHiddenLineRanges[0].mStartLine == 4 && mHiddenLineRanges[0].mEndLine == 6);
+		ClearHiddenLineRanges();
+
+		// random edits give the same regions as a full analysis
+		unsigned int seed = 4242;
+		const auto next = [&seed](int aRange) {
+			seed = seed * 1103515245u + 12345u;
+			return static_cast<int>((seed >> 16) % static_cast<unsigned int>(aRange));
+		};
+		const char* pieces[] = { "{", "}", "\n", "\t", "    ", "x", "{\n}", "\n\t", "\n\n", "\tx\n" };
+		for (int i = 0; i < 300; ++i)
+		{
+			const int line = next(GetLineCount());
+			Coordinates start{ line, next(GetLineMaxColumn(line) + 1) };
+			if (next(3) == 0)
+			{
+				const int endLine = Min(GetLineCount() - 1, line + next(3));
+				Coordinates end{ endLine, next(GetLineMaxColumn(endLine) + 1) };
+				if (end < start)
+					std::swap(start, end);
+				DeleteRange(start, end);
+			}
+			else
+				InsertTextAt(start, pieces[next(static_cast<int>(sizeof(pieces) / sizeof(pieces[0])))]);
+
+			folding.AnalyzeDocument(*this);
+			if (next(4) == 0)
+				continue;  // let some edits pile up
+			TextEditorCodeFolding reference;
+			reference.AnalyzeDocument(*this);
+			assert(sameRegions(folding, reference));
+		}
+
+		// indentation regions match a look-ahead from every non-blank line
+		TextEditorCodeFolding::Config indentOnly;
+		indentOnly.detection_mode = TextEditorCodeFolding::DetectionMode::Indentation;
+		TextEditorCodeFolding byIndent(indentOnly);
+		for (int i = 0; i < 50; ++i)
+		{
+			std::vector<int> indents;
+			std::string text;
+			for (int line = 0; line < 40; ++line)
+			{
+				const bool blank = next(6) == 0;
+				indents.push_back(blank ? -1 : 2 * next(5));
+				text += std::string(blank ? next(3) : static_cast<size_t>(indents.back()), ' ') + (blank ? "\n" : "x\n");
+			}
+			indents.push_back(-1);
+			SetText(text);
+			byIndent.AnalyzeDocument(*this);
+
+			std::vector<std::pair<int, int>> expected;
+			for (int line = 0; line < static_cast<int>(indents.size()); ++line)
+			{
+				if (indents[line] < 0)
+					continue;
+				int end = line;
+				for (int j = line + 1; j < static_cast<int>(indents.size()); ++j)
+				{
+					if (indents[j] < 0)
+						continue;
+					if (indents[j] <= indents[line])
+						break;
+					end = j;
+				}
+				if (end - line >= indentOnly.min_lines_to_fold)
+					expected.emplace_back(line, end);
+			}
+			const auto& regions = byIndent.GetRegions();
+			assert(regions.size() == expected.size());
+			for (size_t r = 0; r < regions.size(); ++r)
+				assert(regions[r].start_line == expected[r].first && regions[r].end_line == expected[r].second);
+		}
+
+		// deep nesting above a long body is a single pass, and edits below it stay local
+		std::string nested;
+		for (int depth = 0; depth < 200; ++depth)
+			nested += std::string(static_cast<size_t>(depth), '\t') + "x\n";
+		for (int line = 0; line < 5000; ++line)
+			nested += std::string(200, '\t') + "y\n";
+		SetText(nested);
+		byIndent.AnalyzeDocument(*this);
+		assert(byIndent.GetRegions().size() == 200 && byIndent.GetRegions()[0].end_line == 5199);
+		assert(byIndent.GetLastScannedLineCount() == GetLineCount());
+		where = { 5199, 200 * GetTabSize() };
+		const std::string appended = "z\n" + std::string(200, '\t') + "w";
+		InsertTextAt(where, appended.c_str());
+		byIndent.AnalyzeDocument(*this);
+		assert(byIndent.GetLastTokenizedLineCount() == 2 && byIndent.GetLastScannedLineCount() == 3);
+		assert(byIndent.GetRegions().size() == 200 && byIndent.GetRegions()[199].end_line == 5200);
+
+		// visibility queries over 100k nested and overlapping regions agree with a per-line walk
+		std::vector<TextEditorCodeFolding::FoldRegion> many;
+		for (int i = 0; i < 100000; ++i)
+		{
+			TextEditorCodeFolding::FoldRegion region;
+			region.start_line = i % 10 == 0 ? 3 * i + 1 : 3 * i;
+			region.end_line = region.start_line + (i % 10 == 0 ? 25 : 2);
+			many.push_back(region);
+		}
+		std::reverse(many.begin(), many.end());
+		TextEditorCodeFolding lsp;
+		lsp.SetFoldRegions(many);
+		for (int i = 0; i < 100000; i += 3)
+			(void)lsp.Fold(i % 10 == 0 ? 3 * i + 1 : 3 * i);
+		const int lineCount = 300030;
+		std::vector<char> hidden(lineCount, 0);
+		for (const auto& region : lsp.GetRegions())
+		{
+			if (region.is_folded)
+				std::fill(hidden.begin() + region.start_line + 1, hidden.begin() + region.end_line + 1, 1);
+		}
+		int visual = 0;
+		for (int line = 0; line < lineCount; ++line)
+		{
+			assert(lsp.IsLineHidden(line) == (hidden[line] != 0));
+			if (hidden[line])
+			{
+				assert(lsp.ActualLineToVisualLine(line) == -1);
+				continue;
+			}
+			assert(lsp.ActualLineToVisualLine(line) == visual);
+			assert(lsp.VisualLineToActualLine(visual) == line);
+			++visual;
+		}
+		assert(lsp.GetRegionStartingAtLine(91)->end_line == 116 && lsp.GetRegionStartingAtLine(91)->is_folded);
+		assert(!lsp.GetRegionStartingAtLine(92).has_value());
+		lsp.UnfoldAll();
+		assert(!lsp.IsLineHidden(92) && lsp.VisualLineToActualLine(1000) == 1000);
+	}
+
+	// --- HideLineRange --- //
+	{
+		const auto sameVisualLines = [](const std::vector<VisualLine>& a, const std::vector<VisualLine>& b) {
+			if (a.size() != b.size())
+				return false;
+			for (size_t i = 0; i < a.size(); ++i)
+			{
+				if (a[i].mIsGhost != b[i].mIsGhost || a[i].mGhostIndex != b[i].mGhostIndex ||
+					a[i].mDocumentLine != b[i].mDocumentLine || a[i].mWrapStartColumn != b[i].mWrapStartColumn ||
+					a[i].mWrapEndColumn != b[i].mWrapEndColumn)
+					return false;
+			}
+			return true;
+		};
+
+		std::string text;
+		for (int line = 0; line < 60; ++line)
+			text += std::string(static_cast<size_t>(line % 7) * 9, 'a') + (line % 5 == 0 ? " b c d e f\n" : "\n");
+		SetText(text);
+		const int prevWrapColumn = mWrapColumn;
+		mWrapColumn = 20;
+		SetWordWrapEnabled(true);
+		GhostLine ghost;
+		std::vector<GhostLine> ghosts;
+		for (int anchor : { 0, 3, 3, 17, 40, 59, 60 })
+		{
+			ghost.mAnchorLine = anchor;
+			ghosts.push_back(ghost);
+		}
+		SetGhostLines(std::move(ghosts));
+
+		// patched visual lines match a full rebuild
+		unsigned int seed = 777;
+		const auto next = [&seed](int aRange) {
+			seed = seed * 1103515245u + 12345u;
+			return static_cast<int>((seed >> 16) % static_cast<unsigned int>(aRange));
+		};
+		for (int i = 0; i < 300; ++i)
+		{
+			EnsureVisualLines();
+			const int first = next(60);
+			const LineRange range(first, Min(59, first + next(8)));
+			if (next(2) == 0)
+				HideLineRange(range);
+			else
+				ShowLineRange(range);
+			assert(IsVisualLineCacheCurrent());
+			const auto patched = mVisualLines;
+			const auto patchedMap = mDocumentToVisual;
+			SetHiddenLineRanges(mHiddenLineRanges);
+			EnsureVisualLines();
+			assert(sameVisualLines(patched, mVisualLines) && patchedMap == mDocumentToVisual);
+			for (size_t r = 1; r < mHiddenLineRanges.size(); ++r)
+				assert(mHiddenLineRanges[r].mStartLine > mHiddenLineRanges[r - 1].mEndLine + 1);
+		}
+		ClearGhostLines();
+		SetWordWrapEnabled(false);
+		mWrapColumn = prevWrapColumn;
+
+		// folding hides its folded lines through the same patches
+		SetText("int f() {\n\tif (a) {\n\t\tg();\n\t}\n\th();\n}\nint k;\n");
+		TextEditorCodeFolding folding;
+		folding.AnalyzeDocument(*this);
+		folding.SyncHiddenLines(*this);
+		assert(GetVisualLineCount() == GetLineCount());
+		assert(folding.Fold(1));
+		folding.SyncHiddenLines(*this);
+		assert(IsVisualLineCacheCurrent() && GetVisualLineCount() == GetLineCount() - 2);
+		assert(folding.Fold(0));
+		folding.SyncHiddenLines(*this);
+		assert(IsVisualLineCacheCurrent() && GetVisualLineCount() == 3 && GetDocumentLineForVisualLine(1) == 6);
+		assert(folding.Unfold(0));
+		folding.SyncHiddenLines(*this);
+		assert(IsVisualLineCacheCurrent() && GetVisualLineCount() == GetLineCount() - 2);
+		assert(GetDocumentLineForVisualLine(2) == 4 && folding.VisualLineToActualLine(2) == 4);
+		ClearHiddenLineRanges();
+	}
+
+	// --- Frame instrumentation --- //
+	{
+		const auto prevLanguage = GetLanguageDefinition();
+		SetLanguageDefinition(LanguageDefinitionId::Cpp);
+		std::string text;
+		for (int line = 0; line < 200; ++line)
+			text += "int value" + std::to_string(line) + " = 42; // Note\n";
+		SetText(text);
+		assert(!IsProfilingEnabled() && GetFrameStatsCount() == 0 && GetLastFrameStats() == nullptr);
+		BeginProfileFrame(nullptr);
+		EndProfileFrame(nullptr);
+		assert(GetFrameStatsCount() == 0);
+
+		// scopes and counters land in the frame they happened in
+		SetProfilingEnabled(true);
+		for (int frame = 0; frame < 3; ++frame)
+		{
+			BeginProfileFrame(nullptr);
+			{
+				ScopedProfileTimer const timer(*this, ProfileScope::Colorize);
+				ColorizeInternal();
+			}
+			(void)GetVisualLineCount();
+			EndProfileFrame(nullptr);
+		}
+		assert(GetFrameStatsCount() == 3 && GetLastFrameStats()->mFrame == 3);
+		const auto& first = GetFrameStats(0);
+		assert(first.mVisualLinesRebuilt == 201 && GetFrameStats(1).mVisualLinesRebuilt == 0);
+		assert(first.mLinesColorized > 0 && first.mEvents.size() == 3);
+		assert(first.mEvents[0].mScope == ProfileScope::Colorize && first.mEvents[1].mScope == ProfileScope::VisualLines);
+		assert(first.mEvents[2].mScope == ProfileScope::Frame && first.mEvents[2].mDurationMicroseconds >= first.mEvents[0].mDurationMicroseconds);
+		assert(GetFrameStats(2).mEvents.size() == 2);
+
+		const std::string trace = ExportChromeTrace();
+		assert(trace.rfind("{\"traceEvents\":[{", 0) == 0 && trace.back() == '}');
+		assert(trace.find("\"name\":\"VisualLines\"") != std::string::npos && trace.find("\"visualLinesRebuilt\":201") != std::string::npos);
+
+		// only the last frames are kept, oldest first
+		for (int frame = 0; frame < 400; ++frame)
+		{
+			BeginProfileFrame(nullptr);
+			EndProfileFrame(nullptr);
+		}
+		assert(GetFrameStatsCount() == 300 && GetFrameStats(0).mFrame == 104 && GetLastFrameStats()->mFrame == 403);
+
+		SetProfilingEnabled(false);
+		BeginProfileFrame(nullptr);
+		EndProfileFrame(nullptr);
+		assert(GetLastFrameStats()->mFrame == 403);
+		SetProfilingEnabled(true);
+		assert(GetFrameStatsCount() == 0);
+		SetProfilingEnabled(false);
+		SetLanguageDefinition(prevLanguage);
+	}
+
+	// --- TextEditorMinimap --- //
+	{
+		const auto sameSummaries = [](TextEditorMinimap& a, TextEditorMinimap& b, const TextEditor& editor) {
+			const auto& linesA = a.GetLineSummaries(editor);
+			const auto& linesB = b.GetLineSummaries(editor);
+			if (linesA.size() != linesB.size())
+				return false;
+			for (size_t i = 0; i < linesA.size(); ++i)
+			{
+				if (linesA[i].indent_columns != linesB[i].indent_columns || linesA[i].run_count != linesB[i].run_count)
+					return false;
+				for (std::uint32_t r = 0; r < linesA[i].run_count; ++r)
+				{
+					const auto& runA = a.GetRunPool()[linesA[i].first_run + r];
+					const auto& runB = b.GetRunPool()[linesB[i].first_run + r];
+					if (runA.start_column != runB.start_column || runA.length != runB.length || runA.color != runB.color)
+						return false;
+				}
+			}
+			return true;
+		};
+
+		const auto prevLanguage = GetLanguageDefinition();
+		SetLanguageDefinition(LanguageDefinitionId::None);
+		std::string text;
+		for (int line = 0; line < 200; ++line)
+			text += "\tint value" + std::to_string(line) + " = 42; // Note\n";
+		SetText(text);
+		TextEditorMinimap minimap;
+		assert(minimap.GetLineSummaries(*this).size() == 201 && minimap.GetLastSummarizedLineCount() == 201);
+		(void)minimap.GetLineSummaries(*this);
+		assert(minimap.GetLastSummarizedLineCount() == 0);
+
+		// an edit summarizes only the lines it touched
+		Coordinates where{ 100, 4 };
+		InsertTextAt(where, "\"s\"\n");
+		assert(minimap.GetLineSummaries(*this).size() == 202 && minimap.GetLastSummarizedLineCount() == 2);
+
+		// runs take the colors the editor draws
+		SetLanguageDefinition(LanguageDefinitionId::Cpp);
+		ColorizeInternal();
+		const auto& summaries = minimap.GetLineSummaries(*this);
+		const auto& first = summaries[0];
+		assert(first.indent_columns == 4 && first.run_count > 2);
+		assert(minimap.GetRunPool()[first.first_run].color == mPalette[(int)PaletteIndex::Keyword]);
+		assert(minimap.GetRunPool()[first.first_run + first.run_count - 1].color == mPalette[(int)PaletteIndex::Comment]);
+
+		// random edits give the same summaries as a fresh minimap
+		unsigned int seed = 4242;
+		const auto next = [&seed](int aRange) {
+			seed = seed * 1103515245u + 12345u;
+			return static_cast<int>((seed >> 16) % static_cast<unsigned int>(aRange));
+		};
+		const char* pieces[] = { "\n", "x", "  ", "\t", "// c", "\"s\"", "12", "int", "/*", "*/", "{\n}", "\n\n\n" };
+		for (int i = 0; i < 400; ++i)
+		{
+			const int line = next(GetLineCount());
+			Coordinates start{ line, next(GetLineMaxColumn(line) + 1) };
+			if (next(3) == 0)
+			{
+				const int endLine = Min(GetLineCount() - 1, line + next(3));
+				Coordinates end{ endLine, next(GetLineMaxColumn(endLine) + 1) };
+				if (end < start)
+					std::swap(start, end);
+				DeleteRange(start, end);
+			}
+			else
+				InsertTextAt(start, pieces[next(static_cast<int>(sizeof(pieces) / sizeof(pieces[0])))]);
+			if (next(2) == 0)
+				ColorizeInternal();
+			if (next(4) == 0)
+				continue;  // let some edits pile up
+			TextEditorMinimap reference;
+			assert(sameSummaries(minimap, reference, *this));
+		}
+
+		// dead runs are compacted away
+		const auto prevPalette = GetPalette();
+		for (int i = 0; i < 40; ++i)
+		{
+			SetPalette(i % 2 == 0 ? PaletteId::Light : PaletteId::Dark);
+			(void)minimap.GetLineSummaries(*this);
+		}
+		size_t liveRuns = 0;
+		for (const auto& summary : minimap.GetLineSummaries(*this))
+			liveRuns += summary.run_count;
+		assert(minimap.GetRunPool().size() <= 2 * liveRuns + 4096);
+		TextEditorMinimap reference;
+		assert(sameSummaries(minimap, reference, *this));
+		SetPalette(prevPalette);
+
+		// the texture path rasterizes only the rows of changed lines
+		int created = 0;
+		int destroyed = 0;
+		int uploadedRows = 0;
+		TextEditorMinimap::TextureHost host;
+		host.create = [&created](int, int) { return (ImTextureID)(intptr_t)++created; };
+		host.update = [&uploadedRows](ImTextureID, const ImU32*, int, int, int aRowCount) { uploadedRows += aRowCount; };
+		host.destroy = [&destroyed](ImTextureID) { ++destroyed; };
+
+		// a host that keeps what was uploaded, to see that no changed row is left out
+		std::vector<ImU32> texturePixels;
+		TextEditorMinimap::TextureHost mirrored = host;
+		mirrored.create = [&created, &texturePixels](int aWidth, int aHeight) {
+			texturePixels.assign(static_cast<size_t>(aWidth) * aHeight, 0xDEADBEEF);
+			return (ImTextureID)(intptr_t)++created;
+		};
+		mirrored.update = [&uploadedRows, &texturePixels](ImTextureID, const ImU32* aPixels, int aWidth, int aFirstRow, int aRowCount) {
+			uploadedRows += aRowCount;
+			std::copy(aPixels, aPixels + static_cast<size_t>(aWidth) * aRowCount, texturePixels.begin() + static_cast<size_t>(aFirstRow) * aWidth);
+		};
+		const auto uploaded = [&texturePixels](const TextEditorMinimap& aMinimap) {
+			return std::equal(aMinimap.GetPixels().begin(), aMinimap.GetPixels().end(), texturePixels.begin());
+		};
+
+		// the runs of a row's lines, later lines over earlier ones
+		const auto rasterized = [this](TextEditorMinimap& aMinimap) {
+			const auto& summaries = aMinimap.GetLineSummaries(*this);
+			const auto& rowLines = aMinimap.GetRowLines();
+			const int width = aMinimap.GetPixelWidth();
+			std::vector<ImU32> pixels(static_cast<size_t>(aMinimap.GetPixelRows()) * width, 0);
+			for (int row = 0; row < aMinimap.GetPixelRows(); ++row)
+			{
+				for (int line = rowLines[row]; line < rowLines[row + 1]; ++line)
+				{
+					const auto& summary = summaries[line];
+					const int baseX = static_cast<int>(static_cast<float>(summary.indent_columns) * 0.8f);
+					for (uint32_t r = 0; r < summary.run_count; ++r)
+					{
+						const auto& run = aMinimap.GetRunPool()[summary.first_run + r];
+						for (int x = baseX + run.start_column; x < Min(baseX + run.start_column + run.length, width); ++x)
+							pixels[static_cast<size_t>(row) * width + x] = run.color;
+					}
+				}
+			}
+			return pixels;
+		};
+		{
+			text.clear();
+			for (int line = 0; line < 300; ++line)
+				text += "\tint value" + std::to_string(line) + " = 42; // Note\n";
+			SetText(text);
+			ColorizeInternal();
+			TextEditorMinimap textured;
+			textured.SetTextureHost(mirrored);
+			(void)textured.UpdateTexture(*this, 100);
+			assert(created == 1 && uploadedRows == 301 && textured.GetLastRenderStats().rasterized_rows == 301);
+			(void)textured.UpdateTexture(*this, 100);
+			assert(textured.GetLastRenderStats().rasterized_rows == 0 && textured.GetLastRenderStats().uploaded_rows == 0);
+			where = { 10, 4 };
+			InsertTextAt(where, "x");
+			(void)textured.UpdateTexture(*this, 100);
+			assert(textured.GetLastRenderStats().rasterized_rows == 1 && textured.GetLastRenderStats().uploaded_rows == 1);
+			// rows below a new line move, but only those unlike the row they replace are uploaded:
+			// the split line, the row where the numbers get a third digit and the last two rows
+			where = { 20, 4 };
+			InsertTextAt(where, "\n");
+			(void)textured.UpdateTexture(*this, 100);
+			assert(textured.GetLastRenderStats().rasterized_rows == 2 && textured.GetLastRenderStats().uploaded_rows == 5);
+			assert(created == 1 && uploaded(textured));
+
+			// and gives the same pixels as a fresh rasterization, also when lines share rows
+			for (int maxRows : { 4096, 64 })
+			{
+				textured.GetConfig().max_texture_rows = maxRows;
+				for (int i = 0; i < 100; ++i)
+				{
+					const int line = next(GetLineCount());
+					Coordinates start{ line, next(GetLineMaxColumn(line) + 1) };
+					if (next(3) == 0)
+					{
+						const int endLine = Min(GetLineCount() - 1, line + next(3));
+						Coordinates end{ endLine, next(GetLineMaxColumn(endLine) + 1) };
+						if (end < start)
+							std::swap(start, end);
+						DeleteRange(start, end);
+					}
+					else
+						InsertTextAt(start, pieces[next(static_cast<int>(sizeof(pieces) / sizeof(pieces[0])))]);
+					if (next(2) == 0)
+						ColorizeInternal();
+					if (next(3) == 0)
+						(void)textured.GetLineSummaries(*this);  // let some changes reach the summaries first
+					(void)textured.UpdateTexture(*this, 100);
+					assert(textured.GetPixelRows() == Min(GetLineCount(), maxRows));
+					assert(textured.GetPixels() == rasterized(textured) && uploaded(textured));
+					const auto& rowLines = textured.GetRowLines();
+					assert(rowLines.front() == 0 && rowLines.back() == GetLineCount());
+					for (int row = 0; row < textured.GetPixelRows(); ++row)
+						assert(rowLines[row + 1] > rowLines[row]);
+					if (GetLineCount() > maxRows)
+						continue;
+					TextEditorMinimap fresh;
+					fresh.GetConfig().max_texture_rows = maxRows;
+					fresh.SetTextureHost(host);
+					(void)fresh.UpdateTexture(*this, 100);
+					assert(textured.GetPixels() == fresh.GetPixels());
+				}
+			}
+		}
+
+		// past max_texture_rows, lines move between shared rows without rasterizing the others again
+		{
+			text.clear();
+			for (int line = 0; line < 10000; ++line)
+				text += "\tint value" + std::to_string(line) + " = 42; // Note\n";
+			SetText(text);
+			ColorizeInternal();
+			TextEditorMinimap shared;
+			shared.SetTextureHost(mirrored);
+			(void)shared.UpdateTexture(*this, 100);
+			assert(shared.GetPixelRows() == 4096 && shared.GetLastRenderStats().uploaded_rows == 4096);
+			where = { 5000, 4 };
+			InsertTextAt(where, "x");
+			(void)shared.UpdateTexture(*this, 100);
+			assert(shared.GetLastRenderStats().rasterized_rows == 1 && shared.GetLastRenderStats().uploaded_rows == 1);
+			where = { 6000, 4 };
+			InsertTextAt(where, "\n");
+			(void)shared.UpdateTexture(*this, 100);
+			assert(shared.GetLastRenderStats().rasterized_rows == 1 && shared.GetLastRenderStats().uploaded_rows == 1);
+			assert(shared.GetRowLines().back() == GetLineCount() && shared.GetPixels() == rasterized(shared) && uploaded(shared));
+
+			// a row holding more than twice its share is evened out with its neighbours
+			for (int i = 0; i < 20; ++i)
+			{
+				where = { 3000, 0 };
+				InsertTextAt(where, "y\n");
+				(void)shared.UpdateTexture(*this, 100);
+				assert(shared.GetLastRenderStats().rasterized_rows <= 17 && shared.GetLastRenderStats().uploaded_rows <= 17);
+			}
+			DeleteRange({ 7000, 0 }, { 7100, 0 });
+			(void)shared.UpdateTexture(*this, 100);
+			assert(shared.GetLastRenderStats().rasterized_rows < 100 && shared.GetLastRenderStats().uploaded_rows < 100);
+			assert(shared.GetPixels() == rasterized(shared) && uploaded(shared));
+			for (int row = 0; row < shared.GetPixelRows(); ++row)
+				assert(shared.GetRowLines()[row + 1] > shared.GetRowLines()[row]);
+		}
+		assert(destroyed == created);
+
+		// the level-of-detail pyramid recomputes one row per level for an edit within a line
+		const auto lodMatchesRows = [](TextEditorMinimap& minimap, const TextEditor& editor) {
+			// Level 0 summarizes the lines of each row of the table, the levels above merge pairs
+			using Cell = TextEditorMinimap::LodCell;
+			constexpr int cellCount = TextEditorMinimap::kLodCells;
+			constexpr int columns = TextEditorMinimap::kLodCellColumns;
+			const auto& summaries = minimap.GetLineSummaries(editor);
+			const auto& rowLines = minimap.GetLodRowLines();
+			if (rowLines.back() != static_cast<int>(summaries.size()) || minimap.GetLodLevelCount() == 0)
+				return false;
+			std::vector<Cell> cells;
+			for (size_t row = 0; row + 1 < rowLines.size(); ++row)
+			{
+				std::uint64_t coverage[cellCount] = {};
+				std::uint64_t channels[cellCount][4] = {};
+				for (int line = rowLines[row]; line < rowLines[row + 1]; ++line)
+				{
+					const auto& summary = summaries[static_cast<size_t>(line)];
+					const int baseX = static_cast<int>(static_cast<float>(summary.indent_columns) * 0.8f);
+					for (std::uint32_t r = 0; r < summary.run_count; ++r)
+					{
+						const auto& run = minimap.GetRunPool()[summary.first_run + r];
+						const int runEnd = Min(baseX + run.start_column + run.length, cellCount * columns);
+						for (int x = baseX + run.start_column; x < runEnd; ++x)
+						{
+							++coverage[x / columns];
+							for (int channel = 0; channel < 4; ++channel)
+								channels[x / columns][channel] += (run.color >> (channel * 8)) & 0xFF;
+						}
+					}
+				}
+				for (int cell = 0; cell < cellCount; ++cell)
+				{
+					Cell value{};
+					value.coverage = static_cast<std::uint32_t>(coverage[cell]);
+					for (int channel = 0; coverage[cell] != 0 && channel < 4; ++channel)
+						value.color |= static_cast<ImU32>(channels[cell][channel] / coverage[cell]) << (channel * 8);
+					cells.push_back(value);
+				}
+			}
+			for (int level = 0;; ++level)
+			{
+				if (level >= minimap.GetLodLevelCount() || minimap.GetLodLevel(level).size() != cells.size())
+					return false;
+				for (size_t c = 0; c < cells.size(); ++c)
+				{
+					if (minimap.GetLodLevel(level)[c].coverage != cells[c].coverage || minimap.GetLodLevel(level)[c].color != cells[c].color)
+						return false;
+				}
+				if (cells.size() == cellCount)
+					return level + 1 == minimap.GetLodLevelCount();
+				std::vector<Cell> merged;
+				for (size_t c = 0; c < cells.size(); c += 2 * cellCount)
+				{
+					for (size_t cell = c; cell < c + cellCount; ++cell)
+					{
+						const Cell first = cells[cell];
+						const Cell second = cell + cellCount < cells.size() ? cells[cell + cellCount] : Cell{};
+						Cell value = second.coverage == 0 ? first : first.coverage == 0 ? second : Cell{};
+						if (first.coverage != 0 && second.coverage != 0)
+						{
+							value.coverage = first.coverage + second.coverage;
+							for (int shift = 0; shift < 32; shift += 8)
+							{
+								const std::uint64_t mixed = (((first.color >> shift) & 0xFF) * std::uint64_t{ first.coverage } + ((second.color >> shift) & 0xFF) * std::uint64_t{ second.coverage }) / value.coverage;
+								value.color |= static_cast<ImU32>(mixed) << shift;
+							}
+						}
+						merged.push_back(value);
+					}
+				}
+				cells = std::move(merged);
+			}
+		};
+		text.clear();
+		for (int line = 0; line < 1000; ++line)
+			text += std::string(static_cast<size_t>(line % 9), '\t') + "call(value" + std::to_string(line) + ", 42); // Note\n";
+		SetText(text);
+		ColorizeInternal();
+		TextEditorMinimap lod;
+		lod.UpdateLod(*this);
+		assert(lod.GetLodLevelCount() == 9 && lod.GetLodLevel(0).size() == 251 * TextEditorMinimap::kLodCells);
+		assert(lod.GetLodLevel(8).size() == TextEditorMinimap::kLodCells && lod.GetLodLevel(8)[0].coverage > 0);
+		where = { 500, 4 };
+		InsertTextAt(where, "x");
+		lod.UpdateLod(*this);
+		assert(lod.GetLastRenderStats().lod_rows == 9);
+		lod.UpdateLod(*this);
+		assert(lod.GetLastRenderStats().lod_rows == 0);
+
+		// inserted lines join the row of the edit instead of moving every row after it
+		InsertTextAt(where, "\n");
+		lod.UpdateLod(*this);
+		assert(lod.GetLastRenderStats().lod_rows == 9 && lod.GetLodRowLines()[126] == 505);
+		InsertTextAt(where, "a\nb\nc\nd\ne\nf\ng\nh\n");
+		lod.UpdateLod(*this);
+		assert(lod.GetLastRenderStats().lod_rows < 60 && lodMatchesRows(lod, *this));
+
+		// and gives the same cells as summarizing the rows of its table after random edits
+		for (int i = 0; i < 200; ++i)
+		{
+			const int line = next(GetLineCount());
+			Coordinates start{ line, next(GetLineMaxColumn(line) + 1) };
+			if (next(3) == 0)
+			{
+				const int endLine = Min(GetLineCount() - 1, line + next(40));
+				Coordinates end{ endLine, next(GetLineMaxColumn(endLine) + 1) };
+				if (end < start)
+					std::swap(start, end);
+				DeleteRange(start, end);
+			}
+			else
+				InsertTextAt(start, pieces[next(static_cast<int>(sizeof(pieces) / sizeof(pieces[0])))]);
+			if (next(2) == 0)
+				ColorizeInternal();
+			if (next(3) == 0)
+				(void)lod.GetLineSummaries(*this);
+			if (next(4) == 0)
+				continue;
+			lod.UpdateLod(*this);
+			assert(lodMatchesRows(lod, *this));
+		}
+		size_t coveredColumns = 0;
+		for (const auto& summary : lod.GetLineSummaries(*this))
+		{
+			const int baseX = static_cast<int>(static_cast<float>(summary.indent_columns) * 0.8f);
+			for (std::uint32_t r = 0; r < summary.run_count; ++r)
+			{
+				const auto& run = lod.GetRunPool()[summary.first_run + r];
+				const int limit = TextEditorMinimap::kLodCells * TextEditorMinimap::kLodCellColumns;
+				coveredColumns += static_cast<size_t>(Max(0, Min(baseX + run.start_column + run.length, limit) - Max(baseX + run.start_column, 0)));
+			}
+		}
+		size_t topCoverage = 0;
+		for (const auto& cell : lod.GetLodLevel(lod.GetLodLevelCount() - 1))
+			topCoverage += cell.coverage;
+		assert(topCoverage == coveredColumns);
+		SetLanguageDefinition(prevLanguage);
+	}
+
+	// --- TextEditorAutocomplete --- //
+	{
+		// delivers when the test says so, like a language server would
+		struct DeferredProvider : TextEditorAutocomplete::ICompletionProvider
+		{
+			std::vector<std::pair<TextEditorAutocomplete::CancellationToken, TextEditorAutocomplete::CompletionCallback>> requests;
+
+			void GetCompletionsAsync(const TextEditor&, int, int, char, const TextEditorAutocomplete::CancellationToken& aToken,
+				const TextEditorAutocomplete::CompletionCallback& aDone) override
+			{
+				requests.emplace_back(aToken, aDone);
+			}
+			std::vector<char> GetTriggerCharacters() const override { return {}; }
+		};
+		const auto makeItems = [](std::initializer_list<const char*> aLabels, int aPriority) {
+			std::vector<TextEditorAutocomplete::CompletionItem> items;
+			for (const char* label : aLabels)
+			{
+				items.emplace_back(label);
+				items.back().priority = aPriority;
+			}
+			return items;
+		};
+
+		SetText("int x;\n");
+		TextEditorAutocomplete autocomplete;
+		auto deferred = std::make_unique<DeferredProvider>();
+		DeferredProvider& server = *deferred;
+		autocomplete.RegisterProvider(std::make_unique<KeywordCompletionProvider>(std::vector<std::string>{ "int", "if" }));
+		autocomplete.RegisterProvider(std::move(deferred));
+
+		// quick providers show at once, slow ones join when they deliver
+		autocomplete.Trigger(*this);
+		assert(autocomplete.IsActive() && autocomplete.IsPending() && autocomplete.GetFilteredItemCount() == 2);
+		assert(server.requests.size() == 1 && !server.requests[0].first.IsCancelled());
+		std::thread worker([&server, &makeItems] { server.requests[0].second(makeItems({ "value", "vector" }, 80)); });
+		worker.join();
+		assert(autocomplete.PollCompletions() && !autocomplete.IsPending());
+		assert(autocomplete.GetFilteredItemCount() == 4 && autocomplete.GetFilteredItem(0).label == "value");
+
+		// a new trigger cancels the pending request and drops its late items
+		autocomplete.Trigger(*this);
+		autocomplete.Trigger(*this);
+		assert(server.requests.size() == 3 && server.requests[1].first.IsCancelled() && !server.requests[2].first.IsCancelled());
+		server.requests[1].second(makeItems({ "stale" }, 100));
+		assert(!autocomplete.PollCompletions() && autocomplete.GetFilteredItemCount() == 2);
+		server.requests[2].second(makeItems({ "fresh" }, 100));
+		assert(autocomplete.PollCompletions() && autocomplete.GetFilteredItem(0).label == "fresh");
+
+		// closing cancels as well
+		autocomplete.Trigger(*this);
+		autocomplete.Close();
+		assert(server.requests[3].first.IsCancelled());
+		server.requests[3].second(makeItems({ "late" }, 100));
+		assert(!autocomplete.PollCompletions() && !autocomplete.IsActive());
+
+		// word starts and consecutive matches beat scattered ones
+		using Autocomplete = TextEditorAutocomplete;
+		assert(Autocomplete::ScoreFuzzyMatch("FooBar", "fb") > Autocomplete::ScoreFuzzyMatch("xfxxb", "fb"));
+		assert(Autocomplete::ScoreFuzzyMatch("get_value", "gv") > Autocomplete::ScoreFuzzyMatch("gravel", "gv"));
+		assert(Autocomplete::ScoreFuzzyMatch("value", "val") > Autocomplete::ScoreFuzzyMatch("interval", "val"));
+		assert(Autocomplete::ScoreFuzzyMatch("vector", "vcr") >= 0 && Autocomplete::ScoreFuzzyMatch("vector", "vrc") < 0);
+		assert(Autocomplete::ScoreFuzzyMatch("ab", "abc") < 0 && Autocomplete::ScoreFuzzyMatch("abc", "") == 0);
+
+		// filtering keeps the best max_items of a large list, in score order
+		std::vector<std::string> words;
+		for (int i = 0; i < 30000; ++i)
+			words.push_back((i % 3 == 0 ? "get" : i % 3 == 1 ? "set" : "reset") + std::string(i % 2 == 0 ? "Value" : "_value_") + std::to_string(i));
+		TextEditorAutocomplete large;
+		large.GetConfig().max_items = 25;
+		large.RegisterProvider(std::make_unique<KeywordCompletionProvider>(words));
+		large.Trigger(*this);
+		assert(large.GetFilteredItemCount() == 25);
+		large.SetFilterText("sv1");
+		std::vector<int> bestScores;
+		for (const auto& word : words)
+		{
+			const int score = Autocomplete::ScoreFuzzyMatch(word, "sv1");
+			if (score >= 0)
+				bestScores.push_back(score);
+		}
+		std::sort(bestScores.begin(), bestScores.end(), std::greater<int>());
+		assert(large.GetFilteredItemCount() == 25);
+		for (int i = 0; i < 25; ++i)
+			assert(Autocomplete::ScoreFuzzyMatch(large.GetFilteredItem(i).label, "sv1") == bestScores[static_cast<size_t>(i)]);
+		large.SetFilterText("zzz");
+		assert(large.GetFilteredItemCount() == 0 && !large.IsActive());
+
+		// typing narrows the previous matches, a backspace rescores everything
+		for (int i = 30000; i < 50000; ++i)
+			words.push_back("item" + std::to_string(i));
+		TextEditorAutocomplete typing;
+		typing.GetConfig().max_items = 25;
+		typing.RegisterProvider(std::make_unique<KeywordCompletionProvider>(words));
+		const auto sameAsFullFilter = [this, &words](const TextEditorAutocomplete& aTyped, const std::string& aFilter) {
+			TextEditorAutocomplete reference;
+			reference.GetConfig().max_items = 25;
+			reference.RegisterProvider(std::make_unique<KeywordCompletionProvider>(words));
+			reference.Trigger(*this);
+			reference.SetFilterText(aFilter);
+			if (reference.GetFilteredItemCount() != aTyped.GetFilteredItemCount())
+				return false;
+			for (int i = 0; i < reference.GetFilteredItemCount(); ++i)
+			{
+				if (reference.GetFilteredItem(i).label != aTyped.GetFilteredItem(i).label)
+					return false;
+			}
+			return true;
+		};
+		typing.Trigger(*this);
+		std::string typed;
+		int previousScored = 50001;
+		for (const char c : std::string("getVal12"))
+		{
+			typed += c;
+			typing.SetFilterText(typed);
+			assert(typing.GetLastScoredItemCount() <= previousScored);
+			previousScored = typing.GetLastScoredItemCount();
+			assert(sameAsFullFilter(typing, typed));
+		}
+		assert(previousScored < 50000 / 3);
+		typed.pop_back();
+		typing.SetFilterText(typed);
+		assert(typing.GetLastScoredItemCount() == 50000 && sameAsFullFilter(typing, typed));
+
+		// the keyword index finds words by prefix ignoring case
+		std::vector<std::string> vocabulary;
+		for (int i = 0; i < 100000; ++i)
+			vocabulary.push_back((i % 4 == 0 ? "Print" : i % 4 == 1 ? "print" : i % 4 == 2 ? "priority" : "value") + std::to_string(i));
+		const KeywordCompletionProvider index(vocabulary);
+		assert(index.GetWordCount() == 100000);
+		for (int i = 1; i < index.GetWordCount(); ++i)
+			assert(index.GetWord(i - 1) != index.GetWord(i));
+		for (const char* prefix : { "", "p", "PRI", "print1", "Print99996", "priority9", "v", "w", "a" })
+		{
+			const auto [first, last] = index.FindPrefixRange(prefix);
+			int expected = 0;
+			for (const auto& word : vocabulary)
+			{
+				const std::string head = word.substr(0, std::strlen(prefix));
+				expected += std::equal(head.begin(), head.end(), prefix, prefix + std::strlen(prefix),
+					[](char a, char b) { return std::tolower(a) == std::tolower(b); }) && head.size() == std::strlen(prefix) ? 1 : 0;
+			}
+			assert(last - first == expected);
+		}
+
+		// only the words starting with the identifier before the cursor are offered, and accepting replaces it
+		SetText("x = prio");
+		SetCursorPosition(0, 8);
+		TextEditorAutocomplete keywords;
+		keywords.RegisterProvider(std::make_unique<KeywordCompletionProvider>(vocabulary));
+		keywords.Trigger(*this);
+		assert(keywords.IsActive() && keywords.GetFilteredItemCount() == keywords.GetConfig().max_items);
+		for (int i = 0; i < keywords.GetFilteredItemCount(); ++i)
+			assert(keywords.GetFilteredItem(i).label.compare(0, 8, "priority") == 0);
+		keywords.SetFilterText("priority122");
+		assert(keywords.GetFilteredItem(0).label == "priority122");
+		const auto accepted = keywords.AcceptSelected(*this);
+		assert(accepted && GetText() == "x = priority122");
+
+		// the document word index follows edits and matches a recount of the text
+		const auto countWords = [](const std::string& aText) {
+			std::map<std::string, int> counts;
+			std::string word;
+			for (size_t i = 0; i <= aText.size(); ++i)
+			{
+				const char c = i < aText.size() ? aText[i] : ' ';
+				if (std::isalnum(static_cast<unsigned char>(c)) || c == '_')
+				{
+					word += c;
+					continue;
+				}
+				if (word.size() >= 3 && !std::isdigit(static_cast<unsigned char>(word[0])))
+					++counts[word];
+				word.clear();
+			}
+			return counts;
+		};
+		const auto sameAsRecount = [&countWords](const DocumentWordIndex& aIndex, const std::string& aText) {
+			const auto counts = countWords(aText);
+			if (aIndex.GetDistinctWordCount() != static_cast<int>(counts.size()))
+				return false;
+			for (const auto& [word, count] : counts)
+			{
+				if (aIndex.GetCount(word) != count)
+					return false;
+			}
+			return true;
+		};
+		std::string source;
+		for (int line = 0; line < 300; ++line)
+			source += "int count" + std::to_string(line % 7) + " = value_" + std::to_string(line % 13) + " + 12abc;\n";
+		SetText(source);
+		const auto wordIndex = std::make_shared<DocumentWordIndex>();
+		wordIndex->Update(*this);
+		assert(wordIndex->GetLastReadLineCount() == 301 && sameAsRecount(*wordIndex, GetText()));
+		unsigned int seed = 4545;
+		const auto next = [&seed](int aRange) {
+			seed = seed * 1103515245u + 12345u;
+			return static_cast<int>((seed >> 16) % static_cast<unsigned int>(aRange));
+		};
+		Coordinates typedAt{ 150, 0 };
+		InsertTextAt(typedAt, "Counter ");
+		wordIndex->Update(*this);
+		assert(wordIndex->GetLastReadLineCount() == 1 && wordIndex->GetCount("Counter") == 1);
+		const char* wordPieces[] = { "\n", "x", " ", "count", "Count1", "_tmp", "42", "value_3", "\n\n", "abc def" };
+		for (int i = 0; i < 300; ++i)
+		{
+			const int line = next(GetLineCount());
+			Coordinates start{ line, next(GetLineMaxColumn(line) + 1) };
+			if (next(3) == 0)
+			{
+				const int endLine = Min(GetLineCount() - 1, line + next(3));
+				Coordinates end{ endLine, next(GetLineMaxColumn(endLine) + 1) };
+				if (end < start)
+					std::swap(start, end);
+				DeleteRange(start, end);
+			}
+			else
+				InsertTextAt(start, wordPieces[next(static_cast<int>(sizeof(wordPieces) / sizeof(wordPieces[0])))]);
+			if (next(4) == 0)
+			{
+				wordIndex->Update(*this);
+				assert(sameAsRecount(*wordIndex, GetText()));
+			}
+		}
+		wordIndex->Update(*this);
+		assert(sameAsRecount(*wordIndex, GetText()));
+
+		// a second editor shares the index until it is removed
+		TextEditor other;
+		other.SetText("zeta_one zeta_one beta\ncount0");
+		wordIndex->Update(other);
+		assert(sameAsRecount(*wordIndex, GetText() + "\n" + other.GetText()));
+		std::vector<std::pair<std::string_view, int>> found;
+		wordIndex->FindPrefix("ZETA", 10, found);
+		assert(found.size() == 1 && found[0].first == "zeta_one" && found[0].second == 2);
+		wordIndex->RemoveEditor(other);
+		assert(wordIndex->GetCount("zeta_one") == 0 && sameAsRecount(*wordIndex, GetText()));
+
+		// a short prefix looks at max_words words however many match
+		std::string manyWords = "itemTop itemTop itemTop iterate iterate\n";
+		for (int i = 0; i < 5000; ++i)
+			manyWords += "item" + std::to_string(i) + "\n";
+		other.SetText(manyWords);
+		DocumentWordIndex manyIndex;
+		manyIndex.Update(other);
+		manyIndex.FindPrefix("i", 2, found);
+		assert(found.size() == 2 && found[0].first == "itemTop" && found[1].first == "iterate");
+		assert(manyIndex.GetLastVisitedWordCount() == 2);
+		manyIndex.FindPrefix("item", 2, found);
+		assert(found.size() == 2 && found[1].first == "item0" && manyIndex.GetLastVisitedWordCount() <= 6);
+		manyIndex.FindPrefix("iter", 10, found);
+		assert(found.size() == 1 && found[0].second == 2 && manyIndex.GetLastVisitedWordCount() <= 4);
+		manyIndex.RemoveEditor(other);
+
+		// the provider offers the words starting with the identifier before the cursor, most frequent first
+		SetText("fooBar fooBar fooBar\nfoobaz foo_qux\n\nfo");
+		SetCursorPosition(3, 2);
+		TextEditorAutocomplete documentWords;
+		documentWords.RegisterProvider(std::make_unique<DocumentWordCompletionProvider>(wordIndex));
+		documentWords.Trigger(*this);
+		assert(documentWords.IsActive() && documentWords.GetFilteredItemCount() == 3);
+		assert(documentWords.GetFilteredItem(0).label == "fooBar");
+		const auto acceptedWord = documentWords.AcceptSelected(*this);
+		assert(acceptedWord && GetText() == "fooBar fooBar fooBar\nfoobaz foo_qux\n\nfooBar");
+	}
+
+	// --- TextEditorSearchSession --- //
+	{
+		SetText("foo foobar\nbar foo\nfoofoo");
+		TextEditorSearchSession search;
+		assert(search.Update(*this, "foo") == 5 && search.GetLastScannedLineCount() == 3);
+		// extending the query only re-checks previous matches
+		assert(search.Update(*this, "foob") == 1 && search.GetLastScannedLineCount() == 0);
+		assert(search.GetLastRefinedMatchCount() == 5);
+		// edits only rescan the changed lines
+		Coordinates where{ 1, 0 };
+		InsertTextAt(where, "foob ");
+		assert(search.Update(*this, "foob") == 2 && search.GetLastScannedLineCount() == 1);
+		assert(search.GetMatches()[1].line == 1 && search.GetMatches()[1].char_index == 0);
+		assert(search.FindNextMatch(0, 5) == 1 && search.FindNextMatch(2, 0) == 0);
+		// changing case sensitivity starts over
+		assert(search.Update(*this, "FOO", false) == 6 && search.GetLastScannedLineCount() == 3);
+		// matches spanning lines follow inserted lines
+		assert(search.Update(*this, "foo\nfoo") == 1 && search.GetMatches()[0].line == 1);
+		where = { 0, 0 };
+		InsertTextAt(where, "x\n");
+		assert(search.Update(*this, "foo\nfoo") == 1 && search.GetLastScannedLineCount() == 2);
+		const auto& match = search.GetMatches()[0];
+		assert(match.line == 2 && match.char_index == 9 && match.end_line == 3 && match.end_char_index == 3);
+	}
+
+	// --- TextEditorTrigramIndex --- //
+	{
+		SetText("error: disk full\ninfo: ok\nERROR: net down\nwarning: disk slow\ninfo: done");
+		TextEditorTrigramIndex index;
+		index.Update(*this);
+		index.WaitForBuild();
+		assert(!index.IsReadyFor(*this));  // only read-only documents are indexed
+
+		SetReadOnlyEnabled(true);
+		index.Update(*this);
+		index.WaitForBuild();
+		assert(index.IsReadyFor(*this) && index.GetStats().line_count == 5);
+
+		std::vector<int> lines;
+		assert(index.QueryLiteral("error", lines) && lines == std::vector<int>({0, 2}));
+		assert(index.QueryLiteral("disk", lines) && lines == std::vector<int>({0, 3}));
+		assert(index.QueryLiteral("ok\nERR", lines) && lines == std::vector<int>({1}));
+		assert(index.QueryLiteral("zzz", lines) && lines.empty());
+		assert(!index.QueryLiteral("ok", lines));
+		assert(index.QueryRegex("disk (full|slow)", lines) && lines == std::vector<int>({0, 3}));
+		assert(index.QueryRegex("info: \\w+", lines) && lines == std::vector<int>({1, 4}));
+		assert(!index.QueryRegex("full|slow", lines));
+		// an optional multibyte atom is dropped whole, a leading ']' belongs to its class
+		assert(index.QueryRegex("dis\xC3\xA9?k ", lines) && lines == std::vector<int>({0, 3}));
+		assert(index.QueryRegex("[]x]disk", lines) && lines == std::vector<int>({0, 3}));
+		assert(index.QueryRegex("[^]]disk", lines) && lines == std::vector<int>({0, 3}));
+
+		// full scans only look at candidate lines
+		TextEditorSearchSession search;
+		search.SetIndex(&index);
+		assert(search.Update(*this, "disk") == 2 && search.GetLastScannedLineCount() == 2);
+		assert(search.UpdateRegex(*this, "d[a-z]+n", false) == 2 && search.GetLastScannedLineCount() == 5);
+		assert(search.UpdateRegex(*this, "(error|warning):", false) == 3);
+		assert(search.UpdateRegex(*this, "(") == 0 && !search.IsRegexValid());
+
+		SetReadOnlyEnabled(false);
+		Coordinates where{ 1, 0 };
+		InsertTextAt(where, "disk ");
+		assert(!index.IsReadyFor(*this));
+		assert(search.Update(*this, "disk") == 3 && search.GetLastScannedLineCount() == 5);
+		index.Update(*this);
+		assert(index.GetStats().line_count == 0);
+	}
+
 	// --- Coordinate Round Trip --- //
 	{
 		const ImVec2 prev_screen_pos = mEditorScreenPos;
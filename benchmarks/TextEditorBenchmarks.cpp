@@ -0,0 +1,700 @@
+// Headless benchmarks for the editor core.
+//
+// Runs every benchmark at several document sizes inside an ImGui context without a
+// platform or renderer backend, and writes the results as JSON. Build it next to the
+// editor sources and Dear ImGui, e.g. from the repository root
+//
+//   c++ -std=c++20 -O2 -I. -I<imgui> benchmarks/TextEditorBenchmarks.cpp TextEditor*.cpp
+//       LanguageDefinitions.cpp ImGuiDebugPanel.cpp UnitTests.cpp <imgui>/imgui*.cpp
+//       -lboost_regex -o text_editor_benchmarks
+//
+// Usage: text_editor_benchmarks [--max-lines N] [--filter TEXT] [--min-time SECONDS] [--output FILE]
+// Results go to stdout unless --output is given (bench_output.txt is ignored by git). Some results
+// carry a "counters" object with figures other than time, such as lookups per second or memory.
+
+#include "TextEditor.h"
+#include "TextEditorAutocomplete.hpp"
+#include "TextEditorBracketMatcher.hpp"
+#include "TextEditorCodeFolding.hpp"
+#include "TextEditorMinimap.hpp"
+#include "TextEditorSearch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Reaches the editor internals the benchmarks drive directly
+class text_editor_benchmark_peer
+{
+public:
+	static void Type(TextEditor& aEditor, const char* aText)
+	{
+		for (const char* c = aText; *c != '\0'; ++c)
+			aEditor.EnterCharacter(static_cast<ImWchar>(*c), false);
+	}
+
+	static void ColorizeAll(TextEditor& aEditor)
+	{
+		aEditor.Colorize();
+		while (aEditor.mCheckComments || aEditor.mColorRangeMin < aEditor.mColorRangeMax)
+			aEditor.ColorizeInternal();
+	}
+
+	static bool IsTokenized(const TextEditor& aEditor)
+	{
+		return aEditor.mLanguageDefinition != nullptr && aEditor.mLanguageDefinition->mTokenize != nullptr;
+	}
+
+	static int RebuildVisualLines(TextEditor& aEditor, int aWrapColumn)
+	{
+		// Looks like a content change to the visual line cache
+		++aEditor.mLinesRevision;
+		aEditor.mWrapColumn = aWrapColumn;
+		aEditor.EnsureVisualLines();
+		return aEditor.GetVisualLineCount();
+	}
+};
+
+namespace
+{
+using Peer = text_editor_benchmark_peer;
+
+struct Options
+{
+	int mMaxLines = 1000000;
+	std::string mFilter;
+	double mMinSeconds = 0.25;
+	std::string mOutput;
+};
+
+struct Result
+{
+	std::string mName;
+	std::string mVariant;
+	int mLines = 0;
+	int mIterations = 0;
+	double mMeanMs = 0.0;
+	double mMedianMs = 0.0;
+	double mMinMs = 0.0;
+	double mMaxMs = 0.0;
+	// Extra figures a benchmark reports next to its timings, e.g. throughput or memory
+	std::vector<std::pair<std::string, double>> mCounters;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Repeats aSetup (untimed) and aBody (timed) until enough time was measured, or until slow
+// setups have taken ten times that long
+template <typename Setup, typename Body>
+Result Measure(const Options& aOptions, const std::string& aName, const std::string& aVariant, int aLines,
+	Setup&& aSetup, Body&& aBody)
+{
+	constexpr int maxIterations = 1000;
+	constexpr double maxSeconds = 20.0;
+	std::vector<double> samples;
+	double total = 0.0;
+	const auto began = Clock::now();
+	const auto elapsed = [&began] { return std::chrono::duration<double>(Clock::now() - began).count(); };
+	while (samples.empty() ||
+		(total < aOptions.mMinSeconds && static_cast<int>(samples.size()) < maxIterations &&
+			elapsed() < 10.0 * aOptions.mMinSeconds) ||
+		(samples.size() < 3 && total < maxSeconds))
+	{
+		aSetup();
+		const auto start = Clock::now();
+		aBody();
+		const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		samples.push_back(seconds * 1000.0);
+		total += seconds;
+	}
+
+	Result result;
+	result.mName = aName;
+	result.mVariant = aVariant;
+	result.mLines = aLines;
+	result.mIterations = static_cast<int>(samples.size());
+	std::sort(samples.begin(), samples.end());
+	for (const double sample : samples)
+		result.mMeanMs += sample;
+	result.mMeanMs /= static_cast<double>(samples.size());
+	result.mMedianMs = samples[samples.size() / 2];
+	result.mMinMs = samples.front();
+	result.mMaxMs = samples.back();
+	std::fprintf(stderr, "%-28s %-12s %8d lines %6d its %12.3f ms\n", aName.c_str(), aVariant.c_str(), aLines,
+		result.mIterations, result.mMedianMs);
+	return result;
+}
+
+void AddCounter(Result& aResult, const char* aName, double aValue)
+{
+	aResult.mCounters.emplace_back(aName, aValue);
+	std::fprintf(stderr, "%-28s %-12s %28s %12.1f\n", "", "", aName, aValue);
+}
+
+// Resident set size in bytes, or -1 where /proc is not available
+long ResidentBytes()
+{
+	std::ifstream statm("/proc/self/statm");
+	long pages = 0;
+	long resident = 0;
+	if (!(statm >> pages >> resident))
+		return -1;
+	return resident * 4096;
+}
+
+// C-like source with comments, strings and a rare "needle" identifier every 1000 lines
+std::string MakeDocument(int aLines)
+{
+	std::string text;
+	text.reserve(static_cast<std::size_t>(aLines) * 40);
+	char line[160];
+	for (int i = 0; i < aLines; ++i)
+	{
+		switch (i % 8)
+		{
+		case 0: std::snprintf(line, sizeof(line), "int value%d = compute(%d, \"text %d\"); // note\n", i, i % 97, i); break;
+		case 1: std::snprintf(line, sizeof(line), "\tif (value%d > 42 && flag_%d)\n", i - 1, i % 13); break;
+		case 2: std::snprintf(line, sizeof(line), "\t{\n"); break;
+		case 3: std::snprintf(line, sizeof(line), "\t\tresult += %s%d * 3.5f; /* scaled */\n", i % 1000 == 3 ? "needle" : "value", i); break;
+		case 4: std::snprintf(line, sizeof(line), "\t}\n"); break;
+		case 5: std::snprintf(line, sizeof(line), "#define MACRO_%d(x) ((x) + %d)\n", i, i % 7); break;
+		case 6: std::snprintf(line, sizeof(line), "\n"); break;
+		default: std::snprintf(line, sizeof(line), "std::string name%d = 'c' + std::to_string(%d);\n", i, i); break;
+		}
+		text += line;
+	}
+	return text;
+}
+
+// Indentation that a per-line look-ahead handles in quadratic time. A staircase climbs aDepth
+// levels once and keeps the rest of the document at the deepest level, so each step's block
+// spans the whole body. A sawtooth climbs aDepth levels over and over.
+std::string MakeStaircase(int aLines, int aDepth, bool aSawtooth)
+{
+	std::string text;
+	for (int i = 0; i < aLines; ++i)
+	{
+		const int depth = aSawtooth ? i % aDepth : std::min(i, aDepth);
+		text.append(static_cast<std::size_t>(depth), '\t');
+		text += i < aDepth || aSawtooth ? "block:\n" : "key: value\n";
+	}
+	return text;
+}
+
+// One ImGui frame holding the editor in a fixed-size window
+void RenderFrame(TextEditor& aEditor)
+{
+	ImGui::NewFrame();
+	ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+	ImGui::SetNextWindowSize(ImVec2(1600.0f, 1000.0f));
+	ImGui::Begin("Benchmark", nullptr, ImGuiWindowFlags_NoDecoration);
+	aEditor.Render("##editor", true);
+	ImGui::End();
+	ImGui::Render();
+}
+
+// One ImGui frame holding only a minimap, as tall as the editor window of RenderFrame
+void MinimapFrame(TextEditor& aEditor, TextEditorMinimap& aMinimap)
+{
+	ImGui::NewFrame();
+	ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+	ImGui::SetNextWindowSize(ImVec2(200.0f, 1000.0f));
+	ImGui::Begin("Minimap", nullptr, ImGuiWindowFlags_NoDecoration);
+	(void)aMinimap.Render(aEditor, ImVec2(120.0f, 1000.0f));
+	ImGui::End();
+	ImGui::Render();
+}
+
+// Draw list work of the last frame, as ImGui submitted it and as the minimap counted it
+void AddDrawCounters(Result& aResult, const TextEditorMinimap& aMinimap)
+{
+	const ImDrawData* data = ImGui::GetDrawData();
+	int drawCalls = 0;
+	for (int i = 0; i < data->CmdListsCount; ++i)
+		drawCalls += data->CmdLists[i]->CmdBuffer.Size;
+	AddCounter(aResult, "draw_calls", drawCalls);
+	AddCounter(aResult, "vertices", data->TotalVtxCount);
+	AddCounter(aResult, "quads", aMinimap.GetLastRenderStats().quads);
+}
+
+void WriteJson(std::ostream& aOut, const std::vector<Result>& aResults)
+{
+	aOut << "{\n  \"schema\": 1,\n  \"benchmarks\": [\n";
+	char line[512];
+	for (std::size_t i = 0; i < aResults.size(); ++i)
+	{
+		const auto& r = aResults[i];
+		std::snprintf(line, sizeof(line),
+			"    {\"name\": \"%s\", \"variant\": \"%s\", \"lines\": %d, \"iterations\": %d, "
+			"\"mean_ms\": %.6f, \"median_ms\": %.6f, \"min_ms\": %.6f, \"max_ms\": %.6f",
+			r.mName.c_str(), r.mVariant.c_str(), r.mLines, r.mIterations,
+			r.mMeanMs, r.mMedianMs, r.mMinMs, r.mMaxMs);
+		aOut << line;
+		if (!r.mCounters.empty())
+		{
+			aOut << ", \"counters\": {";
+			for (std::size_t c = 0; c < r.mCounters.size(); ++c)
+			{
+				std::snprintf(line, sizeof(line), "%s\"%s\": %.3f", c > 0 ? ", " : "",
+					r.mCounters[c].first.c_str(), r.mCounters[c].second);
+				aOut << line;
+			}
+			aOut << "}";
+		}
+		aOut << (i + 1 < aResults.size() ? "},\n" : "}\n");
+	}
+	aOut << "  ]\n}\n";
+}
+
+bool ParseOptions(int argc, char** argv, Options& aOptions)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--max-lines") == 0 && hasValue)
+			aOptions.mMaxLines = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--filter") == 0 && hasValue)
+			aOptions.mFilter = argv[++i];
+		else if (std::strcmp(argv[i], "--min-time") == 0 && hasValue)
+			aOptions.mMinSeconds = std::atof(argv[++i]);
+		else if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+			aOptions.mOutput = argv[++i];
+		else
+			return false;
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: %s [--max-lines N] [--filter TEXT] [--min-time SECONDS] [--output FILE]\n", argv[0]);
+		return 2;
+	}
+
+	// Null backend: a display size and a built font atlas are all NewFrame() needs
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+	io.DeltaTime = 1.0f / 60.0f;
+	io.IniFilename = nullptr;
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+	std::vector<Result> results;
+	const auto wanted = [&options](const char* aName) {
+		return options.mFilter.empty() || std::strstr(aName, options.mFilter.c_str()) != nullptr;
+	};
+
+	if (wanted("Brackets"))
+	{
+		// 12 brackets on each of 83334 lines give 1M brackets. This runs first so the resident set
+		// growth during the analysis is not hidden by memory freed from earlier benchmarks.
+		const int lines = 83334;
+		if (lines <= options.mMaxLines)
+		{
+			std::string text;
+			text.reserve(static_cast<std::size_t>(lines) * 26);
+			for (int i = 0; i < lines; ++i)
+				text += "\tf(a[1], {b(c)}, d[(e)]);\n";
+			TextEditor editor;
+			editor.SetText(text);
+
+			auto matcher = std::make_unique<TextEditorBracketMatcher>();
+			const long before = ResidentBytes();
+			matcher->AnalyzeDocument(editor);
+			const long after = ResidentBytes();
+
+			// GetBracketColor on every column of every line, brackets or not
+			const int columns = 26;
+			long hits = 0;
+			Result lookups = Measure(options, "Brackets", "lookups", lines, [&] { hits = 0; }, [&] {
+				for (int line = 0; line < lines; ++line)
+					for (int column = 0; column < columns; ++column)
+						hits += matcher->GetBracketColor(line, column).has_value();
+			});
+			AddCounter(lookups, "brackets", static_cast<double>(hits));
+			AddCounter(lookups, "lookups_per_s", lines * columns / (lookups.mMedianMs / 1000.0));
+			if (before >= 0 && after >= 0)
+				AddCounter(lookups, "analysis_rss_mb", static_cast<double>(after - before) / 1e6);
+			results.push_back(std::move(lookups));
+
+			// A new line mid-document moves the lines below it, set up untimed
+			Result newline = Measure(options, "Brackets", "newline", lines,
+				[&] {
+					if (editor.CanUndo())
+						editor.Undo();
+					matcher->AnalyzeDocument(editor);
+					editor.SetCursorPosition(lines / 2, 1);
+					Peer::Type(editor, "\n");
+				},
+				[&] { matcher->AnalyzeDocument(editor); });
+			AddCounter(newline, "paired_lines", matcher->GetLastPairedLineCount());
+			results.push_back(std::move(newline));
+
+			results.push_back(Measure(options, "Brackets", "analyze", lines,
+				[&] { matcher = std::make_unique<TextEditorBracketMatcher>(); },
+				[&] { matcher->AnalyzeDocument(editor); }));
+		}
+	}
+
+	if (wanted("FoldQueries"))
+	{
+		// 100k regions, every tenth one nesting the next eight, a third of them folded
+		const int lines = 300030;
+		if (lines <= options.mMaxLines)
+		{
+			std::vector<TextEditorCodeFolding::FoldRegion> regions;
+			for (int i = 0; i < 100000; ++i)
+			{
+				TextEditorCodeFolding::FoldRegion region;
+				region.start_line = i % 10 == 0 ? 3 * i + 1 : 3 * i;
+				region.end_line = region.start_line + (i % 10 == 0 ? 25 : 2);
+				region.is_folded = i % 3 == 0;
+				regions.push_back(region);
+			}
+			TextEditorCodeFolding folding;
+			folding.SetFoldRegions(regions);
+			int visibleLines = 0;
+			for (int line = 0; line < lines; ++line)
+				visibleLines += folding.IsLineHidden(line) ? 0 : 1;
+
+			const auto perQuery = [](Result aResult, int aQueries) {
+				AddCounter(aResult, "ns_per_query", aResult.mMedianMs * 1e6 / aQueries);
+				return aResult;
+			};
+			results.push_back(perQuery(Measure(options, "FoldQueries", "IsLineHidden", lines, [] {}, [&] {
+				for (int line = 0; line < lines; ++line)
+					(void)folding.IsLineHidden(line);
+			}), lines));
+			results.push_back(perQuery(Measure(options, "FoldQueries", "ActualToVisual", lines, [] {}, [&] {
+				for (int line = 0; line < lines; ++line)
+					(void)folding.ActualLineToVisualLine(line);
+			}), lines));
+			results.push_back(perQuery(Measure(options, "FoldQueries", "VisualToActual", lines, [] {}, [&] {
+				for (int line = 0; line < visibleLines; ++line)
+					(void)folding.VisualLineToActualLine(line);
+			}), visibleLines));
+			results.push_back(perQuery(Measure(options, "FoldQueries", "StartingAtLine", lines, [] {}, [&] {
+				for (int line = 0; line < lines; ++line)
+					(void)folding.GetRegionStartingAtLine(line);
+			}), lines));
+			// Folding or unfolding one of the nesting regions rebuilds the hidden spans
+			results.push_back(Measure(options, "FoldQueries", "ToggleFold", lines, [] {}, [&] {
+				(void)folding.ToggleFold(3 * 50000 + 1);
+			}));
+		}
+	}
+
+	for (const int lines : { 1000, 10000, 100000, 1000000 })
+	{
+		if (lines > options.mMaxLines)
+			break;
+
+		const std::string text = MakeDocument(lines);
+		// C has a hand-written tokenizer, so even the largest documents colorize quickly
+		TextEditor editor;
+		editor.SetLanguageDefinition(TextEditor::LanguageDefinitionId::C);
+
+		if (wanted("SetText"))
+			results.push_back(Measure(options, "SetText", "", lines, [] {}, [&] { editor.SetText(text); }));
+		// Editing benchmarks start every iteration from the same document and an empty undo buffer
+		const auto restore = [&] {
+			editor.SetText(text);
+			Peer::ColorizeAll(editor);
+		};
+		restore();
+
+		if (wanted("Typing"))
+		{
+			results.push_back(Measure(options, "Typing", "100 chars", lines,
+				[&] {
+					restore();
+					editor.SetCursorPosition(lines / 2, 0);
+				},
+				[&] { Peer::Type(editor, "for (int i = 0; i < count; ++i) total += values[i] * 2; // accumulate\n\t\tdone();\n"); }));
+			restore();
+		}
+
+		if (wanted("Paste"))
+		{
+			const std::string block = MakeDocument(1000);
+			results.push_back(Measure(options, "Paste", "1000 lines", lines,
+				[&] {
+					restore();
+					ImGui::SetClipboardText(block.c_str());
+					editor.SetCursorPosition(lines / 3, 0);
+				},
+				[&] { editor.Paste(); }));
+			restore();
+		}
+
+		if (wanted("UndoRedo"))
+		{
+			editor.SetCursorPosition(lines / 4, 0);
+			Peer::Type(editor, "int undone = redone;\n");
+			const int steps = 21;
+			results.push_back(Measure(options, "UndoRedo", "21 steps", lines, [] {}, [&] {
+				editor.Undo(steps);
+				editor.Redo(steps);
+			}));
+			restore();
+		}
+
+		if (wanted("MultiCursor"))
+		{
+			results.push_back(Measure(options, "MultiCursor", "100 cursors", lines,
+				[&] {
+					restore();
+					editor.ClearExtraCursors();
+					editor.SetCursorPosition(lines / 2, 0);
+					for (int i = 0; i < 99; ++i)
+						editor.AddCursorBelow();
+				},
+				[&] { Peer::Type(editor, "x_"); }));
+			editor.ClearExtraCursors();
+			restore();
+		}
+
+		if (wanted("FindAll"))
+		{
+			results.push_back(Measure(options, "FindAll", "session", lines, [] {}, [&] {
+				TextEditorSearchSession search;
+				(void)search.Update(editor, "needle");
+			}));
+			results.push_back(Measure(options, "FindAll", "cursors", lines, [] {}, [&] {
+				editor.SelectAllOccurrencesOf("needle", 6);
+			}));
+			editor.ClearExtraCursors();
+			editor.ClearSelections();
+		}
+
+		if (wanted("Colorize"))
+		{
+			// Regular expression colorizers are slow enough to cap at 100k lines
+			for (int id = static_cast<int>(TextEditor::LanguageDefinitionId::Cpp);
+				id <= static_cast<int>(TextEditor::LanguageDefinitionId::Aimms); ++id)
+			{
+				editor.SetLanguageDefinition(static_cast<TextEditor::LanguageDefinitionId>(id));
+				if (!Peer::IsTokenized(editor) && lines > 100000)
+					continue;
+				results.push_back(Measure(options, "Colorize", editor.GetLanguageDefinitionName(), lines, [] {},
+					[&] { Peer::ColorizeAll(editor); }));
+			}
+			editor.SetLanguageDefinition(TextEditor::LanguageDefinitionId::C);
+			Peer::ColorizeAll(editor);
+		}
+
+		if (wanted("VisualLines"))
+		{
+			editor.SetWordWrapEnabled(false);
+			results.push_back(Measure(options, "VisualLines", "no wrap", lines, [] {}, [&] {
+				(void)Peer::RebuildVisualLines(editor, 120);
+			}));
+			editor.SetWordWrapEnabled(true);
+			results.push_back(Measure(options, "VisualLines", "wrap 40", lines, [] {}, [&] {
+				(void)Peer::RebuildVisualLines(editor, 40);
+			}));
+			editor.SetWordWrapEnabled(false);
+		}
+
+		if (wanted("Render"))
+		{
+			RenderFrame(editor);
+			results.push_back(Measure(options, "Render", "idle", lines, [] {}, [&] { RenderFrame(editor); }));
+			results.push_back(Measure(options, "Render", "after edit", lines,
+				[&] {
+					// Undoing the previous iteration's edit keeps the line from growing
+					if (editor.CanUndo())
+						editor.Undo();
+					editor.SetCursorPosition(lines / 2, 0);
+					Peer::Type(editor, "x");
+				},
+				[&] { RenderFrame(editor); }));
+			restore();
+		}
+
+		if (wanted("Minimap"))
+		{
+			TextEditorMinimap minimap;
+			results.push_back(Measure(options, "Minimap", "full", lines,
+				[&] { minimap = TextEditorMinimap(); },
+				[&] { (void)minimap.GetLineSummaries(editor); }));
+			results.push_back(Measure(options, "Minimap", "after edit", lines,
+				[&] {
+					if (editor.CanUndo())
+						editor.Undo();
+					editor.SetCursorPosition(lines / 2, 0);
+					Peer::Type(editor, "y");
+				},
+				[&] { (void)minimap.GetLineSummaries(editor); }));
+			restore();
+		}
+
+		if (wanted("FoldIndent") && lines <= 100000)
+		{
+			// Indentation-only detection over pathological nesting, from scratch and after an edit
+			TextEditorCodeFolding::Config config;
+			config.detection_mode = TextEditorCodeFolding::DetectionMode::Indentation;
+			for (const bool sawtooth : { false, true })
+			{
+				TextEditor indented;
+				indented.SetText(MakeStaircase(lines, 200, sawtooth));
+				auto folding = std::make_unique<TextEditorCodeFolding>(config);
+				Result full = Measure(options, "FoldIndent", sawtooth ? "sawtooth" : "staircase", lines,
+					[&] { folding = std::make_unique<TextEditorCodeFolding>(config); },
+					[&] { folding->AnalyzeDocument(indented); });
+				AddCounter(full, "regions", static_cast<double>(folding->GetRegions().size()));
+				results.push_back(std::move(full));
+
+				// Typing after the indentation of the last line must not rescan the blocks above it
+				const int lastDepth = sawtooth ? (lines - 1) % 200 : std::min(lines - 1, 200);
+				Result edit = Measure(options, "FoldIndent", sawtooth ? "sawtooth edit" : "staircase edit", lines,
+					[&] {
+						if (indented.CanUndo())
+							indented.Undo();
+						indented.SetCursorPosition(lines - 1, lastDepth);
+						Peer::Type(indented, "x");
+					},
+					[&] { folding->AnalyzeDocument(indented); });
+				AddCounter(edit, "scanned_lines", static_cast<double>(folding->GetLastScannedLineCount()));
+				results.push_back(std::move(edit));
+			}
+		}
+
+		if (wanted("Folding"))
+		{
+			// Brace and indentation regions of the generated document, kept in step with edits. The
+			// previous iteration's edit is undone and analyzed untimed, so each body sees one edit.
+			TextEditorCodeFolding folding;
+			folding.AnalyzeDocument(editor);
+			(void)folding.Fold(lines / 2 - lines / 2 % 8 + 2);
+			Result keystroke = Measure(options, "Folding", "keystroke", lines,
+				[&] {
+					if (editor.CanUndo())
+						editor.Undo();
+					folding.AnalyzeDocument(editor);
+					editor.SetCursorPosition(lines / 2 + 3, 2);
+					Peer::Type(editor, "z");
+				},
+				[&] { folding.AnalyzeDocument(editor); });
+			AddCounter(keystroke, "regions", static_cast<double>(folding.GetRegions().size()));
+			results.push_back(std::move(keystroke));
+			results.push_back(Measure(options, "Folding", "newline", lines,
+				[&] {
+					if (editor.CanUndo())
+						editor.Undo();
+					folding.AnalyzeDocument(editor);
+					editor.SetCursorPosition(lines / 2 + 3, 2);
+					Peer::Type(editor, "\n");
+				},
+				[&] { folding.AnalyzeDocument(editor); }));
+			restore();
+		}
+
+		if (wanted("MinimapRender"))
+		{
+			// Rectangles per run, or the level-of-detail pyramid once lines outnumber the pixel rows
+			TextEditorMinimap drawn;
+			MinimapFrame(editor, drawn);
+			Result idle = Measure(options, "MinimapRender", drawn.GetLodLevelCount() > 0 ? "lod" : "rects", lines,
+				[] {}, [&] { MinimapFrame(editor, drawn); });
+			AddDrawCounters(idle, drawn);
+			results.push_back(std::move(idle));
+
+			// A keystroke or a new line mid-document between two frames, set up untimed
+			const auto typeBetweenFrames = [&](TextEditorMinimap& minimap, const char* typed) {
+				if (editor.CanUndo())
+					editor.Undo();
+				MinimapFrame(editor, minimap);
+				editor.SetCursorPosition(lines / 2, 2);
+				Peer::Type(editor, typed);
+				// The editor brings its visual lines up to date in its own frame
+				(void)editor.GetFirstVisibleLine();
+			};
+			for (const char* typed : { "x", "\n" })
+			{
+				if (drawn.GetLodLevelCount() == 0)
+					break;
+				Result edit = Measure(options, "MinimapRender", *typed == 'x' ? "lod edit" : "lod newline", lines,
+					[&] { typeBetweenFrames(drawn, typed); }, [&] { MinimapFrame(editor, drawn); });
+				AddCounter(edit, "lod_rows", drawn.GetLastRenderStats().lod_rows);
+				results.push_back(std::move(edit));
+			}
+
+			// A texture the host never draws; only the uploads are counted
+			TextEditorMinimap textured;
+			TextEditorMinimap::TextureHost host;
+			host.create = [](int, int) { return (ImTextureID)(intptr_t)1; };
+			host.update = [](ImTextureID, const ImU32*, int, int, int) {};
+			textured.SetTextureHost(host);
+			MinimapFrame(editor, textured);
+			Result texture = Measure(options, "MinimapRender", "texture", lines, [] {}, [&] { MinimapFrame(editor, textured); });
+			AddDrawCounters(texture, textured);
+			results.push_back(std::move(texture));
+			for (const char* typed : { "x", "\n" })
+			{
+				Result edit = Measure(options, "MinimapRender", *typed == 'x' ? "texture edit" : "texture newline", lines,
+					[&] { typeBetweenFrames(textured, typed); }, [&] { MinimapFrame(editor, textured); });
+				AddCounter(edit, "rasterized_rows", textured.GetLastRenderStats().rasterized_rows);
+				AddCounter(edit, "uploaded_rows", textured.GetLastRenderStats().uploaded_rows);
+				results.push_back(std::move(edit));
+			}
+			restore();
+		}
+
+		if (wanted("Autocomplete"))
+		{
+			// Narrowing as a word is typed over a provider with one word per document line
+			std::vector<std::string> words;
+			words.reserve(static_cast<std::size_t>(lines));
+			for (int i = 0; i < lines; ++i)
+				words.push_back((i % 3 == 0 ? "getValue" : i % 3 == 1 ? "setName" : "item") + std::to_string(i));
+			TextEditorAutocomplete autocomplete;
+			autocomplete.RegisterProvider(std::make_unique<KeywordCompletionProvider>(words));
+			editor.SetCursorPosition(0, 0);
+			results.push_back(Measure(options, "Autocomplete", "typing", lines,
+				[&] { autocomplete.Trigger(editor); },
+				[&] {
+					std::string typed;
+					for (const char c : std::string("getVal12"))
+					{
+						typed += c;
+						autocomplete.SetFilterText(typed);
+					}
+				}));
+		}
+	}
+
+	ImGui::DestroyContext();
+
+	if (options.mOutput.empty())
+	{
+		WriteJson(std::cout, results);
+	}
+	else
+	{
+		std::ofstream out(options.mOutput);
+		WriteJson(out, results);
+		if (!out)
+		{
+			std::fprintf(stderr, "cannot write %s\n", options.mOutput.c_str());
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,419 @@
+// Fuzz target for the editor's edit operations and incremental colorization.
+//
+// Each input is read as a language, a starting text and a list of operations: range
+// replacements, typing, deletion, undo/redo, clipboard and multi-cursor commands. After
+// every operation the cursors must lie inside the document with consistent character
+// index/column conversions, and undoing then redoing the operation must give back the
+// text before and after it. At the end, undoing everything must give back the starting
+// text and redoing it the final text. Every colorCheckSteps operations and at the end,
+// colors maintained across the edits must equal a fresh colorization; the edits in
+// between leave their recoloring pending together. A broken invariant aborts with a
+// message, which libFuzzer reports as a crash. Build it with clang and libFuzzer, e.g.
+// from the repository root
+//
+//   clang++ -std=c++20 -g -O1 -fsanitize=fuzzer,address -I. -I<imgui> fuzz/TextEditorFuzzer.cpp
+//       TextEditor*.cpp LanguageDefinitions.cpp ImGuiDebugPanel.cpp UnitTests.cpp <imgui>/imgui*.cpp
+//       -lboost_regex -o text_editor_fuzzer
+//
+// or with any compiler and -DTEXT_EDITOR_FUZZ_MAIN for a driver without libFuzzer:
+//
+// Usage: text_editor_fuzzer [FILE...] | [--runs N] [--seed N]
+// Replays the given inputs, or runs N generated ones.
+
+#include "TextEditor.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Reaches the editor internals the operations and invariants need
+class text_editor_fuzz_peer
+{
+public:
+	static void EnterCharacter(TextEditor& aEditor, char aChar, bool aShift)
+	{
+		aEditor.EnterCharacter(static_cast<ImWchar>(static_cast<unsigned char>(aChar)), aShift);
+	}
+
+	static void Backspace(TextEditor& aEditor, bool aWordMode) { aEditor.Backspace(aWordMode); }
+	static void Delete(TextEditor& aEditor, bool aWordMode) { aEditor.Delete(aWordMode); }
+	static void MoveLeft(TextEditor& aEditor, bool aSelect, bool aWordMode) { aEditor.MoveLeft(aSelect, aWordMode); }
+	static void MoveRight(TextEditor& aEditor, bool aSelect, bool aWordMode) { aEditor.MoveRight(aSelect, aWordMode); }
+	static void MoveUp(TextEditor& aEditor, int aAmount, bool aSelect) { aEditor.MoveUp(aAmount, aSelect); }
+	static void MoveDown(TextEditor& aEditor, int aAmount, bool aSelect) { aEditor.MoveDown(aAmount, aSelect); }
+	static void AddCursorForNextOccurrence(TextEditor& aEditor) { aEditor.AddCursorForNextOccurrence(); }
+	static void ChangeIndentation(TextEditor& aEditor, bool aIncrease) { aEditor.ChangeCurrentLinesIndentation(aIncrease); }
+	static void ToggleLineComment(TextEditor& aEditor) { aEditor.ToggleLineComment(); }
+	static void RemoveCurrentLines(TextEditor& aEditor) { aEditor.RemoveCurrentLines(); }
+	static int CursorCount(const TextEditor& aEditor) { return aEditor.mState.mCurrentCursor + 1; }
+
+	static void ColorizeAll(TextEditor& aEditor)
+	{
+		// Without a language nothing is colorized and the pending range never drains
+		if (aEditor.mLanguageDefinition == nullptr)
+			return;
+		aEditor.Colorize();
+		while (aEditor.mCheckComments || aEditor.mColorRangeMin < aEditor.mColorRangeMax)
+			aEditor.ColorizeInternal();
+	}
+
+	// Empty if every cursor is valid, otherwise what is wrong
+	static std::string CheckCursors(const TextEditor& aEditor)
+	{
+		const auto& state = aEditor.mState;
+		if (state.mCursors.empty())
+			return "no cursor";
+		if (state.mCurrentCursor < 0 || state.mCurrentCursor >= static_cast<int>(state.mCursors.size()))
+			return "current cursor out of range";
+		// Entries past the current cursor are spares, not cursors
+		for (int c = 0; c <= state.mCurrentCursor; ++c)
+		{
+			const auto& cursor = state.mCursors[static_cast<std::size_t>(c)];
+			for (const auto& position : { cursor.mInteractiveStart, cursor.mInteractiveEnd })
+			{
+				if (position.mLine < 0 || position.mLine >= aEditor.GetLineCount() || position.mColumn < 0)
+					return "cursor " + std::to_string(position.mLine) + ":" + std::to_string(position.mColumn) + " outside the document";
+
+				// Vertical moves keep the column past the end of shorter lines, edits work on the clamped position
+				const auto coords = aEditor.SanitizeCoordinates(position);
+				if (coords.mLine != position.mLine || coords.mColumn > aEditor.GetLineMaxColumn(coords.mLine))
+					return "sanitized cursor past the line end";
+				if (aEditor.SanitizeCoordinates(coords) != coords)
+					return "sanitizing a sanitized cursor moves it";
+
+				// The characters left and right of the column bracket it
+				const int left = aEditor.GetCharacterIndexL(coords);
+				const int right = aEditor.GetCharacterIndexR(coords);
+				if (left < 0 || left > right || right > aEditor.GetLineLength(coords.mLine))
+					return "character indices out of order";
+				if (aEditor.GetCharacterColumn(coords.mLine, left) > coords.mColumn ||
+					aEditor.GetCharacterColumn(coords.mLine, right) < coords.mColumn)
+					return "character columns don't bracket the cursor column";
+			}
+		}
+		return {};
+	}
+};
+
+namespace
+{
+using Peer = text_editor_fuzz_peer;
+
+[[noreturn]] void Fail(const std::string& aWhat, int aStep)
+{
+	std::fprintf(stderr, "invariant broken after step %d: %s\n", aStep, aWhat.c_str());
+	std::abort();
+}
+
+// Reads the input front to back; once it runs out, every read gives 0
+class InputReader
+{
+public:
+	InputReader(const std::uint8_t* aData, std::size_t aSize) : mData(aData), mSize(aSize) {}
+
+	bool Empty() const { return mOffset >= mSize; }
+
+	int Byte() { return mOffset < mSize ? mData[mOffset++] : 0; }
+
+	int Range(int aCount) { return Byte() % aCount; }
+
+	// A piece of valid UTF-8 text, so inputs exercise the editor instead of its decoding
+	std::string Text(int aMaxPieces)
+	{
+		static const char* pieces[] = { "\n", "\t", " ", "{", "}", "(", ")", "\"", "'", "\\", "/*", "*/", "//", "#",
+			"--", "\"\"\"", "foo", "bar", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\r\n" };
+		constexpr int pieceCount = static_cast<int>(sizeof(pieces) / sizeof(pieces[0]));
+		std::string text;
+		const int count = Range(aMaxPieces + 1);
+		for (int i = 0; i < count; ++i)
+		{
+			const int value = Byte();
+			if (value < pieceCount)
+				text += pieces[value];
+			else
+				text += static_cast<char>(0x20 + value % 0x5f);  // printable ASCII
+		}
+		return text;
+	}
+
+private:
+	const std::uint8_t* mData;
+	std::size_t mSize;
+	std::size_t mOffset = 0;
+};
+
+constexpr int maxSteps = 64;
+constexpr int colorCheckSteps = 4;
+constexpr int maxDocumentBytes = 8192;
+
+TextEditor::LanguageDefinitionId PickLanguage(InputReader& aInput)
+{
+	using Language = TextEditor::LanguageDefinitionId;
+	const Language languages[] = { Language::None, Language::C, Language::Cpp, Language::Python, Language::Lua, Language::Json };
+	return languages[aInput.Range(static_cast<int>(sizeof(languages) / sizeof(languages[0])))];
+}
+
+// Character index snapped to a character start, as the editor's own positions are
+int PickCharIndex(const TextEditor& aEditor, int aLine, InputReader& aInput)
+{
+	const std::string text = aEditor.GetLineText(aLine);
+	int index = aInput.Range(static_cast<int>(text.size()) + 1);
+	while (index > 0 && index < static_cast<int>(text.size()) &&
+		(static_cast<unsigned char>(text[static_cast<std::size_t>(index)]) & 0xC0) == 0x80)
+		--index;
+	return index;
+}
+
+// Runs one operation; false for undo and redo, which don't add an undo step
+bool RunStep(TextEditor& aEditor, InputReader& aInput)
+{
+	const bool large = aEditor.GetText().size() > static_cast<std::size_t>(maxDocumentBytes);
+	switch (aInput.Range(20))
+	{
+	case 0:
+	case 1:
+	{
+		// InsertTextAt and DeleteRange, through the public call that records them for undo
+		const int startLine = aInput.Range(aEditor.GetLineCount());
+		const int endLine = std::min(aEditor.GetLineCount() - 1, startLine + aInput.Range(3));
+		int startChar = PickCharIndex(aEditor, startLine, aInput);
+		int endChar = PickCharIndex(aEditor, endLine, aInput);
+		if (startLine == endLine && endChar < startChar)
+			std::swap(startChar, endChar);
+		const std::string text = large ? std::string() : aInput.Text(12);
+		aEditor.ReplaceRange(startLine, startChar, endLine, endChar, text.c_str());
+		break;
+	}
+	case 2:
+	{
+		const int line = aInput.Range(aEditor.GetLineCount());
+		aEditor.SetCursorPosition(line, PickCharIndex(aEditor, line, aInput));
+		break;
+	}
+	case 3:
+	{
+		const int startLine = aInput.Range(aEditor.GetLineCount());
+		const int endLine = aInput.Range(aEditor.GetLineCount());
+		aEditor.SetSelection(startLine, PickCharIndex(aEditor, startLine, aInput), endLine,
+			PickCharIndex(aEditor, endLine, aInput));
+		break;
+	}
+	case 4:
+	{
+		if (large)
+			break;
+		const std::string text = aInput.Text(4);
+		for (const char c : text)
+			Peer::EnterCharacter(aEditor, c == '\r' ? '\n' : c, aInput.Range(2) == 0);
+		break;
+	}
+	case 5: Peer::Backspace(aEditor, aInput.Range(2) == 0); break;
+	case 6: Peer::Delete(aEditor, aInput.Range(2) == 0); break;
+	case 7: aEditor.Undo(1 + aInput.Range(3)); return false;
+	case 8: aEditor.Redo(1 + aInput.Range(3)); return false;
+	case 9: aEditor.AddCursorAbove(); break;
+	case 10: aEditor.AddCursorBelow(); break;
+	case 11:
+	{
+		const std::string text = aInput.Text(2);
+		aEditor.SelectAllOccurrencesOf(text.c_str(), static_cast<int>(text.size()), aInput.Range(2) == 0);
+		break;
+	}
+	case 12: Peer::AddCursorForNextOccurrence(aEditor); break;
+	case 13: aEditor.ClearExtraCursors(); break;
+	case 14:
+		switch (aInput.Range(4))
+		{
+		case 0: Peer::MoveLeft(aEditor, aInput.Range(2) == 0, aInput.Range(2) == 0); break;
+		case 1: Peer::MoveRight(aEditor, aInput.Range(2) == 0, aInput.Range(2) == 0); break;
+		case 2: Peer::MoveUp(aEditor, 1 + aInput.Range(4), aInput.Range(2) == 0); break;
+		default: Peer::MoveDown(aEditor, 1 + aInput.Range(4), aInput.Range(2) == 0); break;
+		}
+		break;
+	case 15:
+		if (aInput.Range(2) == 0)
+			aEditor.Copy();
+		else
+			aEditor.Cut();
+		break;
+	case 16:
+	{
+		// Every cursor pastes the whole clipboard
+		const char* clipboard = ImGui::GetClipboardText();
+		const std::size_t pasted = (clipboard != nullptr ? std::strlen(clipboard) : 0) * static_cast<std::size_t>(Peer::CursorCount(aEditor));
+		if (!large && pasted <= static_cast<std::size_t>(maxDocumentBytes))
+			aEditor.Paste();
+		break;
+	}
+	case 17:
+		switch (aInput.Range(4))
+		{
+		case 0: aEditor.MoveCurrentLinesUp(); break;
+		case 1: aEditor.MoveCurrentLinesDown(); break;
+		case 2: Peer::ChangeIndentation(aEditor, aInput.Range(2) == 0); break;
+		default: Peer::RemoveCurrentLines(aEditor); break;
+		}
+		break;
+	case 18: Peer::ToggleLineComment(aEditor); break;
+	default:
+		// Colorizes now, so later edits recolor what earlier ones left behind
+		Peer::ColorizeAll(aEditor);
+		break;
+	}
+	return true;
+}
+
+std::string FirstColorMismatch(TextEditor& aEditor)
+{
+	Peer::ColorizeAll(aEditor);
+	TextEditor reference;
+	reference.SetLanguageDefinition(aEditor.GetLanguageDefinition());
+	reference.SetTextLines(aEditor.GetTextLines());
+	Peer::ColorizeAll(reference);
+	for (int line = 0; line < aEditor.GetLineCount(); ++line)
+	{
+		for (int c = 0; c < aEditor.GetLineLength(line); ++c)
+		{
+			if (aEditor.GetGlyphColor(line, c) != reference.GetGlyphColor(line, c))
+				return "incremental color differs from a full colorization at line " + std::to_string(line) +
+					", character " + std::to_string(c);
+		}
+	}
+	return {};
+}
+} // namespace
+
+extern "C" int LLVMFuzzerInitialize(int*, char***)
+{
+	// Clipboard commands need a context, nothing else needs a frame
+	ImGui::CreateContext();
+	ImGui::GetIO().IniFilename = nullptr;
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* aData, std::size_t aSize)
+{
+	// The clipboard outlives the input; each one starts without what the previous ones copied
+	ImGui::SetClipboardText("");
+	InputReader input(aData, aSize);
+	TextEditor editor;
+	editor.SetLanguageDefinition(PickLanguage(input));
+	editor.SetTabSize(1 + input.Range(8));
+	editor.SetText(input.Text(64));
+	Peer::ColorizeAll(editor);
+	const std::string original = editor.GetText();
+
+	int step = 0;
+	for (; step < maxSteps && !input.Empty(); ++step)
+	{
+		if (step > 0 && step % colorCheckSteps == 0)
+		{
+			const std::string mismatch = FirstColorMismatch(editor);
+			if (!mismatch.empty())
+				Fail(mismatch, step - 1);
+		}
+
+		const std::string before = editor.GetText();
+		const int undoIndexBefore = editor.GetUndoIndex();
+		const bool addsUndoStep = RunStep(editor, input);
+		const std::string problem = Peer::CheckCursors(editor);
+		if (!problem.empty())
+			Fail(problem, step);
+		if (!addsUndoStep)
+			continue;
+
+		// The undo steps an edit added go back and forth between the texts around it
+		const std::string after = editor.GetText();
+		const int addedSteps = editor.GetUndoIndex() - undoIndexBefore;
+		if (addedSteps == 0)
+		{
+			if (after != before)
+				Fail("an edit added no undo step", step);
+			continue;
+		}
+		editor.Undo(addedSteps);
+		if (editor.GetText() != before)
+			Fail("undoing an edit doesn't restore the text before it", step);
+		editor.Redo(addedSteps);
+		if (editor.GetText() != after)
+			Fail("redoing an edit doesn't restore the text after it", step);
+	}
+
+	std::string problem = FirstColorMismatch(editor);
+	if (!problem.empty())
+		Fail(problem, step);
+
+	// Undo back to the start and redo to where the steps left off
+	const std::string edited = editor.GetText();
+	const int undoIndex = editor.GetUndoIndex();
+	editor.Undo(undoIndex);
+	if (editor.GetText() != original)
+		Fail("undoing every edit doesn't restore the original text", step);
+	problem = Peer::CheckCursors(editor);
+	if (!problem.empty())
+		Fail("after undoing every edit, " + problem, step);
+	editor.Redo(undoIndex);
+	if (editor.GetText() != edited)
+		Fail("redoing every edit doesn't restore the edited text", step);
+	problem = Peer::CheckCursors(editor);
+	if (!problem.empty())
+		Fail("after redoing every edit, " + problem, step);
+
+	problem = FirstColorMismatch(editor);
+	if (!problem.empty())
+		Fail("after undo and redo, " + problem, step);
+	return 0;
+}
+
+#ifdef TEXT_EDITOR_FUZZ_MAIN
+int main(int argc, char** argv)
+{
+	LLVMFuzzerInitialize(&argc, &argv);
+
+	int runs = 10000;
+	unsigned int seed = 1;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--runs") == 0 && hasValue)
+			runs = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+			seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		else
+			files.emplace_back(argv[i]);
+	}
+
+	for (const auto& file : files)
+	{
+		std::ifstream in(file, std::ios::binary);
+		const std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		std::fprintf(stderr, "%s\n", file.c_str());
+		LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(bytes.data()), bytes.size());
+	}
+	if (!files.empty())
+		return 0;
+
+	std::vector<std::uint8_t> bytes;
+	for (int run = 0; run < runs; ++run)
+	{
+		seed = seed * 1103515245u + 12345u;
+		bytes.resize(((seed >> 16) % 512) + 1);
+		for (auto& byte : bytes)
+		{
+			seed = seed * 1103515245u + 12345u;
+			byte = static_cast<std::uint8_t>(seed >> 16);
+		}
+		LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+	}
+	std::fprintf(stderr, "%d inputs passed\n", runs);
+	return 0;
+}
+#endif
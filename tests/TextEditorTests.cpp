@@ -0,0 +1,799 @@
+// Standalone tests for the editor core and its add-on classes.
+//
+// Unlike TextEditor::UnitTests(), the checks here do not depend on assert and run the
+// same in release builds, so optimized builds can be validated too. Most cases are
+// randomized differential tests: an incrementally maintained result is compared with a
+// reference computed from scratch after every batch of edits. Build it next to the
+// editor sources and Dear ImGui, e.g. from the repository root
+//
+//   c++ -std=c++20 -O2 -I. -I<imgui> tests/TextEditorTests.cpp TextEditor*.cpp
+//       LanguageDefinitions.cpp ImGuiDebugPanel.cpp UnitTests.cpp <imgui>/imgui*.cpp
+//       -lboost_regex -o text_editor_tests
+//
+// Usage: text_editor_tests [--filter TEXT] [--seed N]
+// Exits with 1 if any check failed.
+
+#include "TextEditor.h"
+#include "TextEditorAutocomplete.hpp"
+#include "TextEditorBracketMatcher.hpp"
+#include "TextEditorCodeFolding.hpp"
+#include "TextEditorMinimap.hpp"
+#include "TextEditorSearch.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reaches the editor internals the tests check directly
+class text_editor_test_peer
+{
+public:
+	static int GetCharacterColumn(const TextEditor& aEditor, int aLine, int aIndex)
+	{
+		return aEditor.GetCharacterColumn(aLine, aIndex);
+	}
+
+	static int GetCharacterIndexL(const TextEditor& aEditor, int aLine, int aColumn)
+	{
+		return aEditor.GetCharacterIndexL(TextEditor::Coordinates(aLine, aColumn));
+	}
+
+	static int GetCharacterIndexR(const TextEditor& aEditor, int aLine, int aColumn)
+	{
+		return aEditor.GetCharacterIndexR(TextEditor::Coordinates(aLine, aColumn));
+	}
+
+	static void EnterCharacter(TextEditor& aEditor, char aChar)
+	{
+		aEditor.EnterCharacter(static_cast<ImWchar>(aChar), false);
+	}
+
+	static void Backspace(TextEditor& aEditor)
+	{
+		aEditor.Backspace();
+	}
+
+	static void ColorizeAll(TextEditor& aEditor)
+	{
+		aEditor.Colorize();
+		while (aEditor.mCheckComments || aEditor.mColorRangeMin < aEditor.mColorRangeMax)
+			aEditor.ColorizeInternal();
+	}
+
+	static void SetWrapColumn(TextEditor& aEditor, int aWrapColumn)
+	{
+		aEditor.mWrapColumn = aWrapColumn;
+	}
+
+	// Brings the visual lines up to date, then compares them with a rebuild from scratch
+	static bool VisualLinesMatchFullRebuild(TextEditor& aEditor)
+	{
+		aEditor.EnsureVisualLines();
+		const auto patched = aEditor.mVisualLines;
+		const auto patchedMap = aEditor.mDocumentToVisual;
+		// Looks like a content change to the visual line cache
+		++aEditor.mLinesRevision;
+		aEditor.EnsureVisualLines();
+		if (patched.size() != aEditor.mVisualLines.size() || patchedMap != aEditor.mDocumentToVisual)
+			return false;
+		for (std::size_t i = 0; i < patched.size(); ++i)
+		{
+			const auto& a = patched[i];
+			const auto& b = aEditor.mVisualLines[i];
+			if (a.mIsGhost != b.mIsGhost || a.mGhostIndex != b.mGhostIndex || a.mDocumentLine != b.mDocumentLine ||
+				a.mWrapStartColumn != b.mWrapStartColumn || a.mWrapEndColumn != b.mWrapEndColumn)
+				return false;
+		}
+		return true;
+	}
+};
+
+namespace
+{
+using Peer = text_editor_test_peer;
+
+struct Options
+{
+	std::string mFilter;
+	unsigned int mSeed = 12345;
+};
+
+int checkCount = 0;
+int failureCount = 0;
+
+// Unlike assert, stays in release builds and keeps going after a failure
+#define CHECK(aCondition) \
+	do \
+	{ \
+		++checkCount; \
+		if (!(aCondition)) \
+		{ \
+			++failureCount; \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #aCondition); \
+		} \
+	} while (false)
+
+// Same generator as the randomized cases in UnitTests.cpp, seeded per test
+class Random
+{
+public:
+	explicit Random(unsigned int aSeed) : mSeed(aSeed) {}
+
+	int operator()(int aRange)
+	{
+		mSeed = mSeed * 1103515245u + 12345u;
+		return static_cast<int>((mSeed >> 16) % static_cast<unsigned int>(aRange));
+	}
+
+private:
+	unsigned int mSeed;
+};
+
+bool IsContinuationByte(char aChar)
+{
+	return (static_cast<unsigned char>(aChar) & 0xC0) == 0x80;
+}
+
+std::vector<std::string> SplitLines(const std::string& aText)
+{
+	std::vector<std::string> lines(1);
+	for (const char c : aText)
+	{
+		if (c == '\n')
+			lines.emplace_back();
+		else
+			lines.back() += c;
+	}
+	return lines;
+}
+
+// Random line from tabs, spaces, ASCII and multi-byte UTF-8 characters
+std::string MakeLine(Random& aRandom, int aMaxLength)
+{
+	static const char* pieces[] = { "\t", " ", "a", "Z", "_", "{", "}", "(", ")", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80" };
+	std::string line;
+	const int length = aRandom(aMaxLength + 1);
+	for (int i = 0; i < length; ++i)
+		line += pieces[aRandom(static_cast<int>(sizeof(pieces) / sizeof(pieces[0])))];
+	return line;
+}
+
+// Snaps a byte index back to the start of its UTF-8 sequence
+int CharStart(const std::string& aLine, int aIndex)
+{
+	while (aIndex > 0 && aIndex < static_cast<int>(aLine.size()) && IsContinuationByte(aLine[static_cast<std::size_t>(aIndex)]))
+		--aIndex;
+	return aIndex;
+}
+
+// Random edit through the public API, mirrored on aModel
+void ReplaceRandomRange(TextEditor& aEditor, std::vector<std::string>& aModel, Random& aRandom,
+	const std::vector<const char*>& aPieces)
+{
+	const int startLine = aRandom(static_cast<int>(aModel.size()));
+	const int endLine = aRandom(3) == 0 ? std::min(static_cast<int>(aModel.size()) - 1, startLine + aRandom(3)) : startLine;
+	const auto& first = aModel[static_cast<std::size_t>(startLine)];
+	const auto& last = aModel[static_cast<std::size_t>(endLine)];
+	int startChar = CharStart(first, aRandom(static_cast<int>(first.size()) + 1));
+	int endChar = CharStart(last, aRandom(static_cast<int>(last.size()) + 1));
+	if (endLine == startLine && endChar < startChar)
+		std::swap(startChar, endChar);
+	const bool insert = aRandom(3) != 0;
+	const std::string text = insert ? aPieces[static_cast<std::size_t>(aRandom(static_cast<int>(aPieces.size())))] : "";
+
+	aEditor.ReplaceRange(startLine, startChar, endLine, endChar, text.c_str());
+
+	const std::string joined = first.substr(0, static_cast<std::size_t>(startChar)) + text +
+		last.substr(static_cast<std::size_t>(endChar));
+	const auto replacement = SplitLines(joined);
+	aModel.erase(aModel.begin() + startLine, aModel.begin() + endLine + 1);
+	aModel.insert(aModel.begin() + startLine, replacement.begin(), replacement.end());
+}
+
+std::string JoinLines(const std::vector<std::string>& aLines)
+{
+	std::string text;
+	for (std::size_t i = 0; i < aLines.size(); ++i)
+	{
+		if (i > 0)
+			text += '\n';
+		text += aLines[i];
+	}
+	return text;
+}
+
+const std::vector<const char*> sourcePieces = { "x", " ", "\t", "\n", "{", "}", "(", ")", "\"", "'", "/*", "*/", "//", "#",
+	"--", "\"\"\"", "value", "if (a)\n{\n\tb();\n}\n", "\n\t", "\xC3\xA9" };
+
+// --- Coordinates --- //
+
+// Column model the editor documents: a tab advances to the next tab stop, any other character is one column
+void TestCoordinates(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	for (int round = 0; round < 40; ++round)
+	{
+		const int tabSize = 1 + random(8);
+		editor.SetTabSize(tabSize);
+		std::vector<std::string> lines;
+		for (int i = 0; i < 20; ++i)
+			lines.push_back(MakeLine(random, 24));
+		editor.SetTextLines(lines);
+
+		for (int line = 0; line < static_cast<int>(lines.size()); ++line)
+		{
+			const auto& text = lines[static_cast<std::size_t>(line)];
+			// column at which each character starts, indexed by character start
+			std::vector<int> starts;
+			std::vector<int> columns;
+			int column = 0;
+			for (int index = 0; index < static_cast<int>(text.size()); ++index)
+			{
+				if (IsContinuationByte(text[static_cast<std::size_t>(index)]))
+					continue;
+				CHECK(Peer::GetCharacterColumn(editor, line, index) == column);
+				starts.push_back(index);
+				columns.push_back(column);
+				column = text[static_cast<std::size_t>(index)] == '\t' ? (column / tabSize + 1) * tabSize : column + 1;
+			}
+			CHECK(Peer::GetCharacterColumn(editor, line, static_cast<int>(text.size())) == column);
+			CHECK(editor.GetLineMaxColumn(line) == column);
+			starts.push_back(static_cast<int>(text.size()));
+			columns.push_back(column);
+
+			for (int target = 0; target <= column + 2; ++target)
+			{
+				// first character ending after the target column, if any
+				std::size_t c = 0;
+				while (c + 1 < starts.size() && columns[c + 1] <= target)
+					++c;
+				const bool inside = c + 1 < starts.size() && columns[c] < target;
+				const int left = starts[c];
+				const int right = inside ? starts[c + 1] : starts[c];
+				CHECK(Peer::GetCharacterIndexL(editor, line, target) == left);
+				CHECK(Peer::GetCharacterIndexR(editor, line, target) == right);
+			}
+		}
+	}
+}
+
+// --- Editing --- //
+
+void TestEditing(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	std::vector<std::string> model = { "int main()", "{", "\treturn 0;", "}", "" };
+	editor.SetTextLines(model);
+	for (int i = 0; i < 2000; ++i)
+	{
+		ReplaceRandomRange(editor, model, random, sourcePieces);
+		CHECK(editor.GetLineCount() == static_cast<int>(model.size()));
+		if (random(10) == 0)
+		{
+			CHECK(editor.GetTextLines() == model);
+			CHECK(editor.GetText() == JoinLines(model));
+		}
+		const int line = random(static_cast<int>(model.size()));
+		CHECK(editor.GetLineText(line) == model[static_cast<std::size_t>(line)]);
+	}
+	CHECK(editor.GetTextLines() == model);
+}
+
+// --- Undo --- //
+
+void TestUndo(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	std::vector<std::string> model = { "alpha beta", "\tgamma", "delta" };
+	editor.SetTextLines(model);
+	std::vector<std::string> snapshots = { editor.GetText() };
+	for (int i = 0; i < 300; ++i)
+	{
+		switch (random(4))
+		{
+		case 0:
+			editor.SetCursorPosition(random(editor.GetLineCount()), 0);
+			Peer::EnterCharacter(editor, "ab{}(\n\t "[random(8)]);
+			break;
+		case 1:
+		{
+			editor.SetCursorPosition(random(editor.GetLineCount()), random(4));
+			int line = 0;
+			int column = 0;
+			editor.GetCursorPosition(line, column);
+			if (line == 0 && column == 0)
+				continue;  // nothing to delete, no undo record
+			Peer::Backspace(editor);
+			break;
+		}
+		default:
+			model = editor.GetTextLines();
+			ReplaceRandomRange(editor, model, random, sourcePieces);
+			break;
+		}
+		snapshots.push_back(editor.GetText());
+		CHECK(editor.GetUndoIndex() == static_cast<int>(snapshots.size()) - 1);
+	}
+
+	for (int i = static_cast<int>(snapshots.size()) - 2; i >= 0; --i)
+	{
+		editor.Undo();
+		CHECK(editor.GetText() == snapshots[static_cast<std::size_t>(i)]);
+	}
+	CHECK(!editor.CanUndo());
+	for (std::size_t i = 1; i < snapshots.size(); ++i)
+	{
+		editor.Redo();
+		CHECK(editor.GetText() == snapshots[i]);
+	}
+	CHECK(!editor.CanRedo());
+
+	// an edit after undoing drops the redo branch
+	editor.Undo(10);
+	editor.ReplaceRange(0, 0, 0, 0, "x");
+	CHECK(!editor.CanRedo() && editor.GetUndoIndex() == static_cast<int>(snapshots.size()) - 10);
+}
+
+// --- Colorization --- //
+
+// Recoloring after edits gives the same colors as colorizing the final text from scratch
+void TestColorization(unsigned int aSeed)
+{
+	Random random(aSeed);
+	using Language = TextEditor::LanguageDefinitionId;
+	for (const auto language : { Language::C, Language::Cpp, Language::Python, Language::Lua, Language::Json })
+	{
+		TextEditor editor;
+		editor.SetLanguageDefinition(language);
+		std::vector<std::string> model;
+		for (int i = 0; i < 40; ++i)
+			model.push_back(i % 4 == 0 ? "/* note */ int x = \"s\"; // c" : i % 4 == 1 ? "\t'''doc''' -- lua" : "value(1.5f, 0x1F);");
+		editor.SetTextLines(model);
+		Peer::ColorizeAll(editor);
+
+		for (int i = 0; i < 120; ++i)
+		{
+			ReplaceRandomRange(editor, model, random, sourcePieces);
+			if (random(3) != 0)
+				continue;  // let some edits pile up
+			Peer::ColorizeAll(editor);
+			TextEditor reference;
+			reference.SetLanguageDefinition(language);
+			reference.SetTextLines(model);
+			Peer::ColorizeAll(reference);
+			bool same = true;
+			for (int line = 0; line < editor.GetLineCount() && same; ++line)
+			{
+				for (int c = 0; c < editor.GetLineLength(line) && same; ++c)
+					same = editor.GetGlyphColor(line, c) == reference.GetGlyphColor(line, c);
+			}
+			CHECK(same);
+		}
+	}
+}
+
+// --- Visual lines --- //
+
+void TestVisualLines(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	std::vector<std::string> model;
+	for (int i = 0; i < 80; ++i)
+		model.push_back(std::string(static_cast<std::size_t>(i % 9) * 7, 'a') + (i % 3 == 0 ? " b\tc d e f g" : ""));
+	editor.SetTextLines(model);
+	Peer::SetWrapColumn(editor, 24);
+	editor.SetWordWrapEnabled(true);
+	std::vector<TextEditor::GhostLine> ghosts;
+	for (const int anchor : { 0, 5, 5, 30, 79 })
+	{
+		TextEditor::GhostLine ghost;
+		ghost.mAnchorLine = anchor;
+		ghosts.push_back(ghost);
+	}
+	editor.SetGhostLines(std::move(ghosts));
+
+	const std::vector<const char*> pieces = { "x", " ", "\t", "\n", "aaaaaaaaaa bbbbbbbbbb cccccccccc", "\n\n", "\xE2\x82\xAC" };
+	for (int i = 0; i < 400; ++i)
+	{
+		switch (random(4))
+		{
+		case 0:
+		{
+			const int first = random(editor.GetLineCount());
+			const TextEditor::LineRange range(first, std::min(editor.GetLineCount() - 1, first + random(6)));
+			if (random(2) == 0)
+				editor.HideLineRange(range);
+			else
+				editor.ShowLineRange(range);
+			break;
+		}
+		case 1:
+			Peer::SetWrapColumn(editor, 8 + random(40));
+			break;
+		default:
+			ReplaceRandomRange(editor, model, random, pieces);
+			break;
+		}
+		CHECK(Peer::VisualLinesMatchFullRebuild(editor));
+	}
+}
+
+// --- TextEditorSearchSession --- //
+
+// Every occurrence found by a plain scan of the text, overlapping ones included
+std::vector<TextEditorSearchSession::Match> FindAllInLines(const std::vector<std::string>& aLines, const std::string& aQuery)
+{
+	std::vector<TextEditorSearchSession::Match> matches;
+	for (int line = 0; line < static_cast<int>(aLines.size()); ++line)
+	{
+		const auto& text = aLines[static_cast<std::size_t>(line)];
+		for (std::size_t at = text.find(aQuery); at != std::string::npos; at = text.find(aQuery, at + 1))
+		{
+			TextEditorSearchSession::Match match;
+			match.line = line;
+			match.char_index = static_cast<int>(at);
+			match.end_line = line;
+			match.end_char_index = static_cast<int>(at + aQuery.size());
+			matches.push_back(match);
+		}
+	}
+	return matches;
+}
+
+void TestSearchSession(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	std::vector<std::string> model;
+	for (int i = 0; i < 60; ++i)
+		model.push_back(i % 5 == 0 ? "foo bar foobar" : "baz qux");
+	editor.SetTextLines(model);
+	const std::vector<const char*> pieces = { "foo", "fo", "o", "bar", " ", "\n", "foo\nfoo", "xfoobarx" };
+	const char* queries[] = { "foo", "foob", "o", "bar", "oo" };
+	TextEditorSearchSession session;
+	for (int i = 0; i < 300; ++i)
+	{
+		ReplaceRandomRange(editor, model, random, pieces);
+		const std::string query = queries[random(static_cast<int>(sizeof(queries) / sizeof(queries[0])))];
+		session.Update(editor, query);
+		const auto expected = FindAllInLines(model, query);
+		const auto& matches = session.GetMatches();
+		bool same = matches.size() == expected.size();
+		for (std::size_t m = 0; m < matches.size() && same; ++m)
+		{
+			same = matches[m].line == expected[m].line && matches[m].char_index == expected[m].char_index &&
+				matches[m].end_line == expected[m].end_line && matches[m].end_char_index == expected[m].end_char_index;
+		}
+		CHECK(same);
+	}
+}
+
+// --- TextEditorBracketMatcher, TextEditorCodeFolding --- //
+
+void TestStructureAnalyzers(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	editor.SetLanguageDefinition(TextEditor::LanguageDefinitionId::Cpp);
+	std::vector<std::string> model = { "int f() {", "\tif (a[0]) {", "\t\tg(\"}\");", "\t}", "}", "" };
+	editor.SetTextLines(model);
+	const std::vector<const char*> pieces = { "{", "}", "(", ")", "[", "]", "\n", "\t", "    ", "x", "{\n}", "(\n\t", "\"", "//" };
+	TextEditorBracketMatcher matcher;
+	TextEditorCodeFolding folding;
+	for (int i = 0; i < 400; ++i)
+	{
+		ReplaceRandomRange(editor, model, random, pieces);
+		Peer::ColorizeAll(editor);
+		matcher.AnalyzeDocument(editor);
+		folding.AnalyzeDocument(editor);
+		if (!folding.GetRegions().empty() && random(3) == 0)
+		{
+			const auto& regions = folding.GetRegions();
+			(void)folding.ToggleFold(regions[static_cast<std::size_t>(random(static_cast<int>(regions.size())))].start_line);
+		}
+		if (random(4) == 0)
+			continue;  // let some edits pile up
+
+		TextEditorBracketMatcher bracketReference;
+		bracketReference.AnalyzeDocument(editor);
+		const auto& pairs = matcher.GetBracketPairs();
+		const auto& expectedPairs = bracketReference.GetBracketPairs();
+		bool same = pairs.size() == expectedPairs.size();
+		for (std::size_t p = 0; p < pairs.size() && same; ++p)
+		{
+			same = pairs[p].open_line == expectedPairs[p].open_line && pairs[p].open_column == expectedPairs[p].open_column &&
+				pairs[p].close_line == expectedPairs[p].close_line && pairs[p].close_column == expectedPairs[p].close_column &&
+				pairs[p].depth == expectedPairs[p].depth && pairs[p].open_char == expectedPairs[p].open_char;
+		}
+		CHECK(same);
+
+		TextEditorCodeFolding foldingReference;
+		foldingReference.AnalyzeDocument(editor);
+		const auto& regions = folding.GetRegions();
+		const auto& expectedRegions = foldingReference.GetRegions();
+		same = regions.size() == expectedRegions.size();
+		for (std::size_t r = 0; r < regions.size() && same; ++r)
+		{
+			same = regions[r].start_line == expectedRegions[r].start_line && regions[r].end_line == expectedRegions[r].end_line &&
+				regions[r].indent_level == expectedRegions[r].indent_level;
+		}
+		CHECK(same);
+
+		// The start-line lookup and hidden lines patched through the edits agree with the regions
+		const int lineCount = editor.GetLineCount();
+		std::vector<int> widest(static_cast<std::size_t>(lineCount), -1);
+		std::vector<char> hidden(static_cast<std::size_t>(lineCount), 0);
+		for (std::size_t r = 0; r < regions.size(); ++r)
+		{
+			widest[static_cast<std::size_t>(regions[r].start_line)] = static_cast<int>(r);
+			if (regions[r].is_folded)
+				std::fill(hidden.begin() + regions[r].start_line + 1, hidden.begin() + std::min(regions[r].end_line + 1, lineCount), 1);
+		}
+		bool lookups = true;
+		int visual = 0;
+		for (int line = 0; line < lineCount && lookups; ++line)
+		{
+			const auto region = folding.GetRegionStartingAtLine(line);
+			const int index = widest[static_cast<std::size_t>(line)];
+			lookups = index < 0 ? !region.has_value()
+				: region.has_value() && region->end_line == regions[static_cast<std::size_t>(index)].end_line;
+			lookups = lookups && folding.IsLineHidden(line) == (hidden[static_cast<std::size_t>(line)] != 0);
+			if (lookups && !hidden[static_cast<std::size_t>(line)])
+				lookups = folding.ActualLineToVisualLine(line) == visual && folding.VisualLineToActualLine(visual++) == line;
+		}
+		CHECK(lookups);
+	}
+}
+
+// --- TextEditorMinimap --- //
+
+void TestMinimap(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	editor.SetLanguageDefinition(TextEditor::LanguageDefinitionId::C);
+	std::vector<std::string> model;
+	for (int i = 0; i < 120; ++i)
+		model.push_back("\tint value" + std::to_string(i) + " = 42; // note");
+	editor.SetTextLines(model);
+	TextEditorMinimap minimap;
+	for (int i = 0; i < 200; ++i)
+	{
+		ReplaceRandomRange(editor, model, random, sourcePieces);
+		if (random(2) == 0)
+			Peer::ColorizeAll(editor);
+		const auto& lines = minimap.GetLineSummaries(editor);
+		TextEditorMinimap reference;
+		const auto& expected = reference.GetLineSummaries(editor);
+		bool same = lines.size() == expected.size();
+		for (std::size_t l = 0; l < lines.size() && same; ++l)
+		{
+			same = lines[l].indent_columns == expected[l].indent_columns && lines[l].run_count == expected[l].run_count;
+			for (std::uint32_t r = 0; r < lines[l].run_count && same; ++r)
+			{
+				const auto& run = minimap.GetRunPool()[lines[l].first_run + r];
+				const auto& expectedRun = reference.GetRunPool()[expected[l].first_run + r];
+				same = run.start_column == expectedRun.start_column && run.length == expectedRun.length &&
+					run.color == expectedRun.color;
+			}
+		}
+		CHECK(same);
+	}
+}
+
+// --- TextEditorAutocomplete --- //
+
+// The best max_items matches, in score order, as a full sort of all scores would give them
+void TestAutocompleteFiltering(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	std::vector<std::string> words;
+	const char* stems[] = { "get", "set", "reset", "value", "Value", "_item", "Count" };
+	for (int i = 0; i < 5000; ++i)
+		words.push_back(std::string(stems[random(7)]) + stems[random(7)] + std::to_string(random(1000)));
+	// the provider offers each keyword once
+	std::sort(words.begin(), words.end());
+	words.erase(std::unique(words.begin(), words.end()), words.end());
+
+	TextEditorAutocomplete autocomplete;
+	autocomplete.GetConfig().max_items = 20;
+	autocomplete.RegisterProvider(std::make_unique<KeywordCompletionProvider>(words));
+	const char alphabet[] = "gsrvcei_01";
+	for (int round = 0; round < 40; ++round)
+	{
+		autocomplete.Trigger(editor);
+		std::string filter;
+		const int length = 1 + random(4);
+		for (int i = 0; i < length; ++i)
+		{
+			// typing narrows the previous matches; sometimes start over with a backspace
+			if (!filter.empty() && random(5) == 0)
+				filter.pop_back();
+			else
+				filter += alphabet[random(static_cast<int>(sizeof(alphabet)) - 1)];
+			autocomplete.SetFilterText(filter);
+
+			std::vector<int> scores;
+			for (const auto& word : words)
+			{
+				const int score = TextEditorAutocomplete::ScoreFuzzyMatch(word, filter);
+				if (score >= 0)
+					scores.push_back(score);
+			}
+			std::sort(scores.begin(), scores.end(), std::greater<int>());
+			scores.resize(std::min<std::size_t>(scores.size(), 20));
+			CHECK(autocomplete.GetFilteredItemCount() == static_cast<int>(scores.size()));
+			for (int item = 0; item < autocomplete.GetFilteredItemCount() && item < static_cast<int>(scores.size()); ++item)
+			{
+				const int score = TextEditorAutocomplete::ScoreFuzzyMatch(autocomplete.GetFilteredItem(item).label, filter);
+				CHECK(score == scores[static_cast<std::size_t>(item)]);
+			}
+			if (scores.empty())
+				break;
+		}
+		autocomplete.Close();
+	}
+}
+
+// --- DocumentWordIndex --- //
+
+void TestDocumentWordIndex(unsigned int aSeed)
+{
+	Random random(aSeed);
+	TextEditor editor;
+	std::vector<std::string> model;
+	for (int i = 0; i < 100; ++i)
+		model.push_back("int count" + std::to_string(i % 7) + " = value_" + std::to_string(i % 13) + " + 12abc;");
+	editor.SetTextLines(model);
+	const std::vector<const char*> pieces = { "a", "b", "_", "1", " ", "\n", "value_", "count", "zeta" };
+	DocumentWordIndex index;
+	for (int i = 0; i < 300; ++i)
+	{
+		ReplaceRandomRange(editor, model, random, pieces);
+		index.Update(editor);
+
+		// identifier runs of three or more characters that don't start with a digit
+		std::map<std::string, int> counts;
+		for (const auto& line : model)
+		{
+			std::string word;
+			for (std::size_t c = 0; c <= line.size(); ++c)
+			{
+				const char ch = c < line.size() ? line[c] : ' ';
+				if (std::isalnum(static_cast<unsigned char>(ch)) || ch == '_')
+				{
+					word += ch;
+					continue;
+				}
+				if (word.size() >= 3 && !std::isdigit(static_cast<unsigned char>(word[0])))
+					++counts[word];
+				word.clear();
+			}
+		}
+		bool same = index.GetDistinctWordCount() == static_cast<int>(counts.size());
+		for (auto it = counts.begin(); it != counts.end() && same; ++it)
+			same = index.GetCount(it->first) == it->second;
+		CHECK(same);
+
+		// the most frequent words of a prefix, ties in spelling order as the words are lowercase
+		const char* prefixes[] = { "", "c", "v", "co", "va", "cou", "count1", "value_", "zeta", "ab" };
+		const std::string prefix = prefixes[random(static_cast<int>(sizeof(prefixes) / sizeof(prefixes[0])))];
+		const int maxWords = 1 + random(8);
+		std::vector<std::pair<std::string, int>> expected;
+		for (const auto& [word, count] : counts)
+		{
+			if (word.compare(0, prefix.size(), prefix) == 0)
+				expected.emplace_back(word, count);
+		}
+		std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+		expected.resize(std::min(expected.size(), static_cast<std::size_t>(maxWords)));
+		std::vector<std::pair<std::string_view, int>> found;
+		index.FindPrefix(prefix, maxWords, found);
+		bool sameTop = found.size() == expected.size();
+		for (std::size_t w = 0; w < found.size() && sameTop; ++w)
+			sameTop = found[w].first == expected[w].first && found[w].second == expected[w].second;
+		CHECK(sameTop);
+	}
+}
+
+// --- TextEditor::UnitTests --- //
+
+// The assert-based suite, which only checks anything when built without NDEBUG
+void TestLegacyUnitTests(unsigned int)
+{
+#ifdef NDEBUG
+	std::fprintf(stderr, "  skipped: built with NDEBUG\n");
+#else
+	TextEditor editor;
+	editor.UnitTests();
+#endif
+}
+
+struct Test
+{
+	const char* mName;
+	void (*mFunction)(unsigned int aSeed);
+};
+
+const Test tests[] = {
+	{ "Coordinates", TestCoordinates },
+	{ "Editing", TestEditing },
+	{ "Undo", TestUndo },
+	{ "Colorization", TestColorization },
+	{ "VisualLines", TestVisualLines },
+	{ "SearchSession", TestSearchSession },
+	{ "StructureAnalyzers", TestStructureAnalyzers },
+	{ "Minimap", TestMinimap },
+	{ "AutocompleteFiltering", TestAutocompleteFiltering },
+	{ "DocumentWordIndex", TestDocumentWordIndex },
+	{ "LegacyUnitTests", TestLegacyUnitTests },
+};
+
+bool ParseOptions(int argc, char** argv, Options& outOptions)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--filter") == 0 && hasValue)
+			outOptions.mFilter = argv[++i];
+		else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+			outOptions.mSeed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		else
+			return false;
+	}
+	return true;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		std::fprintf(stderr, "usage: %s [--filter TEXT] [--seed N]\n", argv[0]);
+		return 2;
+	}
+
+	// Null backend: a display size and a built font atlas are all NewFrame() needs
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+	io.DeltaTime = 1.0f / 60.0f;
+	io.IniFilename = nullptr;
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+	int failedTests = 0;
+	int testIndex = 0;
+	for (const auto& test : tests)
+	{
+		++testIndex;
+		if (!options.mFilter.empty() && std::strstr(test.mName, options.mFilter.c_str()) == nullptr)
+			continue;
+		const int failuresBefore = failureCount;
+		std::fprintf(stderr, "[ RUN  ] %s\n", test.mName);
+		test.mFunction(options.mSeed + static_cast<unsigned int>(testIndex));
+		const bool passed = failureCount == failuresBefore;
+		std::fprintf(stderr, "[ %s ] %s\n", passed ? " OK " : "FAIL", test.mName);
+		if (!passed)
+			++failedTests;
+	}
+
+	ImGui::DestroyContext();
+	std::fprintf(stderr, "%d checks, %d failed, %d test(s) failed\n", checkCount, failureCount, failedTests);
+	return failedTests == 0 ? 0 : 1;
+}